@@ -0,0 +1,359 @@
+#include "mkCaptureThread.h"
+
+//--------------------------------------------------------------
+mkCaptureThread::mkCaptureThread() : depthMode(), depthFieldOfView(), depthMaxDepth(0), handSource(MK_HANDS_NITE), handFilterMode(handFilter.getMode()), deviceIndex(0), numCapturedFrames(0), numConsumedFrames(0), recording(false), replayMode(MK_REPLAY_REALTIME), replayAnchorTimestamp(0), replayAnchorMicros(0) {
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::setup(int _maxNumHands) {
+    
+    // not threaded: this thread drives the device update, and no textures
+    // because GL may only be touched from the render thread
+    openNIDevice.setup(false);
+    openNIDevice.setUseTexture(false);
+    openNIDevice.addDepthGenerator();
+    openNIDevice.setRegister(true);
+    openNIDevice.setMirror(true);
+    
+    // what startRecording() needs, read now: once this thread runs, only it
+    // may touch the generator
+    xn::DepthGenerator& depthGenerator = openNIDevice.getDepthGenerator();
+    depthGenerator.GetMapOutputMode(depthMode);
+    depthGenerator.GetFieldOfView(depthFieldOfView);
+    depthMaxDepth = depthGenerator.GetDeviceMaxDepth();
+    depthRays.setup(depthGenerator);
+    
+    if (handSource == MK_HANDS_NITE) {
+        openNIDevice.addHandsGenerator();
+        openNIDevice.addAllHandFocusGestures();
+        openNIDevice.setMaxNumHands(_maxNumHands);
+        // fired from update(), so on this thread
+        ofAddListener(openNIDevice.handEvent, this, &mkCaptureThread::onHandEvent);
+    }
+    
+    // reserve all storage up front so capturing never allocates
+    framePool.setup(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT);
+    depthFilter.setup(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT);
+    setupFrames(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT, _maxNumHands);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::setupFrames(int _width, int _height, int _maxNumHands) {
+    if (handSource == MK_HANDS_BLOBS) {
+        blobTracker.setup(_width, _height);
+        _maxNumHands = MAX(_maxNumHands, blobTracker.getMaxBlobs());
+    }
+    handFilter.setup(_maxNumHands);
+    handPoints.resize(_maxNumHands);
+    lastHandIDs.reserve(_maxNumHands);
+    handIDs.reserve(_maxNumHands);
+    for (int i = 0; i < 3; i++) {
+        frames.getBuffer(i).hands.reserve(_maxNumHands);
+        frames.getBuffer(i).pyramid.setup(_width, _height);
+    }
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::setupReplay(const string& _path, mkReplayMode _mode, bool _loop) {
+    if (!player.open(_path, _loop))
+        return false;
+    
+    replayMode = _mode;
+    replayAnchorTimestamp = 0;
+    replayAnchorMicros = 0;
+    
+    framePool.setup(player.getWidth(), player.getHeight());
+    depthRays.setup(player.getWidth(), player.getHeight(), player.getFieldOfView());
+    depthFilter.setup(player.getWidth(), player.getHeight());
+    setupFrames(player.getWidth(), player.getHeight(), 2);
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::start() {
+    if (!isReplaying())
+        openNIDevice.start();
+    // leave a core each to the render loop and this thread
+    workers.setup(MAX((int)std::thread::hardware_concurrency() - 2, 1));
+    startThread(true);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::stop() {
+    if (isThreadRunning())
+        waitForThread(true);
+    workers.stop();
+    stopRecording();
+    
+    ofLogNotice("mkCaptureThread") << "depth frame pool: " << framePool.getNumHits() << " hits, " << framePool.getNumMisses()
+                                   << " misses, at most " << framePool.getHighWaterMark() << " of " << framePool.getNumBuffers() << " in use";
+    if (handEvents.getNumDropped() > 0)
+        ofLogWarning("mkCaptureThread") << "hand events: " << handEvents.getNumDropped() << " dropped, the ring was full";
+    if (handSource == MK_HANDS_BLOBS)
+        ofLogNotice("mkCaptureThread") << "blob tracker: " << blobTracker.getAverageMicros() << " us per frame on average, "
+                                       << blobTracker.getMaxMicros() << " us at most";
+    if (isReplaying())
+        player.close();
+    else {
+        if (handSource == MK_HANDS_NITE)
+            ofRemoveListener(openNIDevice.handEvent, this, &mkCaptureThread::onHandEvent);
+        openNIDevice.stop();
+    }
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::startRecording(const string& _path) {
+    if (isReplaying()) {
+        ofLogWarning("mkCaptureThread") << "can not record while replaying";
+        return false;
+    }
+    
+    lock();
+    bool opened = recorder.open(_path, depthMode.nXRes, depthMode.nYRes, depthMaxDepth, depthFieldOfView);
+    recording = opened;
+    unlock();
+    return opened;
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::stopRecording() {
+    lock();
+    recording = false;
+    recorder.close();
+    unlock();
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::isRecording() {
+    return recording;
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::update() {
+    if (!frames.update())
+        return false;
+    numConsumedFrames = frames.getReadBuffer().frameIndex + 1;
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::threadedFunction() {
+    while (isThreadRunning()) {
+        
+        if (isReplaying()) {
+            // lockstep with the renderer, so no frame gets dropped
+            if (replayMode == MK_REPLAY_AS_FAST_AS_POSSIBLE && numConsumedFrames < numCapturedFrames) {
+                yield();
+                continue;
+            }
+            if (replay(frames.getWriteBuffer())) {
+                process(frames.getWriteBuffer());
+                frames.publish();
+            }
+            else
+                sleep(10);
+            continue;
+        }
+        
+        openNIDevice.update();
+        
+        if (openNIDevice.isNewFrame() && capture(frames.getWriteBuffer())) {
+            record(frames.getWriteBuffer());
+            process(frames.getWriteBuffer());
+            frames.publish();
+        }
+        else {
+            sleep(1);
+        }
+    }
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::capture(mkKinectFrame& _frame) {
+    
+    openNIDevice.getDepthGenerator().GetMetaData(depthMD);
+    int numPixels = depthMD.XRes() * depthMD.YRes();
+    if (depthMD.Data() == NULL || numPixels > framePool.getNumPixels())
+        return false;
+    
+    _frame.frameIndex = numCapturedFrames++;
+    _frame.sensorFrameID = depthMD.FrameID();
+    _frame.sensorTimestamp = depthMD.Timestamp();
+    _frame.captureTimeMicros = ofGetElapsedTimeMicros();
+    _frame.width = depthMD.XRes();
+    _frame.height = depthMD.YRes();
+    
+    // the one copy out of OpenNI, into a recycled buffer
+    _frame.depth.reset();
+    _frame.depth = framePool.acquire();
+    memcpy(_frame.depth.getPixels(), depthMD.Data(), numPixels * sizeof(XnDepthPixel));
+    
+    _frame.hands.clear();
+    _frame.trackingMicros = 0;
+    if (handSource == MK_HANDS_BLOBS)
+        return true;
+    
+    int numHands = openNIDevice.getNumTrackedHands();
+    for (int i = 0; i < numHands; i++) {
+        ofxOpenNIHand& hand = openNIDevice.getTrackedHand(i);
+        mkTrackedHand trackedHand;
+        trackedHand.id = hand.getID();
+        trackedHand.position = hand.getPosition();
+        trackedHand.worldPosition = hand.getWorldPosition();
+        _frame.hands.push_back(trackedHand);
+    }
+    
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkCaptureThread::replay(mkKinectFrame& _frame) {
+    
+    if (!player.read(_frame, framePool))
+        return false;
+    
+    if (replayMode == MK_REPLAY_REALTIME) {
+        // re-anchor on the first frame and whenever the recording loops
+        unsigned long long now = ofGetElapsedTimeMicros();
+        if (replayAnchorMicros == 0 || _frame.sensorTimestamp <= replayAnchorTimestamp) {
+            replayAnchorTimestamp = _frame.sensorTimestamp;
+            replayAnchorMicros = now;
+        }
+        unsigned long long due = replayAnchorMicros + (_frame.sensorTimestamp - replayAnchorTimestamp);
+        while (now < due && isThreadRunning()) {
+            sleep(MAX(1, (int)((due - now) / 1000)));
+            now = ofGetElapsedTimeMicros();
+        }
+    }
+    
+    _frame.frameIndex = numCapturedFrames++;
+    _frame.captureTimeMicros = ofGetElapsedTimeMicros();
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::process(mkKinectFrame& _frame) {
+    // filtered into a fresh buffer, as the player decodes the next frame
+    // against the raw one
+    if (depthFilter.isEnabled()) {
+        mkDepthFrameRef filtered = framePool.acquire();
+        depthFilter.update(_frame.depth.getPixels(), filtered.getPixels(), &workers);
+        _frame.depth = filtered;
+    }
+    _frame.pyramid.update(_frame.depth.getPixels());
+    
+    // blob hands replace NITE's or the recorded ones
+    if (handSource == MK_HANDS_BLOBS)
+        trackBlobs(_frame);
+    filterHands(_frame);
+    
+    // NITE reports its own while live
+    if (handSource == MK_HANDS_BLOBS || isReplaying())
+        deriveHandEvents(_frame);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::deriveHandEvents(const mkKinectFrame& _frame) {
+    handIDs.clear();
+    for (int i = 0; i < _frame.hands.size(); i++) {
+        const mkTrackedHand& hand = _frame.hands[i];
+        handIDs.push_back(hand.id);
+        if (std::find(lastHandIDs.begin(), lastHandIDs.end(), hand.id) == lastHandIDs.end())
+            pushHandEvent(HAND_TRACKING_STARTED, hand, _frame.sensorTimestamp);
+        else
+            pushHandEvent(HAND_TRACKING_UPDATED, hand, _frame.sensorTimestamp);
+    }
+    for (int i = 0; i < lastHandIDs.size(); i++) {
+        if (std::find(handIDs.begin(), handIDs.end(), lastHandIDs[i]) == handIDs.end()) {
+            mkTrackedHand lost;
+            lost.id = lastHandIDs[i];
+            pushHandEvent(HAND_TRACKING_STOPPED, lost, _frame.sensorTimestamp);
+        }
+    }
+    swap(lastHandIDs, handIDs);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::pushHandEvent(HandStatusType _status, const mkTrackedHand& _hand, XnUInt64 _timestamp) {
+    mkHandEvent event;
+    event.status = _status;
+    event.id = _hand.id;
+    event.deviceIndex = deviceIndex;
+    event.position = _hand.position;
+    event.worldPosition = _hand.worldPosition;
+    event.sensorTimestamp = _timestamp;
+    handEvents.push(event);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::onHandEvent(ofxOpenNIHandEvent& _event) {
+    mkTrackedHand hand;
+    hand.id = _event.id;
+    hand.position = _event.position;
+    hand.worldPosition = _event.worldPosition;
+    pushHandEvent(_event.handStatus, hand, (XnUInt64)_event.timestampMillis * 1000);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::trackBlobs(mkKinectFrame& _frame) {
+    blobTracker.update(_frame.pyramid, _frame.hands);
+    _frame.trackingMicros = blobTracker.getLastMicros();
+    
+    int numHands = _frame.hands.size();
+    if (numHands == 0)
+        return;
+    for (int i = 0; i < numHands; i++) {
+        handPoints[i].X = _frame.hands[i].position.x;
+        handPoints[i].Y = _frame.hands[i].position.y;
+        handPoints[i].Z = _frame.hands[i].position.z;
+    }
+    depthRays.toWorld(numHands, &handPoints[0], &handPoints[0]);
+    for (int i = 0; i < numHands; i++)
+        _frame.hands[i].worldPosition.set(handPoints[i].X, handPoints[i].Y, handPoints[i].Z);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::filterHands(mkKinectFrame& _frame) {
+    mkHandFilterMode mode = getHandFilterMode();
+    if (mode != handFilter.getMode())
+        handFilter.setMode(mode);
+    handFilter.update(_frame.hands, _frame.sensorTimestamp);
+    if (mode == MK_HAND_FILTER_NONE)
+        return;
+    
+    // projective positions follow the filtered world ones
+    int numHands = MIN(_frame.hands.size(), handPoints.size());
+    for (int i = 0; i < numHands; i++) {
+        handPoints[i].X = _frame.hands[i].worldPosition.x;
+        handPoints[i].Y = _frame.hands[i].worldPosition.y;
+        handPoints[i].Z = _frame.hands[i].worldPosition.z;
+    }
+    depthRays.toProjective(numHands, &handPoints[0], &handPoints[0]);
+    for (int i = 0; i < numHands; i++)
+        _frame.hands[i].position.set(handPoints[i].X, handPoints[i].Y, handPoints[i].Z);
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::predictHands(unsigned long long _nowMicros, vector<mkTrackedHand>& _hands) const {
+    const mkKinectFrame& frame = getFrame();
+    mkHandFilter::predict(frame.hands, handFilter.getLeadMicros(frame.captureTimeMicros, _nowMicros), _hands);
+    for (int i = 0; i < _hands.size(); i++) {
+        XnPoint3D point;
+        point.X = _hands[i].worldPosition.x;
+        point.Y = _hands[i].worldPosition.y;
+        point.Z = _hands[i].worldPosition.z;
+        depthRays.toProjective(1, &point, &point);
+        _hands[i].position.set(point.X, point.Y, point.Z);
+    }
+}
+
+//--------------------------------------------------------------
+void mkCaptureThread::record(const mkKinectFrame& _frame) {
+    if (!recording)
+        return;
+    
+    lock();
+    if (recorder.isOpen() && !recorder.write(_frame))
+        recording = false;
+    unlock();
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOpenNI.h"
+#include "mkKinectFrame.h"
+#include "mkTripleBuffer.h"
+#include "mkDepthFramePool.h"
+#include "mkDepthRecorder.h"
+#include "mkDepthPlayer.h"
+#include "mkBlobTracker.h"
+#include "mkHandFilter.h"
+#include "mkDepthRays.h"
+#include "mkDepthFilter.h"
+#include "mkWorkerPool.h"
+#include "mkSpscRing.h"
+#include "mkHandEvent.h"
+
+// Owns the ofxOpenNI device and runs its update on a separate thread, so the
+// depth wait and hand tracking never stall the render loop. Every new depth
+// frame is published together with the tracked hands through a triple buffer;
+// the render thread picks up the latest complete snapshot without waiting.
+//
+// Instead of the live device the thread can replay a recording, either paced
+// by the recorded timestamps or as fast as the render loop consumes frames.
+// In the latter mode no frame is ever dropped, which makes runs repeatable.
+//
+// Recording stores the raw depth; after that every frame goes through the
+// depth filter, on a worker pool, and gets its depth pyramid before anything
+// downstream sees it.
+//
+// Hands come either from NITE, which needs a focus gesture per hand, or from
+// the blob tracker, which runs on every frame on this thread, live or
+// replayed, and needs no gesture. Either way the hand filter smooths them
+// here; the render thread then predicts them forward to its own time.
+//
+// Hands starting, moving and stopping cross to the render thread as events
+// through a lock-free ring: NITE's own events when live, otherwise events
+// derived from the hand ids of consecutive frames, an update per hand still
+// tracked. A full ring drops and counts.
+
+#define MK_HAND_EVENT_CAPACITY 64
+
+enum mkReplayMode {
+    MK_REPLAY_REALTIME = 0,
+    MK_REPLAY_AS_FAST_AS_POSSIBLE
+};
+
+enum mkHandSource {
+    MK_HANDS_NITE = 0,
+    MK_HANDS_BLOBS
+};
+
+class mkCaptureThread : public ofThread {
+public:
+    mkCaptureThread();
+    
+    // call before setup() or setupReplay()
+    void    setHandSource(mkHandSource _source)	{ handSource = _source; }
+    void    setDeviceIndex(int _index)				{ deviceIndex = _index; }
+    
+    void    setup(int _maxNumHands = 2);
+    bool    setupReplay(const string& _path, mkReplayMode _mode = MK_REPLAY_REALTIME, bool _loop = true);
+    void    start();
+    void    stop();
+    
+    bool    isReplaying() const			{ return player.isOpen(); }
+    
+    // records every captured frame until stopRecording(), safe from any thread
+    bool    startRecording(const string& _path);
+    void    stopRecording();
+    bool    isRecording();
+    
+    // render thread: returns true if a new snapshot arrived since the last call
+    bool    update();
+    const mkKinectFrame& getFrame() const	{ return frames.getReadBuffer(); }
+    
+    // render thread: XN_STATUS_IS_EMPTY once all events are taken
+    XnStatus            popHandEvent(mkHandEvent& _event)	{ return handEvents.pop(_event); }
+    unsigned long long  getNumDroppedHandEvents() const		{ return handEvents.getNumDropped(); }
+    
+    // any thread: the hand filter switches at the start of the next frame
+    void                setHandFilterMode(mkHandFilterMode _mode)	{ handFilterMode = _mode; }
+    mkHandFilterMode    getHandFilterMode() const					{ return (mkHandFilterMode)handFilterMode.load(); }
+    
+    // render thread: the hands of the current snapshot extrapolated to
+    // _nowMicros, in the ofGetElapsedTimeMicros() clock
+    void    predictHands(unsigned long long _nowMicros, vector<mkTrackedHand>& _hands) const;
+    
+    unsigned long long  getNumCapturedFrames() const	{ return numCapturedFrames; }
+    const mkDepthFramePool& getFramePool() const		{ return framePool; }
+    mkBlobTracker&          getBlobTracker()			{ return blobTracker; }
+    // set up before start(), the mode with setHandFilterMode() after
+    mkHandFilter&           getHandFilter()				{ return handFilter; }
+    mkDepthFilter&          getDepthFilter()			{ return depthFilter; }
+    const mkDepthRays&      getDepthRays() const		{ return depthRays; }
+    
+protected:
+    void    threadedFunction();
+    bool    capture(mkKinectFrame& _frame);
+    bool    replay(mkKinectFrame& _frame);
+    void    record(const mkKinectFrame& _frame);
+    void    process(mkKinectFrame& _frame);
+    void    setupFrames(int _width, int _height, int _maxNumHands);
+    void    trackBlobs(mkKinectFrame& _frame);
+    void    filterHands(mkKinectFrame& _frame);
+    void    deriveHandEvents(const mkKinectFrame& _frame);
+    void    pushHandEvent(HandStatusType _status, const mkTrackedHand& _hand, XnUInt64 _timestamp);
+    void    onHandEvent(ofxOpenNIHandEvent& _event);
+    
+    ofxOpenNI                       openNIDevice;
+    xn::DepthMetaData               depthMD;
+    XnMapOutputMode                 depthMode;          // of the device, for recordings
+    XnFieldOfView                   depthFieldOfView;
+    XnDepthPixel                    depthMaxDepth;
+    mkDepthFramePool                framePool;
+    mkTripleBuffer<mkKinectFrame>   frames;
+    
+    mkDepthRays                     depthRays;
+    mkDepthFilter                   depthFilter;
+    mkWorkerPool                    workers;
+    
+    mkHandSource                    handSource;
+    mkBlobTracker                   blobTracker;
+    mkHandFilter                    handFilter;
+    std::atomic<int>                handFilterMode;     // requested, applied in filterHands()
+    vector<XnPoint3D>               handPoints;
+    
+    int                             deviceIndex;
+    mkSpscRing<mkHandEvent, MK_HAND_EVENT_CAPACITY> handEvents;
+    vector<XnUserID>                lastHandIDs;
+    vector<XnUserID>                handIDs;
+    
+    std::atomic<unsigned long long> numCapturedFrames;
+    std::atomic<unsigned long long> numConsumedFrames;
+    
+    mkDepthRecorder                 recorder;
+    std::atomic<bool>               recording;
+    
+    mkDepthPlayer                   player;
+    mkReplayMode                    replayMode;
+    XnUInt64                        replayAnchorTimestamp;
+    unsigned long long              replayAnchorMicros;
+};
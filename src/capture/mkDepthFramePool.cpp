@@ -0,0 +1,94 @@
+#include "mkDepthFramePool.h"
+#include "XnOS.h"
+#include "mkSimd.h"
+
+//--------------------------------------------------------------
+mkDepthFramePool::mkDepthFramePool() : width(0), height(0), numBuffers(0), buffers(NULL), nextBuffer(0), numHits(0), numMisses(0), numInUse(0), highWaterMark(0) {
+}
+
+//--------------------------------------------------------------
+mkDepthFramePool::~mkDepthFramePool() {
+    clear();
+}
+
+//--------------------------------------------------------------
+void mkDepthFramePool::setup(int _width, int _height, int _numBuffers) {
+    clear();
+    
+    width = _width;
+    height = _height;
+    numBuffers = _numBuffers;
+    buffers = new mkDepthFrameBuffer[numBuffers];
+    for (int i = 0; i < numBuffers; i++) {
+        buffers[i].pixels = allocatePixels();
+        buffers[i].pool = this;
+    }
+    
+    numHits = 0;
+    numMisses = 0;
+    numInUse = 0;
+    highWaterMark = 0;
+}
+
+//--------------------------------------------------------------
+void mkDepthFramePool::clear() {
+    if (buffers == NULL)
+        return;
+    
+    if (numInUse > 0)
+        ofLogWarning("mkDepthFramePool") << numInUse << " frames still in use";
+    for (int i = 0; i < numBuffers; i++)
+        xnOSFreeAligned(buffers[i].pixels);
+    delete [] buffers;
+    buffers = NULL;
+    numBuffers = 0;
+}
+
+//--------------------------------------------------------------
+XnDepthPixel* mkDepthFramePool::allocatePixels() {
+    return (XnDepthPixel*)xnOSMallocAligned(width * height * sizeof(XnDepthPixel), MK_CACHE_LINE_SIZE);
+}
+
+//--------------------------------------------------------------
+mkDepthFrameRef mkDepthFramePool::acquire() {
+    
+    mkDepthFrameBuffer* buffer = NULL;
+    
+    // claim the first free buffer, starting after the last one handed out
+    int start = nextBuffer.load(std::memory_order_relaxed);
+    for (int k = 0; k < numBuffers; k++) {
+        int i = (start + k) % numBuffers;
+        int expected = 0;
+        if (buffers[i].refCount.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+            buffer = &buffers[i];
+            nextBuffer.store(i + 1, std::memory_order_relaxed);
+            numHits++;
+            break;
+        }
+    }
+    
+    if (buffer == NULL) {
+        if (numMisses++ == 0)
+            ofLogWarning("mkDepthFramePool") << "all " << numBuffers << " frames in use, allocating";
+        buffer = new mkDepthFrameBuffer();
+        buffer->pixels = allocatePixels();
+        buffer->pool = this;
+        buffer->pooled = false;
+        buffer->refCount = 1;
+    }
+    
+    int inUse = ++numInUse;
+    int mark = highWaterMark.load(std::memory_order_relaxed);
+    while (inUse > mark && !highWaterMark.compare_exchange_weak(mark, inUse, std::memory_order_relaxed));
+    
+    return mkDepthFrameRef(buffer);
+}
+
+//--------------------------------------------------------------
+void mkDepthFramePool::recycle(mkDepthFrameBuffer* _buffer) {
+    numInUse--;
+    if (!_buffer->pooled) {
+        xnOSFreeAligned(_buffer->pixels);
+        delete _buffer;
+    }
+}
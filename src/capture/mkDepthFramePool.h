@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include <atomic>
+
+// Fixed pool of aligned depth frame buffers. Buffers are handed out as
+// reference counted mkDepthFrameRef handles and go back to the pool when the
+// last handle is released, from whichever thread that happens on. Acquiring
+// and releasing never locks and, once the pool is set up, never allocates;
+// only when every buffer is in use an extra one is allocated and counted as
+// a miss.
+
+class mkDepthFramePool;
+
+struct mkDepthFrameBuffer {
+    mkDepthFrameBuffer() : pixels(NULL), refCount(0), pool(NULL), pooled(true) {}
+    
+    XnDepthPixel*       pixels;
+    std::atomic<int>    refCount;
+    mkDepthFramePool*   pool;
+    bool                pooled;     // false for overflow buffers, freed on release
+};
+
+class mkDepthFrameRef {
+public:
+    mkDepthFrameRef() : buffer(NULL) {}
+    mkDepthFrameRef(const mkDepthFrameRef& _other) : buffer(_other.buffer)	{ retain(); }
+    ~mkDepthFrameRef()														{ release(); }
+    
+    mkDepthFrameRef& operator=(const mkDepthFrameRef& _other) {
+        if (buffer != _other.buffer) {
+            _other.retain();
+            release();
+            buffer = _other.buffer;
+        }
+        return *this;
+    }
+    
+    void                reset()					{ release(); buffer = NULL; }
+    bool                isValid() const			{ return buffer != NULL; }
+    XnDepthPixel*       getPixels()				{ return buffer ? buffer->pixels : NULL; }
+    const XnDepthPixel* getPixels() const		{ return buffer ? buffer->pixels : NULL; }
+    
+private:
+    friend class mkDepthFramePool;
+    explicit mkDepthFrameRef(mkDepthFrameBuffer* _buffer) : buffer(_buffer) {}	// adopts one reference
+    
+    inline void retain() const;
+    inline void release();
+    
+    mkDepthFrameBuffer* buffer;
+};
+
+class mkDepthFramePool {
+public:
+    mkDepthFramePool();
+    ~mkDepthFramePool();
+    
+    // not thread safe, call before any frame is acquired
+    void    setup(int _width, int _height, int _numBuffers = 8);
+    
+    mkDepthFrameRef acquire();
+    
+    int     getWidth() const				{ return width; }
+    int     getHeight() const				{ return height; }
+    int     getNumPixels() const			{ return width * height; }
+    int     getNumBuffers() const			{ return numBuffers; }
+    
+    unsigned long long	getNumHits() const		{ return numHits; }
+    unsigned long long	getNumMisses() const	{ return numMisses; }
+    int                 getNumInUse() const		{ return numInUse; }
+    int                 getHighWaterMark() const{ return highWaterMark; }
+    
+private:
+    friend class mkDepthFrameRef;
+    void    recycle(mkDepthFrameBuffer* _buffer);
+    void    clear();
+    XnDepthPixel* allocatePixels();
+    
+    int                     width;
+    int                     height;
+    int                     numBuffers;
+    mkDepthFrameBuffer*     buffers;
+    
+    std::atomic<int>                nextBuffer;
+    std::atomic<unsigned long long> numHits;
+    std::atomic<unsigned long long> numMisses;
+    std::atomic<int>                numInUse;
+    std::atomic<int>                highWaterMark;
+};
+
+//--------------------------------------------------------------
+inline void mkDepthFrameRef::retain() const {
+    if (buffer)
+        buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+inline void mkDepthFrameRef::release() {
+    if (buffer && buffer->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        buffer->pool->recycle(buffer);
+}
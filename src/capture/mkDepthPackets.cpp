@@ -0,0 +1,183 @@
+#include "mkDepthPackets.h"
+
+//--------------------------------------------------------------
+mkDepthPacketAssembler::mkDepthPacketAssembler() : currentTimestamp(0), inFrame(false), broken(false), nextSequence(0), numBytes(0), numPixels(0), bits(0), numBits(0), numFrames(0), numDroppedFrames(0), numLostPackets(0), numBadPackets(0) {
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::setup(int _numBuffers) {
+    // frames of an earlier run go back before their pool is replaced
+    current.reset();
+    for (int i = 0; i < 3; i++)
+        frames.getBuffer(i).depth.reset();
+    
+    // three frames stay with the triple buffer, one is being assembled
+    pool.setup(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT, MAX(_numBuffers, 4));
+    inFrame = false;
+    numFrames = 0;
+    numDroppedFrames = 0;
+    numLostPackets = 0;
+    numBadPackets = 0;
+}
+
+//--------------------------------------------------------------
+bool mkDepthPacketAssembler::addPacket(const XnUInt8* _packet, int _length) {
+    mkPacketHeader header;
+    if (_length < MK_PACKET_HEADER_SIZE || _packet[0] != 'R' || _packet[1] != 'B') {
+        numBadPackets++;
+        return false;
+    }
+    memcpy(&header, _packet, sizeof(header));
+    if (header.flag != MK_PACKET_DEPTH_START && header.flag != MK_PACKET_DEPTH_MIDDLE && header.flag != MK_PACKET_DEPTH_END) {
+        numBadPackets++;
+        return false;
+    }
+    
+    // a gap before a frame's first packet costs nothing, inside a frame
+    // it costs the frame
+    XnUInt8 gap = header.sequence - nextSequence;
+    nextSequence = header.sequence + 1;
+    if (numFrames + numDroppedFrames > 0 || inFrame)
+        numLostPackets += gap;
+    if (header.flag == MK_PACKET_DEPTH_START)
+        beginFrame(header);
+    else if (!inFrame)
+        return false;
+    else if (gap != 0)
+        broken = true;
+    
+    if (!broken)
+        unpack(_packet + MK_PACKET_HEADER_SIZE, _length - MK_PACKET_HEADER_SIZE);
+    
+    if (header.flag != MK_PACKET_DEPTH_END)
+        return false;
+    if (broken || numBytes != MK_DEPTH_FRAME_BYTES) {
+        dropFrame();
+        return false;
+    }
+    endFrame();
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::beginFrame(const mkPacketHeader& _header) {
+    // the previous frame never saw its last packet
+    if (inFrame)
+        dropFrame();
+    
+    current = pool.acquire();
+    currentTimestamp = _header.timestamp;
+    inFrame = true;
+    broken = false;
+    numBytes = 0;
+    numPixels = 0;
+    bits = 0;
+    numBits = 0;
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::unpack(const XnUInt8* _data, int _length) {
+    if (numBytes + _length > MK_DEPTH_FRAME_BYTES) {
+        broken = true;
+        return;
+    }
+    
+    XnDepthPixel* pixels = current.getPixels() + numPixels;
+    const XnUInt8* end = _data + _length;
+    
+    // payloads do not end on a group of 8 pixels, the bits of the group
+    // the last packet cut carry over
+    while (_data < end && numBytes % 11 != 0) {
+        bits = (bits << 8) | *_data++;
+        numBits += 8;
+        numBytes++;
+        if (numBits >= 11) {
+            numBits -= 11;
+            *pixels++ = (bits >> numBits) & 0x7ff;
+            bits &= (1 << numBits) - 1;
+        }
+    }
+    
+    // whole groups, 11 bytes to 8 pixels
+    while (end - _data >= 11) {
+        const XnUInt8* b = _data;
+        pixels[0] = (b[0] << 3) | (b[1] >> 5);
+        pixels[1] = ((b[1] & 0x1f) << 6) | (b[2] >> 2);
+        pixels[2] = ((b[2] & 0x03) << 9) | (b[3] << 1) | (b[4] >> 7);
+        pixels[3] = ((b[4] & 0x7f) << 4) | (b[5] >> 4);
+        pixels[4] = ((b[5] & 0x0f) << 7) | (b[6] >> 1);
+        pixels[5] = ((b[6] & 0x01) << 10) | (b[7] << 2) | (b[8] >> 6);
+        pixels[6] = ((b[8] & 0x3f) << 5) | (b[9] >> 3);
+        pixels[7] = ((b[9] & 0x07) << 8) | b[10];
+        pixels += 8;
+        _data += 11;
+        numBytes += 11;
+    }
+    
+    // the start of the group the next packet finishes
+    while (_data < end) {
+        bits = (bits << 8) | *_data++;
+        numBits += 8;
+        numBytes++;
+        if (numBits >= 11) {
+            numBits -= 11;
+            *pixels++ = (bits >> numBits) & 0x7ff;
+            bits &= (1 << numBits) - 1;
+        }
+    }
+    
+    numPixels = pixels - current.getPixels();
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::endFrame() {
+    mkUsbDepthFrame& frame = frames.getWriteBuffer();
+    frame.frameIndex = ++numFrames;
+    frame.sensorTimestamp = currentTimestamp;
+    frame.captureTimeMicros = ofGetElapsedTimeMicros();
+    frame.depth = current;
+    frames.publish();
+    
+    current.reset();
+    inFrame = false;
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::dropFrame() {
+    numDroppedFrames++;
+    current.reset();
+    inFrame = false;
+}
+
+//--------------------------------------------------------------
+void mkDepthPacketAssembler::packFrame(const XnDepthPixel* _depth, XnUInt8& _sequence, XnUInt32 _timestamp, vector<XnUInt8>& _packets, vector<int>& _lengths) {
+    vector<XnUInt8> packed(MK_DEPTH_FRAME_BYTES);
+    XnUInt32 acc = 0;
+    int accBits = 0, n = 0;
+    for (int i = 0; i < MK_DEPTH_WIDTH * MK_DEPTH_HEIGHT; i++) {
+        acc = (acc << 11) | (_depth[i] & 0x7ff);
+        accBits += 11;
+        while (accBits >= 8) {
+            accBits -= 8;
+            packed[n++] = (acc >> accBits) & 0xff;
+        }
+        acc &= (1 << accBits) - 1;
+    }
+    
+    for (int p = 0; p < MK_DEPTH_PACKETS_PER_FRAME; p++) {
+        int offset = p * MK_DEPTH_PAYLOAD_SIZE;
+        int payload = MIN(MK_DEPTH_PAYLOAD_SIZE, MK_DEPTH_FRAME_BYTES - offset);
+        mkPacketHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic[0] = 'R';
+        header.magic[1] = 'B';
+        header.flag = p == 0 ? MK_PACKET_DEPTH_START : p == MK_DEPTH_PACKETS_PER_FRAME - 1 ? MK_PACKET_DEPTH_END : MK_PACKET_DEPTH_MIDDLE;
+        header.sequence = _sequence++;
+        header.timestamp = _timestamp;
+        
+        const XnUInt8* h = (const XnUInt8*)&header;
+        _packets.insert(_packets.end(), h, h + sizeof(header));
+        _packets.insert(_packets.end(), packed.begin() + offset, packed.begin() + offset + payload);
+        _lengths.push_back(MK_PACKET_HEADER_SIZE + payload);
+    }
+}
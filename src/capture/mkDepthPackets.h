@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkDepthFramePool.h"
+#include "mkTripleBuffer.h"
+
+// The Kinect's depth stream as it comes off the isochronous endpoint: every
+// packet has a 12 byte header, "RB", a flag that marks the first, middle and
+// last packets of a frame, an 8 bit sequence number and the sensor's
+// timestamp, then up to 1748 bytes of the frame. A frame is 640 x 480 pixels
+// of 11 bit disparity, packed most significant bit first, 8 pixels in 11
+// bytes.
+//
+// mkDepthPacketAssembler unpacks each packet's payload as it arrives
+// straight into a buffer of its frame pool, there is no copy of the packed
+// frame. A frame that misses a packet, by a gap in the sequence numbers or
+// a short payload, is dropped whole and its buffer goes back to the pool.
+// Complete frames are published through a triple buffer, the reader always
+// gets the newest one.
+//
+// Pixels are the raw disparity, MK_DEPTH_NO_READING where the sensor saw
+// nothing; turning them into mm needs the device's calibration.
+
+#define MK_PACKET_HEADER_SIZE       12
+#define MK_DEPTH_PACKET_SIZE        1760
+#define MK_DEPTH_PAYLOAD_SIZE       (MK_DEPTH_PACKET_SIZE - MK_PACKET_HEADER_SIZE)
+#define MK_DEPTH_FRAME_BYTES        (MK_DEPTH_WIDTH * MK_DEPTH_HEIGHT * 11 / 8)
+#define MK_DEPTH_PACKETS_PER_FRAME  ((MK_DEPTH_FRAME_BYTES + MK_DEPTH_PAYLOAD_SIZE - 1) / MK_DEPTH_PAYLOAD_SIZE)
+#define MK_DEPTH_NO_READING         2047
+
+enum mkPacketFlag {
+    MK_PACKET_DEPTH_START   = 0x71,
+    MK_PACKET_DEPTH_MIDDLE  = 0x72,
+    MK_PACKET_DEPTH_END     = 0x75
+};
+
+struct mkPacketHeader {
+    XnUInt8     magic[2];       // 'R', 'B'
+    XnUInt8     pad;
+    XnUInt8     flag;           // mkPacketFlag
+    XnUInt8     unknown0;
+    XnUInt8     sequence;       // counts packets, wraps
+    XnUInt8     unknown1;
+    XnUInt8     unknown2;
+    XnUInt32    timestamp;      // sensor clock
+};
+static_assert(sizeof(mkPacketHeader) == MK_PACKET_HEADER_SIZE, "mkPacketHeader must match the wire format");
+
+struct mkUsbDepthFrame {
+    mkUsbDepthFrame() : frameIndex(0), sensorTimestamp(0), captureTimeMicros(0) {}
+    
+    unsigned long long  frameIndex;         // counts complete frames
+    XnUInt32            sensorTimestamp;    // from the frame's first packet
+    unsigned long long  captureTimeMicros;  // ofGetElapsedTimeMicros() when its last packet arrived
+    mkDepthFrameRef     depth;              // MK_DEPTH_WIDTH * MK_DEPTH_HEIGHT raw disparities
+};
+
+class mkDepthPacketAssembler {
+public:
+    mkDepthPacketAssembler();
+    
+    // not thread safe, call before the first packet and with no frame held
+    void    setup(int _numBuffers = 8);
+    
+    // ingest thread: one packet with its header, returns true if it
+    // completed a frame
+    bool    addPacket(const XnUInt8* _packet, int _length);
+    
+    // reader thread: returns true if a new frame arrived since the last call
+    bool    update()							{ return frames.update(); }
+    const mkUsbDepthFrame& getFrame() const	{ return frames.getReadBuffer(); }
+    
+    // the ingest thread's counts, read them once it stopped
+    unsigned long long  getNumFrames() const			{ return numFrames; }
+    unsigned long long  getNumDroppedFrames() const		{ return numDroppedFrames; }
+    unsigned long long  getNumLostPackets() const		{ return numLostPackets; }
+    unsigned long long  getNumBadPackets() const		{ return numBadPackets; }
+    const mkDepthFramePool& getPool() const			{ return pool; }
+    
+    // the packets of one frame of _depth, appended to _packets and their
+    // lengths to _lengths; for loopback streams and tests
+    static void packFrame(const XnDepthPixel* _depth, XnUInt8& _sequence, XnUInt32 _timestamp, vector<XnUInt8>& _packets, vector<int>& _lengths);
+    
+protected:
+    void    beginFrame(const mkPacketHeader& _header);
+    void    unpack(const XnUInt8* _data, int _length);
+    void    endFrame();
+    void    dropFrame();
+    
+    mkDepthFramePool                    pool;
+    mkTripleBuffer<mkUsbDepthFrame>     frames;
+    
+    // the frame being assembled
+    mkDepthFrameRef     current;
+    XnUInt32            currentTimestamp;
+    bool                inFrame;
+    bool                broken;
+    XnUInt8             nextSequence;
+    int                 numBytes;           // of the packed frame so far
+    int                 numPixels;
+    XnUInt32            bits;               // bits left over between packets
+    int                 numBits;
+    
+    unsigned long long  numFrames;
+    unsigned long long  numDroppedFrames;
+    unsigned long long  numLostPackets;
+    unsigned long long  numBadPackets;
+};
@@ -0,0 +1,198 @@
+#include "mkDepthPlayer.h"
+#include "mkDepthCodec.h"
+
+//--------------------------------------------------------------
+mkDepthPlayer::mkDepthPlayer() : loop(true), nextFrame(0), decodedFrame(-1), numFramesRead(0) {
+    memset(&header, 0, sizeof(header));
+    fieldOfView.fHFOV = 0;
+    fieldOfView.fVFOV = 0;
+}
+
+//--------------------------------------------------------------
+mkDepthPlayer::~mkDepthPlayer() {
+    close();
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::open(const string& _path, bool _loop) {
+    close();
+    
+    if (!file.open(ofToDataPath(_path))) {
+        ofLogError("mkDepthPlayer") << "could not open " << _path;
+        return false;
+    }
+    
+    if (file.getSize() < sizeof(header) || memcmp(file.getData(), MK_DEPTH_CONTAINER_MAGIC, 8) != 0) {
+        ofLogError("mkDepthPlayer") << _path << " is not a depth recording";
+        close();
+        return false;
+    }
+    memcpy(&header, file.getData(), sizeof(header));
+    if (header.version != MK_DEPTH_CONTAINER_VERSION || header.width == 0 || header.height == 0) {
+        ofLogError("mkDepthPlayer") << _path << " has an unsupported version or size";
+        close();
+        return false;
+    }
+    
+    if (!buildIndex()) {
+        close();
+        return false;
+    }
+    
+    fieldOfView.fHFOV = header.horizontalFov;
+    fieldOfView.fVFOV = header.verticalFov;
+    loop = _loop;
+    nextFrame = 0;
+    decodedFrame = -1;
+    numFramesRead = 0;
+    reference.reset();
+    
+    ofLogNotice("mkDepthPlayer") << "replaying " << _path << " " << header.width << "x" << header.height << ", " << index.size() << " frames";
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::buildIndex() {
+    index.clear();
+    
+    // the index written on close; its offsets come from the file as well,
+    // a damaged one falls back to the scan
+    size_t indexSize = header.numFrames * sizeof(mkDepthIndexEntry);
+    bool closed = header.indexOffset != 0 && header.indexOffset <= file.getSize();
+    size_t end = closed ? header.indexOffset : file.getSize();
+    if (closed && indexSize <= file.getSize() - header.indexOffset) {
+        index.resize(header.numFrames);
+        if (indexSize > 0)
+            memcpy(&index[0], file.getData() + header.indexOffset, indexSize);
+        bool valid = !index.empty();
+        for (int i = 0; i < index.size() && valid; i++)
+            valid = getRecordSize(index[i].offset, end) > 0;
+        if (valid)
+            return true;
+        ofLogWarning("mkDepthPlayer") << "the index is damaged, scanning the records";
+        index.clear();
+    }
+    
+    // never closed or a damaged index, scan the records up to the index
+    size_t offset = sizeof(header);
+    for (size_t recordSize = getRecordSize(offset, end); recordSize > 0; recordSize = getRecordSize(offset, end)) {
+        mkDepthFrameHeader frameHeader;
+        memcpy(&frameHeader, file.getData() + offset, sizeof(frameHeader));
+        
+        mkDepthIndexEntry entry;
+        entry.offset = offset;
+        entry.timestamp = frameHeader.timestamp;
+        entry.frameID = frameHeader.frameID;
+        entry.flags = frameHeader.flags;
+        index.push_back(entry);
+        offset += recordSize;
+    }
+    
+    if (!closed)
+        ofLogWarning("mkDepthPlayer") << "recording was not closed, recovered " << index.size() << " frames";
+    return !index.empty();
+}
+
+//--------------------------------------------------------------
+size_t mkDepthPlayer::getRecordSize(XnUInt64 _offset, size_t _end) const {
+    if (_offset < sizeof(header) || _offset > _end || _end - _offset < sizeof(mkDepthFrameHeader))
+        return 0;
+    mkDepthFrameHeader frameHeader;
+    memcpy(&frameHeader, file.getData() + _offset, sizeof(frameHeader));
+    size_t recordSize = sizeof(frameHeader) + (size_t)frameHeader.numHands * sizeof(mkDepthFileHand) + frameHeader.payloadSize;
+    return recordSize <= _end - _offset ? recordSize : 0;
+}
+
+//--------------------------------------------------------------
+void mkDepthPlayer::close() {
+    file.close();
+    index.clear();
+    reference.reset();
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::read(mkKinectFrame& _frame, mkDepthFramePool& _pool) {
+    if (!isOpen() || _pool.getNumPixels() < header.width * header.height)
+        return false;
+    
+    if (nextFrame >= index.size()) {
+        if (!loop)
+            return false;
+        nextFrame = 0;
+    }
+    
+    int frame = nextFrame++;
+    mkDepthFrameRef target = _pool.acquire();
+    if (!decodeDepth(frame, target) || !readHands(frame, _frame))
+        return false;
+    
+    reference = target;
+    _frame.depth = target;
+    _frame.sensorFrameID = index[frame].frameID;
+    _frame.sensorTimestamp = index[frame].timestamp;
+    _frame.width = header.width;
+    _frame.height = header.height;
+    
+    numFramesRead++;
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::decodeDepth(int _frame, mkDepthFrameRef& _target) {
+    
+    // the next delta frame decodes straight from the previous one
+    bool keyframe = index[_frame].flags & MK_DEPTH_FRAME_KEYFRAME;
+    if (!keyframe && decodedFrame == _frame - 1 && reference.isValid()) {
+        if (!decodePayload(_frame, reference.getPixels(), _target.getPixels()))
+            return false;
+        decodedFrame = _frame;
+        return true;
+    }
+    
+    // otherwise from the keyframe before it, deltas in place on the target
+    int first = _frame;
+    while (first > 0 && !(index[first].flags & MK_DEPTH_FRAME_KEYFRAME))
+        first--;
+    
+    for (int i = first; i <= _frame; i++) {
+        if (!decodePayload(i, (i == first) ? NULL : _target.getPixels(), _target.getPixels()))
+            return false;
+        decodedFrame = i;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::decodePayload(int _frame, const XnDepthPixel* _reference, XnDepthPixel* _target) {
+    const mkDepthIndexEntry& entry = index[_frame];
+    mkDepthFrameHeader frameHeader;
+    memcpy(&frameHeader, file.getData() + entry.offset, sizeof(frameHeader));
+    
+    size_t payloadOffset = entry.offset + sizeof(frameHeader) + frameHeader.numHands * sizeof(mkDepthFileHand);
+    if (payloadOffset + frameHeader.payloadSize > file.getSize() ||
+        !mkDepthCodec::decode(file.getData() + payloadOffset, frameHeader.payloadSize, _reference, header.width, header.height, _target)) {
+        ofLogError("mkDepthPlayer") << "corrupt frame " << _frame;
+        decodedFrame = -1;
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkDepthPlayer::readHands(int _frame, mkKinectFrame& _kinectFrame) {
+    const mkDepthIndexEntry& entry = index[_frame];
+    mkDepthFrameHeader frameHeader;
+    memcpy(&frameHeader, file.getData() + entry.offset, sizeof(frameHeader));
+    
+    const XnUInt8* hands = file.getData() + entry.offset + sizeof(frameHeader);
+    _kinectFrame.hands.resize(frameHeader.numHands);
+    for (int i = 0; i < frameHeader.numHands; i++) {
+        mkDepthFileHand fileHand;
+        memcpy(&fileHand, hands + i * sizeof(mkDepthFileHand), sizeof(fileHand));
+        mkTrackedHand& hand = _kinectFrame.hands[i];
+        hand.id = fileHand.id;
+        hand.position.set(fileHand.position[0], fileHand.position[1], fileHand.position[2]);
+        hand.worldPosition.set(fileHand.worldPosition[0], fileHand.worldPosition[1], fileHand.worldPosition[2]);
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkDepthContainer.h"
+#include "mkMappedFile.h"
+#include "mkDepthFramePool.h"
+
+// Replays a recording made with mkDepthRecorder. The file is memory mapped
+// and every frame is decoded straight into a buffer from the frame pool,
+// delta frames against the previous pooled frame, so replay copies nothing.
+// Seeking goes through the nearest keyframe.
+// No OpenNI node is involved: the pipeline reads the pooled frames, with the
+// recorded frame ids and timestamps, and sets its rays up from
+// getFieldOfView(). Hands are replayed from the file as recorded.
+
+class mkDepthPlayer {
+public:
+    mkDepthPlayer();
+    ~mkDepthPlayer();
+    
+    bool    open(const string& _path, bool _loop = true);
+    void    close();
+    bool    isOpen() const				{ return file.isOpen(); }
+    
+    // reads the next frame, returns false at the end of a non looping file
+    bool    read(mkKinectFrame& _frame, mkDepthFramePool& _pool);
+    void    seek(int _frame)			{ nextFrame = ofClamp(_frame, 0, getNumFrames()); }
+    
+    int     getWidth() const			{ return header.width; }
+    int     getHeight() const			{ return header.height; }
+    int     getNumFrames() const		{ return index.size(); }
+    int     getNumFramesRead() const	{ return numFramesRead; }
+    
+    const XnFieldOfView&	getFieldOfView() const	{ return fieldOfView; }
+    
+protected:
+    bool    buildIndex();
+    // of the whole record at _offset, 0 if it does not end by _end
+    size_t  getRecordSize(XnUInt64 _offset, size_t _end) const;
+    bool    decodeDepth(int _frame, mkDepthFrameRef& _target);
+    bool    decodePayload(int _frame, const XnDepthPixel* _reference, XnDepthPixel* _target);
+    bool    readHands(int _frame, mkKinectFrame& _kinectFrame);
+    
+    mkMappedFile        file;
+    mkDepthFileHeader   header;
+    XnFieldOfView       fieldOfView;
+    bool                loop;
+    
+    vector<mkDepthIndexEntry>   index;
+    int                         nextFrame;
+    int                         decodedFrame;
+    int                         numFramesRead;
+    mkDepthFrameRef             reference;      // last decoded frame
+};
@@ -0,0 +1,106 @@
+#include "mkDepthRecorder.h"
+#include "mkDepthCodec.h"
+
+//--------------------------------------------------------------
+mkDepthRecorder::mkDepthRecorder() : file(NULL), offset(0) {
+    memset(&header, 0, sizeof(header));
+}
+
+//--------------------------------------------------------------
+mkDepthRecorder::~mkDepthRecorder() {
+    close();
+}
+
+//--------------------------------------------------------------
+bool mkDepthRecorder::open(const string& _path, int _width, int _height, XnDepthPixel _maxDepth, const XnFieldOfView& _fieldOfView, int _keyframeInterval) {
+    close();
+    
+    file = fopen(ofToDataPath(_path).c_str(), "wb");
+    if (file == NULL) {
+        ofLogError("mkDepthRecorder") << "could not open " << _path << " for writing";
+        return false;
+    }
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MK_DEPTH_CONTAINER_MAGIC, 8);
+    header.version = MK_DEPTH_CONTAINER_VERSION;
+    header.width = _width;
+    header.height = _height;
+    header.maxDepth = _maxDepth;
+    header.horizontalFov = _fieldOfView.fHFOV;
+    header.verticalFov = _fieldOfView.fVFOV;
+    header.keyframeInterval = MAX(1, _keyframeInterval);
+    
+    fwrite(&header, sizeof(header), 1, file);
+    offset = sizeof(header);
+    
+    index.clear();
+    reference.resize(_width * _height);
+    scratch.resize(_width * _height);
+    payload.reserve(_width * _height * sizeof(XnDepthPixel));
+    
+    ofLogNotice("mkDepthRecorder") << "recording to " << _path;
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkDepthRecorder::close() {
+    if (file == NULL)
+        return;
+    
+    // index at the end, then patch the header to point at it
+    header.numFrames = index.size();
+    header.indexOffset = offset;
+    if (!index.empty())
+        fwrite(&index[0], sizeof(mkDepthIndexEntry), index.size(), file);
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    
+    fclose(file);
+    file = NULL;
+    ofLogNotice("mkDepthRecorder") << "recorded " << index.size() << " frames";
+}
+
+//--------------------------------------------------------------
+bool mkDepthRecorder::write(const mkKinectFrame& _frame) {
+    if (file == NULL || !_frame.depth.isValid() || _frame.width != header.width || _frame.height != header.height)
+        return false;
+    
+    bool keyframe = (index.size() % header.keyframeInterval) == 0;
+    payload.clear();
+    mkDepthCodec::encode(_frame.depth.getPixels(), keyframe ? NULL : &reference[0], header.width, header.height, payload, &scratch[0]);
+    
+    mkDepthFrameHeader frameHeader;
+    frameHeader.frameID = _frame.sensorFrameID;
+    frameHeader.flags = keyframe ? MK_DEPTH_FRAME_KEYFRAME : 0;
+    frameHeader.timestamp = _frame.sensorTimestamp;
+    frameHeader.numHands = _frame.hands.size();
+    frameHeader.payloadSize = payload.size();
+    
+    mkDepthIndexEntry entry;
+    entry.offset = offset;
+    entry.timestamp = frameHeader.timestamp;
+    entry.frameID = frameHeader.frameID;
+    entry.flags = frameHeader.flags;
+    
+    bool ok = fwrite(&frameHeader, sizeof(frameHeader), 1, file) == 1;
+    for (int i = 0; i < _frame.hands.size() && ok; i++) {
+        const mkTrackedHand& hand = _frame.hands[i];
+        mkDepthFileHand fileHand = { hand.id,
+            { hand.position.x, hand.position.y, hand.position.z },
+            { hand.worldPosition.x, hand.worldPosition.y, hand.worldPosition.z } };
+        ok = fwrite(&fileHand, sizeof(fileHand), 1, file) == 1;
+    }
+    ok = ok && fwrite(&payload[0], 1, payload.size(), file) == payload.size();
+    
+    if (!ok) {
+        ofLogError("mkDepthRecorder") << "write failed, closing recording";
+        close();
+        return false;
+    }
+    
+    offset += sizeof(frameHeader) + _frame.hands.size() * sizeof(mkDepthFileHand) + payload.size();
+    index.push_back(entry);
+    memcpy(&reference[0], _frame.depth.getPixels(), reference.size() * sizeof(XnDepthPixel));
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkDepthContainer.h"
+
+// Records the depth frames and hand points seen by the capture thread into a
+// compact, indexed .mkd file (see mkDepthContainer.h), replayed by
+// mkDepthPlayer.
+
+class mkDepthRecorder {
+public:
+    mkDepthRecorder();
+    ~mkDepthRecorder();
+    
+    bool    open(const string& _path, int _width, int _height, XnDepthPixel _maxDepth, const XnFieldOfView& _fieldOfView, int _keyframeInterval = 30);
+    void    close();
+    bool    isOpen() const				{ return file != NULL; }
+    
+    bool    write(const mkKinectFrame& _frame);
+    int     getNumFrames() const		{ return index.size(); }
+    
+protected:
+    FILE*               file;
+    XnUInt64            offset;
+    mkDepthFileHeader   header;
+    
+    vector<mkDepthIndexEntry>   index;
+    vector<XnDepthPixel>        reference;
+    vector<XnDepthPixel>        scratch;
+    vector<XnUInt8>             payload;
+};
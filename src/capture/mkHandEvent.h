@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOpenNI.h"
+#include "XnTypes.h"
+
+// A hand beginning, moving or ending on one device, as queued by its
+// capture thread.
+struct mkHandEvent {
+    HandStatusType      status;
+    XnUserID            id;
+    int                 deviceIndex;
+    ofPoint             position;       // projective, depth pixels
+    ofPoint             worldPosition;  // real world, mm
+    XnUInt64            sensorTimestamp;
+};
+
+// The hand events of one frame from all devices, as mkHandEventBus hands
+// them to its subscribers.
+struct mkHandEventBatch {
+    mkHandEventBatch() : frameIndex(0) {}
+    
+    unsigned long long      frameIndex;     // counts batches
+    vector<mkHandEvent>     events;         // device order, then as queued
+};
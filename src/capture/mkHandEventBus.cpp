@@ -0,0 +1,30 @@
+#include "mkHandEventBus.h"
+
+//--------------------------------------------------------------
+mkHandEventBus::mkHandEventBus() : maxEventsPerFrame(0), numDispatched(0) {
+}
+
+//--------------------------------------------------------------
+void mkHandEventBus::setup(int _maxEventsPerFrame) {
+    maxEventsPerFrame = _maxEventsPerFrame;
+    batch.events.reserve(maxEventsPerFrame);
+}
+
+//--------------------------------------------------------------
+void mkHandEventBus::update(mkMultiCapture& _captures) {
+    batch.events.clear();
+    mkHandEvent event;
+    for (int i = 0; i < _captures.getNumDevices(); i++) {
+        mkCaptureThread& device = _captures.getDevice(i);
+        while (batch.events.size() < maxEventsPerFrame && device.popHandEvent(event) == XN_STATUS_OK) {
+            event.id = _captures.getHandID(i, event.id);
+            batch.events.push_back(event);
+        }
+    }
+    if (batch.events.empty())
+        return;
+    
+    batch.frameIndex++;
+    numDispatched += batch.events.size();
+    ofNotifyEvent(batchEvent, batch);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkMultiCapture.h"
+#include "mkHandEvent.h"
+
+// Collects the hand events the capture threads queued since the last frame
+// into one batch and hands it to every subscriber in one dispatch, on the
+// render thread. The capture threads only ever push into their own
+// lock-free rings (see mkCaptureThread), so a slow subscriber costs the
+// render thread and at worst overflows a ring, it never blocks a sensor.
+//
+// Ids are moved into the space of mkMultiCapture::predictHands(), so an
+// event names the same hand as the hand lists. Subscribers register on
+// batchEvent with ofAddListener; nothing is sent for a frame without
+// events. The batch is reserved in setup() and does not allocate after:
+// a frame takes at most that many events, the rest stay in the rings for
+// the next one.
+
+class mkHandEventBus {
+public:
+    mkHandEventBus();
+    
+    void    setup(int _maxEventsPerFrame = 256);
+    
+    // render thread, once per frame
+    void    update(mkMultiCapture& _captures);
+    
+    const mkHandEventBatch&	getBatch() const		{ return batch; }
+    unsigned long long		getNumDispatched() const	{ return numDispatched; }
+    
+    ofEvent<mkHandEventBatch>	batchEvent;
+    
+protected:
+    mkHandEventBatch    batch;
+    int                 maxEventsPerFrame;
+    unsigned long long  numDispatched;
+};
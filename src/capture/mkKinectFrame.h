@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkDepthFramePool.h"
+#include "mkDepthPyramid.h"
+
+#define MK_DEPTH_WIDTH  640
+#define MK_DEPTH_HEIGHT 480
+
+struct mkTrackedHand {
+    XnUserID            id;
+    ofPoint             position;       // projective, depth pixels
+    ofPoint             worldPosition;  // real world, mm
+    ofPoint             worldVelocity;  // mm/s, from the hand filter
+};
+
+// One complete snapshot of the sensor as published by the capture thread.
+struct mkKinectFrame {
+    mkKinectFrame() : frameIndex(0), sensorFrameID(0), sensorTimestamp(0), captureTimeMicros(0), trackingMicros(0), width(0), height(0) {}
+    
+    unsigned long long      frameIndex;         // counts published frames
+    XnUInt32                sensorFrameID;
+    XnUInt64                sensorTimestamp;    // microseconds, sensor clock
+    unsigned long long      captureTimeMicros;  // ofGetElapsedTimeMicros() when captured
+    unsigned long long      trackingMicros;     // blob tracker cost, 0 with NITE
+    
+    int                     width;
+    int                     height;
+    mkDepthFrameRef         depth;              // width * height pixels from the frame pool
+    mkDepthPyramid          pyramid;            // built from depth, level 0 is depth itself
+    
+    vector<mkTrackedHand>   hands;
+};
@@ -0,0 +1,189 @@
+#include "mkLibusbEndpoint.h"
+
+// the camera's command protocol: a "GM" header, then 16 bit words, sent as
+// a vendor control request; the reply, "RB" with the same command and tag,
+// has to be polled for
+#define MK_CAMERA_COMMAND_TIMEOUT   160     // ms
+#define MK_CAMERA_REPLY_TRIES       16
+#define MK_CAMERA_WRITE_REGISTER    0x0003
+
+struct mkCameraHeader {
+    XnUInt8     magic[2];
+    XnUInt16    numWords;
+    XnUInt16    command;
+    XnUInt16    tag;
+};
+static_assert(sizeof(mkCameraHeader) == 8, "mkCameraHeader must match the wire format");
+
+//--------------------------------------------------------------
+mkLibusbEndpoint::mkLibusbEndpoint() : context(NULL), handle(NULL), tag(0) {
+}
+
+//--------------------------------------------------------------
+mkLibusbEndpoint::~mkLibusbEndpoint() {
+    close();
+}
+
+//--------------------------------------------------------------
+bool mkLibusbEndpoint::open(int _deviceIndex) {
+    close();
+    if (libusb_init(&context) != 0) {
+        ofLogError("mkLibusbEndpoint") << "could not initialize libusb";
+        context = NULL;
+        return false;
+    }
+    
+    libusb_device** devices;
+    ssize_t numDevices = libusb_get_device_list(context, &devices);
+    int numCameras = 0;
+    for (ssize_t i = 0; i < numDevices && handle == NULL; i++) {
+        libusb_device_descriptor descriptor;
+        if (libusb_get_device_descriptor(devices[i], &descriptor) != 0 || descriptor.idVendor != MK_KINECT_VENDOR_ID || descriptor.idProduct != MK_KINECT_CAMERA_ID)
+            continue;
+        if (numCameras++ == _deviceIndex && libusb_open(devices[i], &handle) != 0)
+            handle = NULL;
+    }
+    if (numDevices >= 0)
+        libusb_free_device_list(devices, 1);
+    if (handle == NULL) {
+        ofLogError("mkLibusbEndpoint") << "no Kinect camera " << _deviceIndex << " on the bus, " << numCameras << " found";
+        close();
+        return false;
+    }
+    if (libusb_claim_interface(handle, 0) != 0) {
+        ofLogError("mkLibusbEndpoint") << "could not claim the camera, is it open elsewhere?";
+        close();
+        return false;
+    }
+    
+    // projector always on, then the depth stream: 11 bit, 640 x 480, 30 fps,
+    // not mirrored
+    bool ok = writeRegister(0x105, 0x00)
+        && writeRegister(0x06, 0x00)
+        && writeRegister(0x12, 0x03)
+        && writeRegister(0x13, 0x01)
+        && writeRegister(0x14, 0x1e)
+        && writeRegister(0x06, 0x02)
+        && writeRegister(0x17, 0x00);
+    if (!ok) {
+        ofLogError("mkLibusbEndpoint") << "the camera did not start its depth stream";
+        close();
+        return false;
+    }
+    ofLogNotice("mkLibusbEndpoint") << "depth stream of camera " << _deviceIndex << " started";
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkLibusbEndpoint::close() {
+    if (handle != NULL) {
+        writeRegister(0x06, 0x00);
+        libusb_release_interface(handle, 0);
+        libusb_close(handle);
+        handle = NULL;
+    }
+    if (context != NULL) {
+        libusb_exit(context);
+        context = NULL;
+    }
+}
+
+//--------------------------------------------------------------
+bool mkLibusbEndpoint::prepare(mkUsbTransfer& _transfer) {
+    if (handle == NULL)
+        return false;
+    libusb_transfer* transfer = libusb_alloc_transfer(_transfer.numPackets);
+    if (transfer == NULL)
+        return false;
+    libusb_fill_iso_transfer(transfer, handle, MK_KINECT_DEPTH_ENDPOINT, _transfer.buffer, _transfer.numPackets * _transfer.packetSize, _transfer.numPackets, onTransfer, &_transfer, 0);
+    libusb_set_iso_packet_lengths(transfer, _transfer.packetSize);
+    _transfer.handle = transfer;
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkLibusbEndpoint::release(mkUsbTransfer& _transfer) {
+    if (_transfer.handle != NULL)
+        libusb_free_transfer((libusb_transfer*)_transfer.handle);
+    _transfer.handle = NULL;
+}
+
+//--------------------------------------------------------------
+bool mkLibusbEndpoint::submit(mkUsbTransfer& _transfer) {
+    return _transfer.handle != NULL && libusb_submit_transfer((libusb_transfer*)_transfer.handle) == 0;
+}
+
+//--------------------------------------------------------------
+void mkLibusbEndpoint::cancel(mkUsbTransfer& _transfer) {
+    if (_transfer.handle != NULL)
+        libusb_cancel_transfer((libusb_transfer*)_transfer.handle);
+}
+
+//--------------------------------------------------------------
+void mkLibusbEndpoint::handleEvents(int _timeoutMicros) {
+    timeval timeout;
+    timeout.tv_sec = _timeoutMicros / 1000000;
+    timeout.tv_usec = _timeoutMicros % 1000000;
+    libusb_handle_events_timeout(context, &timeout);
+}
+
+//--------------------------------------------------------------
+void mkLibusbEndpoint::onTransfer(libusb_transfer* _transfer) {
+    mkUsbTransfer& transfer = *(mkUsbTransfer*)_transfer->user_data;
+    if (_transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        transfer.status = MK_USB_TRANSFER_COMPLETED;
+        for (int i = 0; i < transfer.numPackets; i++) {
+            const libusb_iso_packet_descriptor& packet = _transfer->iso_packet_desc[i];
+            transfer.packetLengths[i] = packet.status == LIBUSB_TRANSFER_COMPLETED ? packet.actual_length : 0;
+        }
+    }
+    else
+        transfer.status = _transfer->status == LIBUSB_TRANSFER_CANCELLED ? MK_USB_TRANSFER_CANCELLED : MK_USB_TRANSFER_ERROR;
+    if (transfer.callback)
+        transfer.callback(&transfer);
+}
+
+//--------------------------------------------------------------
+bool mkLibusbEndpoint::writeRegister(XnUInt16 _register, XnUInt16 _value) {
+    XnUInt16 data[2] = { _register, _value };
+    XnUInt16 reply = 0xffff;
+    if (!sendCommand(MK_CAMERA_WRITE_REGISTER, data, 2, &reply, 1) || reply != 0) {
+        ofLogWarning("mkLibusbEndpoint") << "writing " << ofToHex(_value) << " to register " << ofToHex(_register) << " failed";
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkLibusbEndpoint::sendCommand(XnUInt16 _command, const XnUInt16* _data, int _numWords, XnUInt16* _reply, int _numReplyWords) {
+    XnUInt8 buffer[0x200];
+    mkCameraHeader header;
+    header.magic[0] = 'G';
+    header.magic[1] = 'M';
+    header.numWords = _numWords;
+    header.command = _command;
+    header.tag = tag++;
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), _data, _numWords * 2);
+    int length = sizeof(header) + _numWords * 2;
+    if (libusb_control_transfer(handle, 0x40, 0, 0, 0, buffer, length, MK_CAMERA_COMMAND_TIMEOUT) != length)
+        return false;
+    
+    for (int i = 0; i < MK_CAMERA_REPLY_TRIES; i++) {
+        int received = libusb_control_transfer(handle, 0xc0, 0, 0, 0, buffer, sizeof(buffer), MK_CAMERA_COMMAND_TIMEOUT);
+        if (received < 0)
+            return false;
+        if (received == 0) {
+            ofSleepMillis(10);
+            continue;
+        }
+        mkCameraHeader replyHeader;
+        memcpy(&replyHeader, buffer, sizeof(replyHeader));
+        if (received < (int)sizeof(replyHeader) || replyHeader.magic[0] != 'R' || replyHeader.magic[1] != 'B' || replyHeader.command != header.command || replyHeader.tag != header.tag)
+            return false;
+        int numWords = MIN(_numReplyWords, (received - (int)sizeof(replyHeader)) / 2);
+        memcpy(_reply, buffer + sizeof(replyHeader), numWords * 2);
+        return numWords == _numReplyWords;
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ofMain.h"
+#include "libusb.h"
+#include "mkUsbEndpoint.h"
+
+// The Kinect camera's depth endpoint through libusb's asynchronous API, for
+// mkUsbIngest. open() claims the camera and starts its 11 bit 640 x 480
+// depth stream at 30 fps with the register writes the camera protocol
+// takes; the device can not be open in OpenNI at the same time.
+
+#define MK_KINECT_VENDOR_ID     0x045e
+#define MK_KINECT_CAMERA_ID     0x02ae
+#define MK_KINECT_DEPTH_ENDPOINT 0x82
+
+class mkLibusbEndpoint : public mkUsbEndpoint {
+public:
+    mkLibusbEndpoint();
+    ~mkLibusbEndpoint();
+    
+    // _deviceIndex counts cameras on the bus
+    bool    open(int _deviceIndex = 0);
+    void    close();
+    bool    isOpen() const			{ return handle != NULL; }
+    
+    bool    prepare(mkUsbTransfer& _transfer);
+    void    release(mkUsbTransfer& _transfer);
+    bool    submit(mkUsbTransfer& _transfer);
+    void    cancel(mkUsbTransfer& _transfer);
+    void    handleEvents(int _timeoutMicros);
+    
+protected:
+    static void onTransfer(libusb_transfer* _transfer);
+    
+    bool    writeRegister(XnUInt16 _register, XnUInt16 _value);
+    bool    sendCommand(XnUInt16 _command, const XnUInt16* _data, int _numWords, XnUInt16* _reply, int _numReplyWords);
+    
+    libusb_context*         context;
+    libusb_device_handle*   handle;
+    XnUInt16                tag;
+};
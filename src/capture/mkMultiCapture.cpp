@@ -0,0 +1,136 @@
+#include "mkMultiCapture.h"
+
+//--------------------------------------------------------------
+mkMultiCapture::mkMultiCapture() : handSource(MK_HANDS_NITE), numDevices(0) {
+}
+
+//--------------------------------------------------------------
+mkMultiCapture::~mkMultiCapture() {
+    for (int i = 0; i < devices.size(); i++)
+        delete devices[i];
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::createDevices(int _numDevices) {
+    while (devices.size() < _numDevices) {
+        devices.push_back(new mkCaptureThread());
+        deviceHands.push_back(vector<mkTrackedHand>());
+        deviceHands.back().reserve(32);
+    }
+    for (int i = 0; i < _numDevices; i++) {
+        devices[i]->setHandSource(handSource);
+        devices[i]->setDeviceIndex(i);
+    }
+    numDevices = _numDevices;
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::setup(int _numDevices, int _maxNumHands) {
+    createDevices(MAX(_numDevices, 1));
+    for (int i = 0; i < numDevices; i++)
+        devices[i]->setup(_maxNumHands);
+}
+
+//--------------------------------------------------------------
+bool mkMultiCapture::setupReplay(const vector<string>& _paths, mkReplayMode _mode, bool _loop) {
+    if (_paths.empty())
+        return false;
+    createDevices(_paths.size());
+    for (int i = 0; i < numDevices; i++) {
+        if (!devices[i]->setupReplay(_paths[i], _mode, _loop)) {
+            numDevices = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::setupStage(int _fieldWidth, int _fieldHeight, const string& _calibrationPath) {
+    if (!isStitched())
+        return;
+    stage.setup(numDevices, _fieldWidth, _fieldHeight);
+    stage.load(_calibrationPath);
+    fieldTexture.allocate(_fieldWidth, _fieldHeight, GL_LUMINANCE32F_ARB);
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::start() {
+    for (int i = 0; i < numDevices; i++)
+        devices[i]->start();
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::stop() {
+    for (int i = 0; i < numDevices; i++)
+        devices[i]->stop();
+}
+
+//--------------------------------------------------------------
+bool mkMultiCapture::startRecording(const string& _basePath) {
+    if (numDevices == 1)
+        return devices[0]->startRecording(_basePath + ".mkd");
+    bool recording = true;
+    for (int i = 0; i < numDevices; i++)
+        recording = devices[i]->startRecording(_basePath + "_" + ofToString(i) + ".mkd") && recording;
+    return recording;
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::stopRecording() {
+    for (int i = 0; i < numDevices; i++)
+        devices[i]->stopRecording();
+}
+
+//--------------------------------------------------------------
+bool mkMultiCapture::isRecording() {
+    for (int i = 0; i < numDevices; i++)
+        if (devices[i]->isRecording())
+            return true;
+    return false;
+}
+
+//--------------------------------------------------------------
+bool mkMultiCapture::update() {
+    bool didUpdate = false;
+    for (int i = 0; i < numDevices; i++)
+        didUpdate = devices[i]->update() || didUpdate;
+    
+    if (didUpdate && isStitched()) {
+        stage.clearField();
+        for (int i = 0; i < numDevices; i++)
+            stage.addDepth(i, devices[i]->getFrame().pyramid, devices[i]->getDepthRays());
+    }
+    return didUpdate;
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::predictHands(unsigned long long _nowMicros, vector<mkTrackedHand>& _hands) {
+    if (!isStitched()) {
+        if (numDevices == 1)
+            devices[0]->predictHands(_nowMicros, _hands);
+        return;
+    }
+    
+    _hands.clear();
+    for (int i = 0; i < numDevices; i++) {
+        devices[i]->predictHands(_nowMicros, deviceHands[i]);
+        stage.mapHands(i, deviceHands[i], _hands);
+    }
+    stage.mergeHands(_hands);
+}
+
+//--------------------------------------------------------------
+int mkMultiCapture::getInputWidth() const {
+    return isStitched() ? stage.getFieldWidth() : MK_DEPTH_WIDTH;
+}
+
+//--------------------------------------------------------------
+int mkMultiCapture::getInputHeight() const {
+    return isStitched() ? stage.getFieldHeight() : MK_DEPTH_HEIGHT;
+}
+
+//--------------------------------------------------------------
+void mkMultiCapture::updateTexture() {
+    fieldTexture.loadData(stage.getField(), stage.getFieldWidth(), stage.getFieldHeight(), GL_LUMINANCE);
+}
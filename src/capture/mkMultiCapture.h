@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkCaptureThread.h"
+#include "mkStage.h"
+
+// Several sensors, each on a capture thread of its own with its own filter,
+// pyramid, blob tracker and hand filter, merged on the render thread into
+// one interaction field through the stage calibration.
+//
+// ofxOpenNI opens devices in the order its instances are created, so the
+// capture threads are created once, in device order, and reused when a
+// replay falls back to live capture. A single device needs no stage: its
+// hands stay in depth pixels and its depth goes through the single sensor
+// path as before. With more, hands come in field pixels and the stitched
+// field replaces the depth field of one sensor.
+
+class mkMultiCapture {
+public:
+    mkMultiCapture();
+    ~mkMultiCapture();
+    
+    // call before setup() or setupReplay()
+    void    setHandSource(mkHandSource _source)	{ handSource = _source; }
+    
+    void    setup(int _numDevices = 1, int _maxNumHands = 2);
+    // one recording per device, in device order
+    bool    setupReplay(const vector<string>& _paths, mkReplayMode _mode = MK_REPLAY_REALTIME, bool _loop = true);
+    // after setup(), loads the calibration from _calibrationPath if there is one
+    void    setupStage(int _fieldWidth, int _fieldHeight, const string& _calibrationPath);
+    void    start();
+    void    stop();
+    
+    int     getNumDevices() const			{ return numDevices; }
+    bool    isStitched() const				{ return numDevices > 1; }
+    bool    isReplaying() const				{ return numDevices > 0 && devices[0]->isReplaying(); }
+    mkCaptureThread&	getDevice(int _device)	{ return *devices[_device]; }
+    mkStage&			getStage()				{ return stage; }
+    
+    // every device records to _basePath with its index appended
+    bool    startRecording(const string& _basePath);
+    void    stopRecording();
+    bool    isRecording();
+    
+    // render thread: picks up the latest snapshot of every device and
+    // stitches them, returns true if any device had a new one
+    bool    update();
+    
+    // render thread: the hands of all devices predicted to _nowMicros and
+    // merged, in pixels of getInputWidth() x getInputHeight()
+    void    predictHands(unsigned long long _nowMicros, vector<mkTrackedHand>& _hands);
+    // the id a hand of _device has in those hands
+    XnUserID	getHandID(int _device, XnUserID _id) const	{ return isStitched() ? mkStage::getHandID(_device, _id) : _id; }
+    int     getInputWidth() const;
+    int     getInputHeight() const;
+    
+    // the stitched field, [0, 1] from far to near, at field resolution
+    const float*    getField() const	{ return stage.getField(); }
+    void            updateTexture();
+    ofTexture&      getFieldTexture()	{ return fieldTexture; }
+    
+protected:
+    void    createDevices(int _numDevices);
+    
+    mkHandSource                    handSource;
+    int                             numDevices;
+    vector<mkCaptureThread*>        devices;        // created in device order, never shrinks
+    vector<vector<mkTrackedHand> >  deviceHands;
+    mkStage                         stage;
+    ofTexture                       fieldTexture;
+};
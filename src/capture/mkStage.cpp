@@ -0,0 +1,196 @@
+#include "mkStage.h"
+
+// default placement: side by side on the wall, facing the room
+#define MK_STAGE_DEVICE_SPACING 1500
+
+//--------------------------------------------------------------
+mkDeviceCalibration::mkDeviceCalibration() {
+    parameters.setName("device");
+    parameters.add(position.set("position", ofVec3f(0, 0, 0), ofVec3f(-20000, -20000, -20000), ofVec3f(20000, 20000, 20000)));	// mm
+    parameters.add(rotation.set("rotation", ofVec3f(0, 0, 0), ofVec3f(-180, -180, -180), ofVec3f(180, 180, 180)));				// degrees
+    update();
+}
+
+//--------------------------------------------------------------
+void mkDeviceCalibration::setup(int _deviceIndex, const ofVec3f& _position, const ofVec3f& _rotation) {
+    parameters.setName("device " + ofToString(_deviceIndex));
+    position.set(_position);
+    rotation.set(_rotation);
+    update();
+}
+
+//--------------------------------------------------------------
+void mkDeviceCalibration::update() {
+    // rz * ry * rx
+    float x = rotation.get().x * DEG_TO_RAD, y = rotation.get().y * DEG_TO_RAD, z = rotation.get().z * DEG_TO_RAD;
+    float cx = cosf(x), sx = sinf(x), cy = cosf(y), sy = sinf(y), cz = cosf(z), sz = sinf(z);
+    matrix[0][0] = cz * cy;     matrix[0][1] = cz * sy * sx - sz * cx;  matrix[0][2] = cz * sy * cx + sz * sx;
+    matrix[1][0] = sz * cy;     matrix[1][1] = sz * sy * sx + cz * cx;  matrix[1][2] = sz * sy * cx - cz * sx;
+    matrix[2][0] = -sy;         matrix[2][1] = cy * sx;                 matrix[2][2] = cy * cx;
+}
+
+//--------------------------------------------------------------
+ofPoint mkDeviceCalibration::rotate(const ofVec3f& _vector) const {
+    return ofPoint(matrix[0][0] * _vector.x + matrix[0][1] * _vector.y + matrix[0][2] * _vector.z,
+                   matrix[1][0] * _vector.x + matrix[1][1] * _vector.y + matrix[1][2] * _vector.z,
+                   matrix[2][0] * _vector.x + matrix[2][1] * _vector.y + matrix[2][2] * _vector.z);
+}
+
+//--------------------------------------------------------------
+ofPoint mkDeviceCalibration::toStage(const ofPoint& _world) const {
+    return rotate(_world) + position.get();
+}
+
+//--------------------------------------------------------------
+mkStage::mkStage() : fieldWidth(0), fieldHeight(0) {
+    parameters.setName("stage");
+    parameters.add(left.set("left", -1500, -20000, 20000));					// mm
+    parameters.add(right.set("right", 1500, -20000, 20000));
+    parameters.add(bottom.set("bottom", -850, -20000, 20000));
+    parameters.add(top.set("top", 850, -20000, 20000));
+    parameters.add(nearClip.set("near", 500, 0, 10000));					// mm from the wall
+    parameters.add(farClip.set("far", 3000, 0, 10000));
+    parameters.add(mergeDistance.set("merge distance", 150, 0, 1000));	// mm
+}
+
+//--------------------------------------------------------------
+void mkStage::setup(int _numDevices, int _fieldWidth, int _fieldHeight, int _depthWidth, int _depthHeight) {
+    fieldWidth = _fieldWidth;
+    fieldHeight = _fieldHeight;
+    field.assign(fieldWidth * fieldHeight, 0);
+    
+    // one ray per column and per row of the level addDepth() picks
+    int levelWidth = _depthWidth, levelHeight = _depthHeight;
+    while (levelWidth / 2 >= fieldWidth && levelHeight / 2 >= fieldHeight) {
+        levelWidth /= 2;
+        levelHeight /= 2;
+    }
+    points.resize(levelWidth + levelHeight);
+    columnRays.resize(levelWidth);
+    rowRays.resize(levelHeight);
+    
+    // the stage spans all devices, with the aspect of the field
+    float halfWidth = (_numDevices - 1) * MK_STAGE_DEVICE_SPACING / 2 + MK_STAGE_DEVICE_SPACING;
+    float halfHeight = halfWidth * fieldHeight / fieldWidth;
+    left.set(-halfWidth);
+    right.set(halfWidth);
+    bottom.set(-halfHeight);
+    top.set(halfHeight);
+    
+    calibrations.resize(_numDevices);
+    for (int i = 0; i < _numDevices; i++) {
+        calibrations[i].setup(i, ofVec3f((i - (_numDevices - 1) * 0.5f) * MK_STAGE_DEVICE_SPACING, 0, 0));
+        parameters.add(calibrations[i].parameters);
+    }
+}
+
+//--------------------------------------------------------------
+bool mkStage::load(const string& _path) {
+    ofXml xml;
+    if (!xml.load(_path)) {
+        ofLogWarning("mkStage") << "no calibration in " << _path << ", devices stay side by side";
+        return false;
+    }
+    xml.deserialize(parameters);
+    for (int i = 0; i < calibrations.size(); i++)
+        calibrations[i].update();
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkStage::save(const string& _path) {
+    ofXml xml;
+    xml.serialize(parameters);
+    return xml.save(_path);
+}
+
+//--------------------------------------------------------------
+void mkStage::mapHands(int _device, const vector<mkTrackedHand>& _hands, vector<mkTrackedHand>& _stageHands) const {
+    const mkDeviceCalibration& calibration = calibrations[_device];
+    float scaleX = fieldWidth / (right.get() - left.get());
+    float scaleY = fieldHeight / (top.get() - bottom.get());
+    for (int i = 0; i < _hands.size(); i++) {
+        mkTrackedHand hand;
+        hand.id = getHandID(_device, _hands[i].id);
+        hand.worldPosition = calibration.toStage(_hands[i].worldPosition);
+        hand.worldVelocity = calibration.rotate(_hands[i].worldVelocity);
+        hand.position.set((hand.worldPosition.x - left.get()) * scaleX, (top.get() - hand.worldPosition.y) * scaleY, hand.worldPosition.z);
+        _stageHands.push_back(hand);
+    }
+}
+
+//--------------------------------------------------------------
+void mkStage::mergeHands(vector<mkTrackedHand>& _stageHands) const {
+    float maxSquared = mergeDistance.get() * mergeDistance.get();
+    for (int i = 0; i < _stageHands.size(); i++) {
+        mkTrackedHand& hand = _stageHands[i];
+        for (int j = i + 1; j < _stageHands.size();) {
+            const mkTrackedHand& other = _stageHands[j];
+            // the same device never sees one hand twice
+            if ((other.id >> 24) != (hand.id >> 24) && hand.worldPosition.squareDistance(other.worldPosition) < maxSquared) {
+                // keeps the id of the first device, order is by device
+                hand.worldPosition = (hand.worldPosition + other.worldPosition) * 0.5f;
+                hand.worldVelocity = (hand.worldVelocity + other.worldVelocity) * 0.5f;
+                hand.position = (hand.position + other.position) * 0.5f;
+                _stageHands.erase(_stageHands.begin() + j);
+            }
+            else
+                j++;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkStage::clearField() {
+    std::fill(field.begin(), field.end(), 0);
+}
+
+//--------------------------------------------------------------
+void mkStage::addDepth(int _device, const mkDepthPyramid& _pyramid, const mkDepthRays& _rays) {
+    mkDepthView level = _pyramid.getLevelFor(fieldWidth, fieldHeight, MK_DEPTH_AVERAGE);
+    if (!level.isValid() || !_rays.isSetup() || level.width + level.height > points.size())
+        return;
+    
+    // the rays of the block centres at 1 mm, columns first, then rows;
+    // a ray is separable, so are its x and y parts after the rotation
+    float scale = (float)_rays.getWidth() / level.width;
+    float offset = (scale - 1) * 0.5f;
+    for (int u = 0; u < level.width; u++) {
+        points[u].X = u * scale + offset;
+        points[u].Y = 0;
+        points[u].Z = 1;
+    }
+    for (int v = 0; v < level.height; v++) {
+        points[level.width + v].X = 0;
+        points[level.width + v].Y = v * scale + offset;
+        points[level.width + v].Z = 1;
+    }
+    _rays.toWorld(level.width + level.height, &points[0], &points[0]);
+    
+    // field x, field y and stage z per mm of depth, straight from the rays
+    const mkDeviceCalibration& calibration = calibrations[_device];
+    ofVec3f fieldScale(fieldWidth / (right.get() - left.get()), -fieldHeight / (top.get() - bottom.get()), 1);
+    for (int u = 0; u < level.width; u++)
+        columnRays[u] = calibration.rotate(ofVec3f(points[u].X, 0, 0)) * fieldScale;
+    for (int v = 0; v < level.height; v++)
+        rowRays[v] = calibration.rotate(ofVec3f(0, points[level.width + v].Y, 1)) * fieldScale;
+    ofVec3f origin = (calibration.toStage(ofPoint(0, 0, 0)) - ofVec3f(left.get(), top.get(), 0)) * fieldScale;
+    
+    float nearZ = nearClip.get(), farZ = MAX(farClip.get(), nearZ + 1);
+    float invRange = 1.0f / (farZ - nearZ);
+    for (int v = 0; v < level.height; v++) {
+        const XnDepthPixel* row = level.pixels + v * level.width;
+        const ofVec3f& rowRay = rowRays[v];
+        for (int u = 0; u < level.width; u++) {
+            if (row[u] == 0)
+                continue;
+            float z = row[u];
+            ofVec3f p = origin + (columnRays[u] + rowRay) * z;
+            if (p.z < nearZ || p.z > farZ || p.x < 0 || p.x >= fieldWidth || p.y < 0 || p.y >= fieldHeight)
+                continue;
+            float value = (farZ - p.z) * invRange;
+            float& target = field[(int)p.y * fieldWidth + (int)p.x];
+            target = MAX(target, value);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkDepthPyramid.h"
+#include "mkDepthRays.h"
+
+// Where a sensor hangs on the stage: real world points of the device, in mm,
+// are rotated by the rotation in degrees (x, then y, then z) and moved by
+// the position.
+class mkDeviceCalibration {
+public:
+    mkDeviceCalibration();
+    
+    void    setup(int _deviceIndex, const ofVec3f& _position = ofVec3f(0, 0, 0), const ofVec3f& _rotation = ofVec3f(0, 0, 0));
+    
+    // refreshes the transform from the parameters
+    void    update();
+    
+    ofPoint toStage(const ofPoint& _world) const;
+    ofPoint rotate(const ofVec3f& _vector) const;
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    ofParameter<ofVec3f>	position;
+    ofParameter<ofVec3f>	rotation;
+    
+    float   matrix[3][3];
+};
+
+// The shared coordinate system of several sensors, in mm: x along the wall,
+// y up and z away from the wall. Every device is calibrated into it, and it
+// maps a rectangle of the wall, left to right and bottom to top, onto one
+// interaction field that the forces and the depth flow use for all sensors.
+//
+// Hands of every device are moved into field pixels, where hands of two
+// devices that are closer than the merge distance are one hand seen twice
+// in the overlap. Depth is stitched by splatting a reduced pyramid level of
+// every device into the field, nearest to the wall wins, with the same 1 at
+// near to 0 at far mapping as the single sensor field. Rays and calibration
+// fold into one table per column and one per row of the level, so a sample
+// costs a multiply add per axis.
+//
+// All storage is sized by setup(); mapping and stitching do not allocate.
+
+class mkStage {
+public:
+    mkStage();
+    
+    void    setup(int _numDevices, int _fieldWidth, int _fieldHeight, int _depthWidth = MK_DEPTH_WIDTH, int _depthHeight = MK_DEPTH_HEIGHT);
+    
+    // the stage rectangle and every calibration, as xml
+    bool    load(const string& _path);
+    bool    save(const string& _path);
+    
+    int     getNumDevices() const		{ return calibrations.size(); }
+    int     getFieldWidth() const		{ return fieldWidth; }
+    int     getFieldHeight() const		{ return fieldHeight; }
+    mkDeviceCalibration&	getCalibration(int _device)		{ return calibrations[_device]; }
+    
+    // appends the hands of one device in field pixels and stage mm, ids are
+    // made unique by putting the device in the top byte
+    void    mapHands(int _device, const vector<mkTrackedHand>& _hands, vector<mkTrackedHand>& _stageHands) const;
+    // averages hands of different devices closer than the merge distance
+    void    mergeHands(vector<mkTrackedHand>& _stageHands) const;
+    static XnUserID	getHandID(int _device, XnUserID _id)	{ return (_device << 24) | (_id & 0xffffff); }
+    
+    // stitching: clear once per frame, then add every device
+    void    clearField();
+    void    addDepth(int _device, const mkDepthPyramid& _pyramid, const mkDepthRays& _rays);
+    
+    const float*    getField() const	{ return &field[0]; }
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    ofParameter<float>	left;
+    ofParameter<float>	right;
+    ofParameter<float>	bottom;
+    ofParameter<float>	top;
+    ofParameter<float>	nearClip;
+    ofParameter<float>	farClip;
+    ofParameter<float>	mergeDistance;
+    
+    int     fieldWidth;
+    int     fieldHeight;
+    
+    vector<mkDeviceCalibration> calibrations;
+    vector<float>               field;
+    vector<XnPoint3D>           points;
+    vector<ofVec3f>             columnRays;
+    vector<ofVec3f>             rowRays;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+
+// Where mkUsbIngest sends its isochronous reads: the sensor's endpoint
+// through libusb (mkLibusbEndpoint) or a replayed packet stream
+// (mkUsbLoopback). Transfers are submitted and come back through the
+// transfer's callback, from inside handleEvents(), on the thread that calls
+// it, in the order they were submitted.
+
+#define MK_USB_MAX_PACKETS_PER_TRANSFER 64
+
+enum mkUsbTransferStatus {
+    MK_USB_TRANSFER_COMPLETED = 0,
+    MK_USB_TRANSFER_ERROR,
+    MK_USB_TRANSFER_CANCELLED
+};
+
+struct mkUsbTransfer;
+typedef void (*mkUsbCallback)(mkUsbTransfer* _transfer);
+
+struct mkUsbTransfer {
+    mkUsbTransfer() : buffer(NULL), numPackets(0), packetSize(0), status(MK_USB_TRANSFER_COMPLETED), handle(NULL), callback(NULL), userData(NULL) {}
+    
+    XnUInt8*            buffer;         // numPackets * packetSize bytes
+    int                 numPackets;
+    int                 packetSize;
+    int                 packetLengths[MK_USB_MAX_PACKETS_PER_TRANSFER];    // received into each slot, 0 for none
+    mkUsbTransferStatus status;
+    void*               handle;         // the endpoint's own transfer
+    mkUsbCallback       callback;
+    void*               userData;
+};
+
+class mkUsbEndpoint {
+public:
+    virtual ~mkUsbEndpoint() {}
+    
+    // before the first submit and after the last completion
+    virtual bool    prepare(mkUsbTransfer&)		{ return true; }
+    virtual void    release(mkUsbTransfer&)		{}
+    
+    virtual bool    submit(mkUsbTransfer& _transfer) = 0;
+    // the transfer still comes back, MK_USB_TRANSFER_CANCELLED
+    virtual void    cancel(mkUsbTransfer& _transfer) = 0;
+    // completes what is due, waiting up to _timeoutMicros for it
+    virtual void    handleEvents(int _timeoutMicros) = 0;
+};
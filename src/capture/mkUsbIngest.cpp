@@ -0,0 +1,162 @@
+#include "mkUsbIngest.h"
+#include "XnOS.h"
+#include "mkSimd.h"
+
+//--------------------------------------------------------------
+mkUsbIngest::mkUsbIngest() : endpoint(NULL), capture(NULL), buffer(NULL), numInFlight(0), stopping(false), numTransfers(0), numErrors(0), startMicros(0), lastFrameMicros(0), numIntervals(0), intervalMean(0), intervalM2(0), maxInterval(0) {
+}
+
+//--------------------------------------------------------------
+mkUsbIngest::~mkUsbIngest() {
+    stop();
+    clear();
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::setup(mkUsbEndpoint* _endpoint, int _numTransfers, int _packetsPerTransfer, int _numFrameBuffers) {
+    stop();
+    clear();
+    
+    endpoint = _endpoint;
+    int numPackets = ofClamp(_packetsPerTransfer, 1, MK_USB_MAX_PACKETS_PER_TRANSFER);
+    transfers.resize(MAX(_numTransfers, 1));
+    buffer = (XnUInt8*)xnOSMallocAligned(transfers.size() * numPackets * MK_DEPTH_PACKET_SIZE, MK_CACHE_LINE_SIZE);
+    for (int i = 0; i < transfers.size(); i++) {
+        mkUsbTransfer& transfer = transfers[i];
+        transfer.buffer = buffer + i * numPackets * MK_DEPTH_PACKET_SIZE;
+        transfer.numPackets = numPackets;
+        transfer.packetSize = MK_DEPTH_PACKET_SIZE;
+        transfer.callback = onTransfer;
+        transfer.userData = this;
+    }
+    assembler.setup(_numFrameBuffers);
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::clear() {
+    if (endpoint != NULL)
+        for (int i = 0; i < transfers.size(); i++)
+            endpoint->release(transfers[i]);
+    transfers.clear();
+    if (buffer != NULL)
+        xnOSFreeAligned(buffer);
+    buffer = NULL;
+}
+
+//--------------------------------------------------------------
+bool mkUsbIngest::start() {
+    if (endpoint == NULL || transfers.empty() || isThreadRunning())
+        return false;
+    
+    numTransfers = 0;
+    numErrors = 0;
+    numIntervals = 0;
+    intervalMean = 0;
+    intervalM2 = 0;
+    maxInterval = 0;
+    lastFrameMicros = 0;
+    startMicros = ofGetElapsedTimeMicros();
+    stopping = false;
+    
+    // the whole ring goes out before the thread starts handling it
+    numInFlight = 0;
+    for (int i = 0; i < transfers.size(); i++) {
+        if (transfers[i].handle == NULL && !endpoint->prepare(transfers[i]))
+            break;
+        if (!endpoint->submit(transfers[i]))
+            break;
+        numInFlight++;
+    }
+    if (numInFlight < transfers.size()) {
+        ofLogError("mkUsbIngest") << "could only submit " << numInFlight << " of " << transfers.size() << " transfers";
+        for (int i = 0; i < numInFlight; i++)
+            endpoint->cancel(transfers[i]);
+        stopping = true;
+        for (int tries = 0; numInFlight > 0 && tries < 100; tries++)
+            endpoint->handleEvents(MK_USB_INGEST_EVENT_TIMEOUT);
+        return false;
+    }
+    
+    startThread(true);
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::stop() {
+    if (isThreadRunning())
+        waitForThread(true);
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::threadedFunction() {
+    while (isThreadRunning())
+        endpoint->handleEvents(MK_USB_INGEST_EVENT_TIMEOUT);
+    
+    // every transfer has to come back before its buffer can go
+    stopping = true;
+    for (int i = 0; i < transfers.size(); i++)
+        endpoint->cancel(transfers[i]);
+    for (int tries = 0; numInFlight > 0 && tries < 100; tries++)
+        endpoint->handleEvents(MK_USB_INGEST_EVENT_TIMEOUT);
+    if (numInFlight > 0)
+        ofLogWarning("mkUsbIngest") << numInFlight << " transfers did not come back";
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::onTransfer(mkUsbTransfer* _transfer) {
+    ((mkUsbIngest*)_transfer->userData)->complete(*_transfer);
+}
+
+//--------------------------------------------------------------
+void mkUsbIngest::complete(mkUsbTransfer& _transfer) {
+    numInFlight--;
+    if (_transfer.status == MK_USB_TRANSFER_CANCELLED)
+        return;
+    
+    numTransfers++;
+    if (_transfer.status == MK_USB_TRANSFER_ERROR)
+        numErrors++;
+    else {
+        unsigned long long now = ofGetElapsedTimeMicros();
+        for (int i = 0; i < _transfer.numPackets; i++) {
+            int length = _transfer.packetLengths[i];
+            if (length == 0)
+                continue;
+            const XnUInt8* packet = _transfer.buffer + i * _transfer.packetSize;
+            if (capture != NULL)
+                capture->addPacket(packet, length, now - startMicros);
+            if (!assembler.addPacket(packet, length))
+                continue;
+            
+            if (lastFrameMicros > 0) {
+                unsigned long long interval = now - lastFrameMicros;
+                numIntervals++;
+                double delta = interval - intervalMean;
+                intervalMean += delta / numIntervals;
+                intervalM2 += delta * (interval - intervalMean);
+                maxInterval = MAX(maxInterval, interval);
+            }
+            lastFrameMicros = now;
+        }
+    }
+    
+    // straight back into the ring
+    if (stopping)
+        return;
+    if (endpoint->submit(_transfer))
+        numInFlight++;
+    else {
+        numErrors++;
+        ofLogWarning("mkUsbIngest") << "resubmit failed, " << numInFlight << " transfers left in flight";
+    }
+}
+
+//--------------------------------------------------------------
+double mkUsbIngest::getMeanInterval() const {
+    return intervalMean;
+}
+
+//--------------------------------------------------------------
+double mkUsbIngest::getIntervalDeviation() const {
+    return numIntervals > 1 ? sqrt(intervalM2 / (numIntervals - 1)) : 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkUsbEndpoint.h"
+#include "mkUsbLoopback.h"
+#include "mkDepthPackets.h"
+
+// Raw depth ingest without the OpenNI sensor module: keeps a ring of
+// asynchronous isochronous reads in flight on an endpoint and feeds every
+// packet that comes back to a mkDepthPacketAssembler, which unpacks it
+// straight into a pooled frame. Each transfer is resubmitted from its own
+// completion, so the number in flight stays what setup() asked for; more
+// transfers ride out longer stalls of this thread, fewer packets per
+// transfer hand frames over sooner.
+//
+// Completions run on this thread, inside the endpoint's handleEvents(). The
+// render thread takes the newest complete frame with update() and
+// getFrame(). The counts and frame intervals belong to this thread, read
+// them once it stopped.
+
+#define MK_USB_INGEST_EVENT_TIMEOUT 10000   // us
+
+class mkUsbIngest : public ofThread {
+public:
+    mkUsbIngest();
+    ~mkUsbIngest();
+    
+    // _numTransfers in flight of _packetsPerTransfer packets each
+    void    setup(mkUsbEndpoint* _endpoint, int _numTransfers = 16, int _packetsPerTransfer = 16, int _numFrameBuffers = 8);
+    bool    start();
+    void    stop();
+    
+    // keeps every packet received in _capture, for mkUsbLoopback to replay;
+    // set before start()
+    void    setCapture(mkUsbLoopback* _capture)	{ capture = _capture; }
+    
+    // render thread: returns true if a new frame arrived since the last call
+    bool    update()							{ return assembler.update(); }
+    const mkUsbDepthFrame& getFrame() const	{ return assembler.getFrame(); }
+    
+    const mkDepthPacketAssembler& getAssembler() const	{ return assembler; }
+    unsigned long long  getNumTransfers() const		{ return numTransfers; }
+    unsigned long long  getNumErrors() const			{ return numErrors; }
+    // between consecutive frames, us
+    double              getMeanInterval() const;
+    double              getIntervalDeviation() const;
+    unsigned long long  getMaxInterval() const			{ return maxInterval; }
+    
+protected:
+    static void onTransfer(mkUsbTransfer* _transfer);
+    void    complete(mkUsbTransfer& _transfer);
+    void    threadedFunction();
+    void    clear();
+    
+    mkUsbEndpoint*          endpoint;
+    mkUsbLoopback*          capture;
+    mkDepthPacketAssembler  assembler;
+    
+    vector<mkUsbTransfer>   transfers;
+    XnUInt8*                buffer;         // all transfers' packets
+    int                     numInFlight;
+    bool                    stopping;
+    
+    unsigned long long      numTransfers;
+    unsigned long long      numErrors;
+    unsigned long long      startMicros;
+    unsigned long long      lastFrameMicros;
+    
+    // running mean and variance of the frame intervals
+    unsigned long long      numIntervals;
+    double                  intervalMean;
+    double                  intervalM2;
+    unsigned long long      maxInterval;
+};
@@ -0,0 +1,190 @@
+#include "mkUsbLoopback.h"
+
+#define MK_USB_STREAM_MAGIC     "MKUSBPKT"
+#define MK_USB_STREAM_VERSION   1
+
+struct mkUsbStreamHeader {
+    char        magic[8];
+    XnUInt32    version;
+    XnUInt32    numPackets;
+};
+
+struct mkUsbStreamPacket {
+    XnUInt64    arrivalMicros;
+    XnUInt32    length;
+    XnUInt32    reserved;
+};
+
+//--------------------------------------------------------------
+mkUsbLoopback::mkUsbLoopback() : realtime(true), loop(false), dropInterval(0), firstPending(0), numPending(0), nextPacket(0), numReplayed(0), startMicros(0) {
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::setup(bool _realtime, bool _loop) {
+    realtime = _realtime;
+    loop = _loop;
+    firstPending = 0;
+    numPending = 0;
+    nextPacket = 0;
+    numReplayed = 0;
+    startMicros = 0;
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::clear() {
+    packets.clear();
+    offsets.clear();
+    lengths.clear();
+    arrivals.clear();
+    nextPacket = 0;
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::addPacket(const XnUInt8* _packet, int _length, unsigned long long _arrivalMicros) {
+    offsets.push_back(packets.size());
+    lengths.push_back(_length);
+    arrivals.push_back(_arrivalMicros);
+    packets.insert(packets.end(), _packet, _packet + _length);
+}
+
+//--------------------------------------------------------------
+bool mkUsbLoopback::save(const string& _path) const {
+    FILE* file = fopen(ofToDataPath(_path).c_str(), "wb");
+    if (file == NULL) {
+        ofLogError("mkUsbLoopback") << "could not open " << _path << " for writing";
+        return false;
+    }
+    
+    mkUsbStreamHeader header;
+    memcpy(header.magic, MK_USB_STREAM_MAGIC, 8);
+    header.version = MK_USB_STREAM_VERSION;
+    header.numPackets = offsets.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < offsets.size() && ok; i++) {
+        mkUsbStreamPacket packet = { arrivals[i], (XnUInt32)lengths[i], 0 };
+        ok = fwrite(&packet, sizeof(packet), 1, file) == 1 && fwrite(&packets[offsets[i]], 1, lengths[i], file) == lengths[i];
+    }
+    fclose(file);
+    
+    if (!ok)
+        ofLogError("mkUsbLoopback") << "write to " << _path << " failed";
+    return ok;
+}
+
+//--------------------------------------------------------------
+bool mkUsbLoopback::load(const string& _path) {
+    FILE* file = fopen(ofToDataPath(_path).c_str(), "rb");
+    if (file == NULL) {
+        ofLogError("mkUsbLoopback") << "could not open " << _path;
+        return false;
+    }
+    
+    clear();
+    mkUsbStreamHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MK_USB_STREAM_MAGIC, 8) == 0 && header.version == MK_USB_STREAM_VERSION;
+    vector<XnUInt8> packet;
+    for (XnUInt32 i = 0; i < header.numPackets && ok; i++) {
+        mkUsbStreamPacket packetHeader;
+        ok = fread(&packetHeader, sizeof(packetHeader), 1, file) == 1;
+        if (ok) {
+            packet.resize(packetHeader.length);
+            ok = packetHeader.length == 0 || fread(&packet[0], 1, packetHeader.length, file) == packetHeader.length;
+        }
+        if (ok)
+            addPacket(packet.empty() ? NULL : &packet[0], packet.size(), packetHeader.arrivalMicros);
+    }
+    fclose(file);
+    
+    if (!ok) {
+        ofLogError("mkUsbLoopback") << _path << " is not a packet stream or is cut short";
+        clear();
+        return false;
+    }
+    ofLogNotice("mkUsbLoopback") << "loaded " << offsets.size() << " packets from " << _path;
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkUsbLoopback::submit(mkUsbTransfer& _transfer) {
+    if (numPending == MK_USB_LOOPBACK_MAX_TRANSFERS || _transfer.numPackets > MK_USB_MAX_PACKETS_PER_TRANSFER)
+        return false;
+    
+    // the stream starts with the first transfer that waits for it
+    if (startMicros == 0)
+        startMicros = ofGetElapsedTimeMicros();
+    _transfer.status = MK_USB_TRANSFER_COMPLETED;
+    pending[(firstPending + numPending) % MK_USB_LOOPBACK_MAX_TRANSFERS] = &_transfer;
+    numPending++;
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::cancel(mkUsbTransfer& _transfer) {
+    _transfer.status = MK_USB_TRANSFER_CANCELLED;
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::handleEvents(int _timeoutMicros) {
+    unsigned long long now = ofGetElapsedTimeMicros();
+    unsigned long long deadline = now + _timeoutMicros;
+    
+    // only the transfers pending now, those the callbacks submit wait for
+    // the next call
+    int numDue = numPending, numCompleted = 0;
+    while (numCompleted < numDue) {
+        mkUsbTransfer& transfer = *pending[firstPending];
+        if (transfer.status != MK_USB_TRANSFER_CANCELLED) {
+            // a replayed stream that ended leaves its transfers waiting,
+            // as a device that stopped sending would
+            if (isDone() || offsets.empty())
+                break;
+            if (realtime) {
+                int last = MIN(nextPacket + transfer.numPackets, (int)offsets.size()) - 1;
+                unsigned long long due = startMicros + arrivals[last];
+                if (due > deadline)
+                    break;
+                if (due > now) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+                    now = ofGetElapsedTimeMicros();
+                }
+            }
+            fill(transfer);
+        }
+        
+        firstPending = (firstPending + 1) % MK_USB_LOOPBACK_MAX_TRANSFERS;
+        numPending--;
+        numCompleted++;
+        if (transfer.callback)
+            transfer.callback(&transfer);
+    }
+    
+    // nothing was due before the deadline
+    now = ofGetElapsedTimeMicros();
+    if (numCompleted == 0 && now < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(deadline - now));
+}
+
+//--------------------------------------------------------------
+void mkUsbLoopback::fill(mkUsbTransfer& _transfer) {
+    for (int s = 0; s < _transfer.numPackets; s++) {
+        if (nextPacket == offsets.size() && loop) {
+            // the next pass starts one packet interval after this one ended
+            startMicros += getDuration() + getDuration() / offsets.size();
+            nextPacket = 0;
+        }
+        if (nextPacket == offsets.size()) {
+            _transfer.packetLengths[s] = 0;
+            continue;
+        }
+        
+        int i = nextPacket++;
+        if (dropInterval > 0 && ++numReplayed % dropInterval == 0) {
+            _transfer.packetLengths[s] = 0;
+            continue;
+        }
+        int length = MIN(lengths[i], _transfer.packetSize);
+        memcpy(_transfer.buffer + s * _transfer.packetSize, &packets[offsets[i]], length);
+        _transfer.packetLengths[s] = length;
+    }
+    _transfer.status = MK_USB_TRANSFER_COMPLETED;
+}
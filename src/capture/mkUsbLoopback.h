@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkUsbEndpoint.h"
+
+#define MK_USB_LOOPBACK_MAX_TRANSFERS 256
+
+// An endpoint without a device: replays a captured packet stream into the
+// transfers submitted to it, one packet per isochronous slot, in order.
+// Realtime replay completes a transfer once the arrival time of its last
+// packet has come, as the bus would; otherwise transfers complete as fast
+// as they are submitted, which measures the reassembly alone.
+//
+// A stream is built with addPacket() or kept from a live session with
+// mkUsbIngest::setCapture(), and stored with save() / load(). Every n-th
+// packet can be dropped, as a congested bus does, to exercise recovery.
+
+class mkUsbLoopback : public mkUsbEndpoint {
+public:
+    mkUsbLoopback();
+    
+    void    setup(bool _realtime = true, bool _loop = false);
+    void    clear();
+    
+    // _arrivalMicros from the start of the stream; not thread safe with a
+    // replay in progress, except from the thread that handles its events
+    void    addPacket(const XnUInt8* _packet, int _length, unsigned long long _arrivalMicros);
+    bool    save(const string& _path) const;
+    bool    load(const string& _path);
+    
+    // 0 drops nothing
+    void    setDropInterval(int _interval)		{ dropInterval = _interval; }
+    
+    bool    submit(mkUsbTransfer& _transfer);
+    void    cancel(mkUsbTransfer& _transfer);
+    void    handleEvents(int _timeoutMicros);
+    
+    // true once a stream that does not loop has been replayed
+    bool    isDone() const						{ return !loop && nextPacket >= (int)offsets.size(); }
+    int     getNumPackets() const				{ return offsets.size(); }
+    unsigned long long	getDuration() const		{ return arrivals.empty() ? 0 : arrivals.back(); }
+    
+protected:
+    void    fill(mkUsbTransfer& _transfer);
+    
+    vector<XnUInt8>             packets;
+    vector<size_t>              offsets;
+    vector<int>                 lengths;
+    vector<unsigned long long>  arrivals;
+    
+    bool                realtime;
+    bool                loop;
+    int                 dropInterval;
+    
+    // the replay
+    mkUsbTransfer*          pending[MK_USB_LOOPBACK_MAX_TRANSFERS];
+    int                     firstPending;
+    int                     numPending;
+    int                     nextPacket;
+    unsigned long long      numReplayed;
+    unsigned long long      startMicros;    // of the current pass through the stream
+};
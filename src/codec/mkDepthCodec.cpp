@@ -0,0 +1,244 @@
+#include "mkDepthCodec.h"
+#include "mkSimd.h"
+#include <cstring>
+
+#define MK_RUN_SHORT_MAX    127
+#define MK_RUN_LONG_MAX     65535
+#define MK_LITERAL_MAX      64
+
+//--------------------------------------------------------------
+void mkDepthCodec::encode(const XnDepthPixel* _depth, const XnDepthPixel* _reference, int _width, int _height,
+                          std::vector<XnUInt8>& _out, XnDepthPixel* _scratch) {
+    
+    int count = _width * _height;
+    computeResiduals(_depth, _reference, _width, _height, _scratch);
+    const XnInt16* residuals = (const XnInt16*)_scratch;
+    
+    int i = 0;
+    while (i < count) {
+        if (residuals[i] == 0) {
+            int run = countZeros(_scratch + i, std::min(count - i, MK_RUN_LONG_MAX));
+            if (run <= MK_RUN_SHORT_MAX) {
+                _out.push_back(run - 1);
+            }
+            else {
+                _out.push_back(0x7f);
+                _out.push_back(run & 0xff);
+                _out.push_back(run >> 8);
+            }
+            i += run;
+            continue;
+        }
+        
+        // literals up to the next zero run or the next change in width,
+        // narrow groups swallow single zeros to keep noisy areas in one token
+        bool wide = residuals[i] < -128 || residuals[i] > 127;
+        int n = 1;
+        while (n < MK_LITERAL_MAX && i + n < count) {
+            XnInt16 r = residuals[i + n];
+            if (r == 0 && (wide || i + n + 1 >= count || residuals[i + n + 1] == 0))
+                break;
+            if ((r < -128 || r > 127) != wide)
+                break;
+            n++;
+        }
+        
+        _out.push_back((wide ? 0xc0 : 0x80) + n - 1);
+        for (int k = 0; k < n; k++) {
+            XnInt16 r = residuals[i + k];
+            if (wide) {
+                _out.push_back(r & 0xff);
+                _out.push_back((r >> 8) & 0xff);
+            }
+            else {
+                _out.push_back((XnUInt8)(XnInt8)r);
+            }
+        }
+        i += n;
+    }
+}
+
+//--------------------------------------------------------------
+void mkDepthCodec::computeResiduals(const XnDepthPixel* _depth, const XnDepthPixel* _reference, int _width, int _height, XnDepthPixel* _residuals) {
+    
+    if (_reference) {
+        int count = _width * _height;
+        int i = 0;
+#ifdef MK_SIMD_SSE2
+        for (; i + 8 <= count; i += 8) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(_depth + i));
+            __m128i r = _mm_loadu_si128((const __m128i*)(_reference + i));
+            _mm_storeu_si128((__m128i*)(_residuals + i), _mm_sub_epi16(d, r));
+        }
+#endif
+        for (; i < count; i++)
+            _residuals[i] = _depth[i] - _reference[i];
+        return;
+    }
+    
+    // keyframe, predict from the left neighbour
+    for (int y = 0; y < _height; y++) {
+        const XnDepthPixel* row = _depth + y * _width;
+        XnDepthPixel* out = _residuals + y * _width;
+        out[0] = row[0];
+        int x = 1;
+#ifdef MK_SIMD_SSE2
+        for (; x + 8 <= _width; x += 8) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i l = _mm_loadu_si128((const __m128i*)(row + x - 1));
+            _mm_storeu_si128((__m128i*)(out + x), _mm_sub_epi16(d, l));
+        }
+#endif
+        for (; x < _width; x++)
+            out[x] = row[x] - row[x - 1];
+    }
+}
+
+//--------------------------------------------------------------
+int mkDepthCodec::countZeros(const XnDepthPixel* _residuals, int _count) {
+    int n = 0;
+#ifdef MK_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; n + 8 <= _count; n += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(_residuals + n));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) != 0xffff)
+            break;
+    }
+#endif
+    while (n < _count && _residuals[n] == 0)
+        n++;
+    return n;
+}
+
+//--------------------------------------------------------------
+bool mkDepthCodec::decode(const XnUInt8* _data, size_t _size, const XnDepthPixel* _reference, int _width, int _height,
+                          XnDepthPixel* _depth) {
+    
+    if (_reference == NULL)
+        return decodeKeyframe(_data, _size, _width, _height, _depth);
+    
+    int count = _width * _height;
+    int i = 0;
+    const XnUInt8* p = _data;
+    const XnUInt8* end = _data + _size;
+    
+    while (p < end) {
+        XnUInt8 c = *p++;
+        
+        if (c <= 0x7f) {
+            int run = c + 1;
+            if (c == 0x7f) {
+                if (end - p < 2)
+                    return false;
+                run = p[0] | (p[1] << 8);
+                p += 2;
+            }
+            if (i + run > count)
+                return false;
+            // in place the reference already holds the unchanged pixels
+            if (_depth != _reference)
+                memcpy(_depth + i, _reference + i, run * sizeof(XnDepthPixel));
+            i += run;
+            continue;
+        }
+        
+        bool wide = c >= 0xc0;
+        int n = wide ? c - 0xbf : c - 0x7f;
+        int bytes = wide ? n * 2 : n;
+        if (i + n > count || end - p < bytes)
+            return false;
+        addResiduals(_depth + i, _reference + i, p, n, wide);
+        p += bytes;
+        i += n;
+    }
+    
+    return i == count;
+}
+
+//--------------------------------------------------------------
+void mkDepthCodec::addResiduals(XnDepthPixel* _depth, const XnDepthPixel* _reference, const XnUInt8* _data, int _count, bool _wide) {
+    int k = 0;
+#ifdef MK_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 8 <= _count; k += 8) {
+        __m128i r;
+        if (_wide) {
+            r = _mm_loadu_si128((const __m128i*)(_data + k * 2));
+        }
+        else {
+            // sign extend 8 int8 to int16
+            __m128i b = _mm_loadl_epi64((const __m128i*)(_data + k));
+            r = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+        }
+        __m128i ref = _reference ? _mm_loadu_si128((const __m128i*)(_reference + k)) : zero;
+        _mm_storeu_si128((__m128i*)(_depth + k), _mm_add_epi16(ref, r));
+    }
+#endif
+    for (; k < _count; k++) {
+        XnInt16 r = _wide ? (XnInt16)(_data[k * 2] | (_data[k * 2 + 1] << 8)) : (XnInt8)_data[k];
+        _depth[k] = (_reference ? _reference[k] : 0) + r;
+    }
+}
+
+//--------------------------------------------------------------
+bool mkDepthCodec::decodeKeyframe(const XnUInt8* _data, size_t _size, int _width, int _height, XnDepthPixel* _depth) {
+    
+    // first the residuals, then a running sum along every row
+    int count = _width * _height;
+    int i = 0;
+    const XnUInt8* p = _data;
+    const XnUInt8* end = _data + _size;
+    
+    while (p < end) {
+        XnUInt8 c = *p++;
+        
+        if (c <= 0x7f) {
+            int run = c + 1;
+            if (c == 0x7f) {
+                if (end - p < 2)
+                    return false;
+                run = p[0] | (p[1] << 8);
+                p += 2;
+            }
+            if (i + run > count)
+                return false;
+            memset(_depth + i, 0, run * sizeof(XnDepthPixel));
+            i += run;
+            continue;
+        }
+        
+        bool wide = c >= 0xc0;
+        int n = wide ? c - 0xbf : c - 0x7f;
+        int bytes = wide ? n * 2 : n;
+        if (i + n > count || end - p < bytes)
+            return false;
+        addResiduals(_depth + i, NULL, p, n, wide);
+        p += bytes;
+        i += n;
+    }
+    
+    if (i != count)
+        return false;
+    
+    for (int y = 0; y < _height; y++) {
+        XnDepthPixel* row = _depth + y * _width;
+        int x = 0;
+#ifdef MK_SIMD_SSE2
+        __m128i carry = _mm_setzero_si128();
+        for (; x + 8 <= _width; x += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+            v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+            v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi16(v, carry);
+            _mm_storeu_si128((__m128i*)(row + x), v);
+            // broadcast the last lane
+            carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        }
+#endif
+        for (; x < _width; x++)
+            row[x] += (x > 0) ? row[x - 1] : 0;
+    }
+    
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "XnTypes.h"
+#include <vector>
+
+// Lossless delta + run-length codec for XnDepthPixel frames.
+//
+// A keyframe predicts every pixel from its left neighbour (0 at the start of
+// a row), a delta frame from the same pixel of a reference frame. The
+// residuals are stored as a byte stream of tokens:
+//
+//   0x00 - 0x7e    run of (c + 1) zero residuals
+//   0x7f           run of zero residuals, length in the following uint16
+//   0x80 - 0xbf    (c - 0x7f) residuals follow as int8
+//   0xc0 - 0xff    (c - 0xbf) residuals follow as int16
+//
+// Static parts of the scene are zero runs, which the decoder skips entirely
+// when decoding a delta frame in place over its reference.
+
+class mkDepthCodec {
+public:
+    // appends the encoded frame to _out, a NULL _reference encodes a keyframe;
+    // _scratch must hold _width * _height pixels
+    static void encode(const XnDepthPixel* _depth, const XnDepthPixel* _reference, int _width, int _height,
+                       std::vector<XnUInt8>& _out, XnDepthPixel* _scratch);
+    
+    // decodes into _depth, which may be the same buffer as _reference;
+    // returns false on a corrupt stream
+    static bool decode(const XnUInt8* _data, size_t _size, const XnDepthPixel* _reference, int _width, int _height,
+                       XnDepthPixel* _depth);
+    
+protected:
+    static void computeResiduals(const XnDepthPixel* _depth, const XnDepthPixel* _reference, int _width, int _height, XnDepthPixel* _residuals);
+    static int  countZeros(const XnDepthPixel* _residuals, int _count);
+    static void addResiduals(XnDepthPixel* _depth, const XnDepthPixel* _reference, const XnUInt8* _data, int _count, bool _wide);
+    static bool decodeKeyframe(const XnUInt8* _data, size_t _size, int _width, int _height, XnDepthPixel* _depth);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "XnTypes.h"
+
+// On disk layout of a depth recording (.mkd), little endian:
+//
+//   file header
+//   frame records, each: frame header, hands, encoded depth (mkDepthCodec)
+//   index, one entry per frame, at header.indexOffset
+//
+// Every keyframeInterval-th frame is a keyframe, the frames up to the next
+// one are deltas against their predecessor. The index is written on close;
+// a recording that was never closed is re-indexed by scanning the records.
+
+#define MK_DEPTH_CONTAINER_MAGIC    "MKDEPTH1"
+#define MK_DEPTH_CONTAINER_VERSION  1
+
+#define MK_DEPTH_FRAME_KEYFRAME     1
+
+struct mkDepthFileHeader {
+    char        magic[8];
+    XnUInt32    version;
+    XnUInt32    width;
+    XnUInt32    height;
+    XnUInt32    maxDepth;
+    XnDouble    horizontalFov;
+    XnDouble    verticalFov;
+    XnUInt32    keyframeInterval;
+    XnUInt32    numFrames;
+    XnUInt64    indexOffset;
+};
+
+struct mkDepthFrameHeader {
+    XnUInt32    frameID;
+    XnUInt32    flags;
+    XnUInt64    timestamp;
+    XnUInt32    numHands;
+    XnUInt32    payloadSize;
+};
+
+struct mkDepthFileHand {
+    XnUInt32    id;
+    XnFloat     position[3];
+    XnFloat     worldPosition[3];
+};
+
+struct mkDepthIndexEntry {
+    XnUInt64    offset;
+    XnUInt64    timestamp;
+    XnUInt32    frameID;
+    XnUInt32    flags;
+};
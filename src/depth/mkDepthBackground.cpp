@@ -0,0 +1,162 @@
+#include "mkDepthBackground.h"
+#include "mkSimd.h"
+
+//--------------------------------------------------------------
+mkDepthBackground::mkDepthBackground() : depthWidth(0), depthHeight(0), maskWidth(0), maskHeight(0) {
+    parameters.setName("background");
+    parameters.add(adaptRate.set("adapt rate", 2, 0, 50));		// mm per frame
+    parameters.add(threshold.set("threshold", 150, 10, 1000));	// mm in front of the background
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::setup(int _depthWidth, int _depthHeight, int _maskWidth, int _maskHeight) {
+    depthWidth = _depthWidth;
+    depthHeight = _depthHeight;
+    maskWidth = _maskWidth;
+    maskHeight = _maskHeight;
+    
+    background.assign(depthWidth * depthHeight, 0);
+    mask.assign(depthWidth * depthHeight, 0);
+    smallMask.assign(maskWidth * maskHeight, 0);
+    columnSums.assign(depthWidth, 0);
+    
+    maskTexture.allocate(maskWidth, maskHeight, GL_LUMINANCE);
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::reset() {
+    std::fill(background.begin(), background.end(), 0);
+    std::fill(mask.begin(), mask.end(), 0);
+    std::fill(smallMask.begin(), smallMask.end(), 0);
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::update(const XnDepthPixel* _depth) {
+    if (_depth == NULL || background.empty())
+        return;
+    
+    updateModel(_depth, depthWidth * depthHeight, adaptRate.get(), threshold.get(), &background[0], &mask[0]);
+    downsample(&mask[0], depthWidth, depthHeight, &smallMask[0], maskWidth, maskHeight, &columnSums[0]);
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::updateTexture() {
+    maskTexture.loadData(&smallMask[0], maskWidth, maskHeight, GL_LUMINANCE);
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::updateModelScalar(const XnDepthPixel* _depth, int _count, int _adaptRate, int _threshold,
+                                          XnDepthPixel* _background, XnUInt8* _mask) {
+    for (int i = 0; i < _count; i++) {
+        int d = _depth[i];
+        int b = _background[i];
+        if (d == XN_DEPTH_NO_SAMPLE_VALUE) {
+            _mask[i] = 0;
+            continue;
+        }
+        // no background yet (b == 0) is never foreground
+        _mask[i] = (b - d > _threshold) ? 255 : 0;
+        // farther readings win at once, nearer ones creep in at the adapt rate
+        _background[i] = MAX(d, MAX(b - _adaptRate, 0));
+    }
+}
+
+#ifdef MK_SIMD_SSE2
+//--------------------------------------------------------------
+static inline __m128i updateModelSSE2(__m128i _depth, XnDepthPixel* _background, __m128i _rate, __m128i _threshold) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i b = _mm_loadu_si128((const __m128i*)_background);
+    __m128i invalid = _mm_cmpeq_epi16(_depth, zero);
+    
+    // foreground where b - d > threshold, with unsigned saturation
+    __m128i notForeground = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_subs_epu16(b, _depth), _threshold), zero);
+    __m128i foreground = _mm_andnot_si128(_mm_or_si128(notForeground, invalid), _mm_set1_epi16(-1));
+    
+    // max(d, b - rate), SSE2 has no unsigned 16 bit max
+    __m128i decayed = _mm_subs_epu16(b, _rate);
+    __m128i updated = _mm_adds_epu16(_mm_subs_epu16(_depth, decayed), decayed);
+    b = _mm_or_si128(_mm_and_si128(invalid, b), _mm_andnot_si128(invalid, updated));
+    _mm_storeu_si128((__m128i*)_background, b);
+    return foreground;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkDepthBackground::updateModel(const XnDepthPixel* _depth, int _count, int _adaptRate, int _threshold,
+                                    XnDepthPixel* _background, XnUInt8* _mask) {
+    int i = 0;
+#if defined(MK_SIMD_SSE2)
+    const __m128i rate = _mm_set1_epi16(_adaptRate);
+    const __m128i threshold = _mm_set1_epi16(_threshold);
+    for (; i + 16 <= _count; i += 16) {
+        __m128i a = updateModelSSE2(_mm_loadu_si128((const __m128i*)(_depth + i)), _background + i, rate, threshold);
+        __m128i b = updateModelSSE2(_mm_loadu_si128((const __m128i*)(_depth + i + 8)), _background + i + 8, rate, threshold);
+        // 0 / 0xffff packs to 0 / 0xff
+        _mm_storeu_si128((__m128i*)(_mask + i), _mm_packs_epi16(a, b));
+    }
+#elif defined(MK_SIMD_NEON)
+    const uint16x8_t rate = vdupq_n_u16(_adaptRate);
+    const uint16x8_t threshold = vdupq_n_u16(_threshold);
+    const uint16x8_t zero = vdupq_n_u16(0);
+    for (; i + 16 <= _count; i += 16) {
+        uint8x8_t halves[2];
+        for (int h = 0; h < 2; h++) {
+            uint16x8_t d = vld1q_u16(_depth + i + h * 8);
+            uint16x8_t b = vld1q_u16(_background + i + h * 8);
+            uint16x8_t valid = vmvnq_u16(vceqq_u16(d, zero));
+            uint16x8_t foreground = vandq_u16(vcgtq_u16(vqsubq_u16(b, d), threshold), valid);
+            vst1q_u16(_background + i + h * 8, vbslq_u16(valid, vmaxq_u16(d, vqsubq_u16(b, rate)), b));
+            halves[h] = vmovn_u16(foreground);
+        }
+        vst1q_u8(_mask + i, vcombine_u8(halves[0], halves[1]));
+    }
+#endif
+    if (i < _count)
+        updateModelScalar(_depth + i, _count - i, _adaptRate, _threshold, _background + i, _mask + i);
+}
+
+//--------------------------------------------------------------
+void mkDepthBackground::downsample(const XnUInt8* _mask, int _width, int _height, XnUInt8* _small, int _smallWidth, int _smallHeight,
+                                   XnUInt16* _columnSums) {
+    for (int sy = 0; sy < _smallHeight; sy++) {
+        int y0 = sy * _height / _smallHeight;
+        int y1 = MAX(y0 + 1, (sy + 1) * _height / _smallHeight);
+        
+        // the mask is 0 / 255, count the set pixels per column
+        memset(_columnSums, 0, _width * sizeof(XnUInt16));
+        for (int y = y0; y < y1; y++) {
+            const XnUInt8* row = _mask + y * _width;
+            int x = 0;
+#if defined(MK_SIMD_SSE2)
+            const __m128i one = _mm_set1_epi8(1);
+            const __m128i zero = _mm_setzero_si128();
+            for (; x + 16 <= _width; x += 16) {
+                __m128i m = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x)), one);
+                __m128i lo = _mm_loadu_si128((const __m128i*)(_columnSums + x));
+                __m128i hi = _mm_loadu_si128((const __m128i*)(_columnSums + x + 8));
+                _mm_storeu_si128((__m128i*)(_columnSums + x), _mm_add_epi16(lo, _mm_unpacklo_epi8(m, zero)));
+                _mm_storeu_si128((__m128i*)(_columnSums + x + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(m, zero)));
+            }
+#elif defined(MK_SIMD_NEON)
+            const uint8x16_t one = vdupq_n_u8(1);
+            for (; x + 16 <= _width; x += 16) {
+                uint8x16_t m = vandq_u8(vld1q_u8(row + x), one);
+                vst1q_u16(_columnSums + x, vaddw_u8(vld1q_u16(_columnSums + x), vget_low_u8(m)));
+                vst1q_u16(_columnSums + x + 8, vaddw_u8(vld1q_u16(_columnSums + x + 8), vget_high_u8(m)));
+            }
+#endif
+            for (; x < _width; x++)
+                _columnSums[x] += row[x] & 1;
+        }
+        
+        XnUInt8* out = _small + sy * _smallWidth;
+        for (int sx = 0; sx < _smallWidth; sx++) {
+            int x0 = sx * _width / _smallWidth;
+            int x1 = MAX(x0 + 1, (sx + 1) * _width / _smallWidth);
+            int count = 0;
+            for (int x = x0; x < x1; x++)
+                count += _columnSums[x];
+            out[sx] = count * 255 / ((x1 - x0) * (y1 - y0));
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+
+// Incremental per pixel background model over raw depth. The background is
+// the farthest depth seen at each pixel, pulled towards nearer readings by a
+// fixed number of millimetres per frame so furniture that is moved in
+// eventually becomes background. Anything clearly in front of it is
+// foreground, which isolates performers from walls and static props.
+//
+// Each frame costs one pass over the depth and one over the mask, both in
+// buffers allocated by setup(); update() never allocates.
+
+class mkDepthBackground {
+public:
+    mkDepthBackground();
+    
+    void    setup(int _depthWidth, int _depthHeight, int _maskWidth, int _maskHeight);
+    void    reset();
+    void    update(const XnDepthPixel* _depth);
+    
+    // uploads the mask at mask resolution, render thread only
+    void    updateTexture();
+    
+    const XnDepthPixel*	getBackground() const	{ return &background[0]; }
+    const XnUInt8*		getMask() const			{ return &mask[0]; }		// depth resolution, 0 or 255
+    const XnUInt8*		getSmallMask() const	{ return &smallMask[0]; }	// mask resolution, coverage 0 - 255
+    ofTexture&			getMaskTexture()		{ return maskTexture; }
+    
+    int     getMaskWidth() const			{ return maskWidth; }
+    int     getMaskHeight() const			{ return maskHeight; }
+    
+    ofParameterGroup	parameters;
+    
+    // marks foreground against the current background, then updates it
+    static void updateModel(const XnDepthPixel* _depth, int _count, int _adaptRate, int _threshold,
+                            XnDepthPixel* _background, XnUInt8* _mask);
+    static void updateModelScalar(const XnDepthPixel* _depth, int _count, int _adaptRate, int _threshold,
+                                  XnDepthPixel* _background, XnUInt8* _mask);
+    
+    // block average of a 0 / 255 mask, _columnSums needs _width entries
+    static void downsample(const XnUInt8* _mask, int _width, int _height, XnUInt8* _small, int _smallWidth, int _smallHeight,
+                           XnUInt16* _columnSums);
+    
+protected:
+    ofParameter<int>	adaptRate;
+    ofParameter<int>	threshold;
+    
+    int     depthWidth;
+    int     depthHeight;
+    int     maskWidth;
+    int     maskHeight;
+    
+    vector<XnDepthPixel>	background;
+    vector<XnUInt8>         mask;
+    vector<XnUInt8>         smallMask;
+    vector<XnUInt16>        columnSums;
+    
+    ofTexture               maskTexture;
+};
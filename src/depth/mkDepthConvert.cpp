@@ -0,0 +1,233 @@
+#include "mkDepthConvert.h"
+#include "mkSimd.h"
+
+#define MK_MIN_DEPTH_RANGE 256
+
+// shared by every kernel so they all round the same way
+static inline void prepareWindow(const mkDepthWindow& _window, int& _near, int& _far, int& _scale) {
+    _near = _window.nearClip;
+    _far = MAX((int)_window.farClip, _near + MK_MIN_DEPTH_RANGE);
+    _far = MIN(_far, 65535);
+    _near = _far - MAX(_far - _near, MK_MIN_DEPTH_RANGE);
+    _scale = (255 << 16) / (_far - _near);     // fits 16 bit as the range is at least 256
+}
+
+//--------------------------------------------------------------
+mkDepthConvert::mkDepthConvert() : depthWidth(0), depthHeight(0), fieldWidth(0), fieldHeight(0) {
+    parameters.setName("depth");
+    parameters.add(nearClip.set("near", 500, 0, 10000));
+    parameters.add(farClip.set("far", 4000, 0, 10000));
+    parameters.add(noSampleValue.set("no sample value", 0, 0, 255));
+    parameters.add(doField.set("float field", false));
+}
+
+//--------------------------------------------------------------
+void mkDepthConvert::setup(int _depthWidth, int _depthHeight, int _fieldWidth, int _fieldHeight) {
+    depthWidth = _depthWidth;
+    depthHeight = _depthHeight;
+    fieldWidth = _fieldWidth;
+    fieldHeight = _fieldHeight;
+    
+    image.assign(depthWidth * depthHeight, 0);
+    field.assign(fieldWidth * fieldHeight, 0);
+    rowSums.assign(depthWidth, 0);
+    rowCounts.assign(depthWidth, 0);
+    
+    texture.allocate(depthWidth, depthHeight, GL_LUMINANCE);
+}
+
+//--------------------------------------------------------------
+mkDepthWindow mkDepthConvert::getWindow() const {
+    mkDepthWindow window;
+    window.nearClip = nearClip.get();
+    window.farClip = farClip.get();
+    window.noSampleValue = noSampleValue.get();
+    window.noSampleField = noSampleValue.get() / 255.0;
+    return window;
+}
+
+//--------------------------------------------------------------
+void mkDepthConvert::update(const mkDepthPyramid& _pyramid) {
+    mkDepthView depth = _pyramid.getLevel(0);
+    if (!depth.isValid() || depth.width != depthWidth || depth.height != depthHeight || image.empty())
+        return;
+    
+    mkDepthWindow window = getWindow();
+    toImage(depth.pixels, depthWidth * depthHeight, window, &image[0]);
+    if (doField.get()) {
+        mkDepthView level = _pyramid.getLevelFor(fieldWidth, fieldHeight, MK_DEPTH_AVERAGE);
+        toField(level.pixels, level.width, level.height, window, &field[0], fieldWidth, fieldHeight, &rowSums[0], &rowCounts[0]);
+    }
+}
+
+//--------------------------------------------------------------
+void mkDepthConvert::updateTexture() {
+    texture.loadData(&image[0], depthWidth, depthHeight, GL_LUMINANCE);
+}
+
+//--------------------------------------------------------------
+void mkDepthConvert::toImageScalar(const XnDepthPixel* _depth, int _count, const mkDepthWindow& _window, XnUInt8* _image) {
+    int nearClip, farClip, scale;
+    prepareWindow(_window, nearClip, farClip, scale);
+    
+    for (int i = 0; i < _count; i++) {
+        int d = _depth[i];
+        if (d == XN_DEPTH_NO_SAMPLE_VALUE) {
+            _image[i] = _window.noSampleValue;
+            continue;
+        }
+        int c = d < nearClip ? nearClip : (d > farClip ? farClip : d);
+        _image[i] = ((farClip - c) * scale) >> 16;
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int toImageAVX2(const XnDepthPixel* _depth, int _count, int _near, int _far, int _scale, XnUInt8 _noSample, XnUInt8* _image) {
+    const __m256i nearV = _mm256_set1_epi16(_near);
+    const __m256i farV = _mm256_set1_epi16(_far);
+    const __m256i scaleV = _mm256_set1_epi16(_scale);
+    const __m256i noSampleV = _mm256_set1_epi16(_noSample);
+    const __m256i zero = _mm256_setzero_si256();
+    
+    int i = 0;
+    for (; i + 32 <= _count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(_depth + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(_depth + i + 16));
+        
+        __m256i va = _mm256_mulhi_epu16(_mm256_sub_epi16(farV, _mm256_min_epu16(_mm256_max_epu16(a, nearV), farV)), scaleV);
+        __m256i vb = _mm256_mulhi_epu16(_mm256_sub_epi16(farV, _mm256_min_epu16(_mm256_max_epu16(b, nearV), farV)), scaleV);
+        va = _mm256_blendv_epi8(va, noSampleV, _mm256_cmpeq_epi16(a, zero));
+        vb = _mm256_blendv_epi8(vb, noSampleV, _mm256_cmpeq_epi16(b, zero));
+        
+        // packus interleaves the 128 bit lanes, put them back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(va, vb), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(_image + i), packed);
+    }
+    return i;
+}
+#endif
+
+#ifdef MK_SIMD_SSE2
+//--------------------------------------------------------------
+static inline __m128i toImageSSE2(__m128i _depth, __m128i _near, __m128i _far, __m128i _scale, __m128i _noSample) {
+    // SSE2 has no unsigned 16 bit min / max, saturating arithmetic does it
+    __m128i c = _mm_adds_epu16(_mm_subs_epu16(_depth, _near), _near);
+    c = _mm_sub_epi16(c, _mm_subs_epu16(c, _far));
+    __m128i v = _mm_mulhi_epu16(_mm_sub_epi16(_far, c), _scale);
+    __m128i mask = _mm_cmpeq_epi16(_depth, _mm_setzero_si128());
+    return _mm_or_si128(_mm_and_si128(mask, _noSample), _mm_andnot_si128(mask, v));
+}
+#endif
+
+//--------------------------------------------------------------
+void mkDepthConvert::toImage(const XnDepthPixel* _depth, int _count, const mkDepthWindow& _window, XnUInt8* _image) {
+    int nearClip, farClip, scale;
+    prepareWindow(_window, nearClip, farClip, scale);
+    int i = 0;
+    
+#ifdef MK_SIMD_X86
+    if (mkCpuHasAvx2())
+        i = toImageAVX2(_depth, _count, nearClip, farClip, scale, _window.noSampleValue, _image);
+#endif
+    
+#if defined(MK_SIMD_SSE2)
+    const __m128i nearV = _mm_set1_epi16(nearClip);
+    const __m128i farV = _mm_set1_epi16(farClip);
+    const __m128i scaleV = _mm_set1_epi16(scale);
+    const __m128i noSampleV = _mm_set1_epi16(_window.noSampleValue);
+    for (; i + 16 <= _count; i += 16) {
+        __m128i a = toImageSSE2(_mm_loadu_si128((const __m128i*)(_depth + i)), nearV, farV, scaleV, noSampleV);
+        __m128i b = toImageSSE2(_mm_loadu_si128((const __m128i*)(_depth + i + 8)), nearV, farV, scaleV, noSampleV);
+        _mm_storeu_si128((__m128i*)(_image + i), _mm_packus_epi16(a, b));
+    }
+#elif defined(MK_SIMD_NEON)
+    const uint16x8_t nearV = vdupq_n_u16(nearClip);
+    const uint16x8_t farV = vdupq_n_u16(farClip);
+    const uint16x4_t scaleV = vdup_n_u16(scale);
+    const uint16x8_t noSampleV = vdupq_n_u16(_window.noSampleValue);
+    const uint16x8_t zero = vdupq_n_u16(0);
+    for (; i + 16 <= _count; i += 16) {
+        uint8x8_t halves[2];
+        for (int h = 0; h < 2; h++) {
+            uint16x8_t d = vld1q_u16(_depth + i + h * 8);
+            uint16x8_t diff = vsubq_u16(farV, vminq_u16(vmaxq_u16(d, nearV), farV));
+            uint16x8_t v = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(diff), scaleV), 16),
+                                        vshrn_n_u32(vmull_u16(vget_high_u16(diff), scaleV), 16));
+            v = vbslq_u16(vceqq_u16(d, zero), noSampleV, v);
+            halves[h] = vmovn_u16(v);
+        }
+        vst1q_u8(_image + i, vcombine_u8(halves[0], halves[1]));
+    }
+#endif
+    
+    if (i < _count)
+        toImageScalar(_depth + i, _count - i, _window, _image + i);
+}
+
+//--------------------------------------------------------------
+void mkDepthConvert::toField(const XnDepthPixel* _depth, int _depthWidth, int _depthHeight, const mkDepthWindow& _window,
+                             float* _field, int _fieldWidth, int _fieldHeight, XnUInt32* _rowSums, XnUInt16* _rowCounts) {
+    int nearClip, farClip, scale;
+    prepareWindow(_window, nearClip, farClip, scale);
+    float invRange = 1.0f / (farClip - nearClip);
+    
+    for (int fy = 0; fy < _fieldHeight; fy++) {
+        int y0 = fy * _depthHeight / _fieldHeight;
+        int y1 = MAX(y0 + 1, (fy + 1) * _depthHeight / _fieldHeight);
+        
+        // sum the rows of this block column wise, no sample pixels add 0
+        memset(_rowSums, 0, _depthWidth * sizeof(XnUInt32));
+        memset(_rowCounts, 0, _depthWidth * sizeof(XnUInt16));
+        for (int y = y0; y < y1; y++) {
+            const XnDepthPixel* row = _depth + y * _depthWidth;
+            int x = 0;
+#if defined(MK_SIMD_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i one = _mm_set1_epi16(1);
+            for (; x + 8 <= _depthWidth; x += 8) {
+                __m128i d = _mm_loadu_si128((const __m128i*)(row + x));
+                __m128i lo = _mm_loadu_si128((const __m128i*)(_rowSums + x));
+                __m128i hi = _mm_loadu_si128((const __m128i*)(_rowSums + x + 4));
+                _mm_storeu_si128((__m128i*)(_rowSums + x), _mm_add_epi32(lo, _mm_unpacklo_epi16(d, zero)));
+                _mm_storeu_si128((__m128i*)(_rowSums + x + 4), _mm_add_epi32(hi, _mm_unpackhi_epi16(d, zero)));
+                __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi16(d, zero), one);
+                __m128i counts = _mm_loadu_si128((const __m128i*)(_rowCounts + x));
+                _mm_storeu_si128((__m128i*)(_rowCounts + x), _mm_add_epi16(counts, valid));
+            }
+#elif defined(MK_SIMD_NEON)
+            const uint16x8_t zero = vdupq_n_u16(0);
+            const uint16x8_t one = vdupq_n_u16(1);
+            for (; x + 8 <= _depthWidth; x += 8) {
+                uint16x8_t d = vld1q_u16(row + x);
+                vst1q_u32(_rowSums + x, vaddw_u16(vld1q_u32(_rowSums + x), vget_low_u16(d)));
+                vst1q_u32(_rowSums + x + 4, vaddw_u16(vld1q_u32(_rowSums + x + 4), vget_high_u16(d)));
+                uint16x8_t valid = vbicq_u16(one, vceqq_u16(d, zero));
+                vst1q_u16(_rowCounts + x, vaddq_u16(vld1q_u16(_rowCounts + x), valid));
+            }
+#endif
+            for (; x < _depthWidth; x++) {
+                _rowSums[x] += row[x];
+                _rowCounts[x] += (row[x] != XN_DEPTH_NO_SAMPLE_VALUE);
+            }
+        }
+        
+        float* out = _field + fy * _fieldWidth;
+        for (int fx = 0; fx < _fieldWidth; fx++) {
+            int x0 = fx * _depthWidth / _fieldWidth;
+            int x1 = MAX(x0 + 1, (fx + 1) * _depthWidth / _fieldWidth);
+            XnUInt32 sum = 0;
+            XnUInt32 count = 0;
+            for (int x = x0; x < x1; x++) {
+                sum += _rowSums[x];
+                count += _rowCounts[x];
+            }
+            if (count == 0) {
+                out[fx] = _window.noSampleField;
+                continue;
+            }
+            float d = ofClamp((float)sum / count, nearClip, farClip);
+            out[fx] = (farClip - d) * invRange;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkDepthPyramid.h"
+
+// Converts raw depth into an 8 bit image for display and, optionally, a
+// normalised float field at flow resolution for depth driven effects. Depth
+// is clamped to a near / far window and mapped to 255 at near and 0 at far;
+// pixels without a sample get a separate value.
+//
+// The kernels are static so other stages can use them on their own buffers;
+// the scalar versions are the reference the SIMD ones must match exactly.
+
+struct mkDepthWindow {
+    XnDepthPixel    nearClip;
+    XnDepthPixel    farClip;
+    XnUInt8         noSampleValue;
+    float           noSampleField;
+};
+
+class mkDepthConvert {
+public:
+    mkDepthConvert();
+    
+    void    setup(int _depthWidth, int _depthHeight, int _fieldWidth, int _fieldHeight);
+    // the image from level 0, the field from the smallest level that covers it
+    void    update(const mkDepthPyramid& _pyramid);
+    void    updateTexture();
+    
+    const XnUInt8*  getImage() const	{ return &image[0]; }
+    const float*    getField() const	{ return &field[0]; }
+    ofTexture&      getTexture()		{ return texture; }
+    mkDepthWindow   getWindow() const;
+    
+    int     getFieldWidth() const		{ return fieldWidth; }
+    int     getFieldHeight() const		{ return fieldHeight; }
+    void    setDoField(bool _value)		{ doField.set(_value); }
+    
+    ofParameterGroup	parameters;
+    
+    // whole frame to 8 bit, picks the widest instruction set available
+    static void toImage(const XnDepthPixel* _depth, int _count, const mkDepthWindow& _window, XnUInt8* _image);
+    static void toImageScalar(const XnDepthPixel* _depth, int _count, const mkDepthWindow& _window, XnUInt8* _image);
+    
+    // box filtered float field in [0, 1], averaging only valid samples;
+    // _rowSums and _rowCounts need _depthWidth entries
+    static void toField(const XnDepthPixel* _depth, int _depthWidth, int _depthHeight, const mkDepthWindow& _window,
+                        float* _field, int _fieldWidth, int _fieldHeight, XnUInt32* _rowSums, XnUInt16* _rowCounts);
+    
+protected:
+    ofParameter<int>	nearClip;
+    ofParameter<int>	farClip;
+    ofParameter<int>	noSampleValue;
+    ofParameter<bool>	doField;
+    
+    int     depthWidth;
+    int     depthHeight;
+    int     fieldWidth;
+    int     fieldHeight;
+    
+    vector<XnUInt8>     image;
+    vector<float>       field;
+    vector<XnUInt32>    rowSums;
+    vector<XnUInt16>    rowCounts;
+    
+    ofTexture           texture;
+};
@@ -0,0 +1,197 @@
+#include "mkDepthFilter.h"
+#include "mkSimd.h"
+
+// the blend runs in 16 bit, see filterTemporal()
+#define MK_MAX_EDGE_THRESHOLD 2000
+
+//--------------------------------------------------------------
+mkDepthFilter::mkDepthFilter() : width(0), height(0), numBands(0) {
+    parameters.setName("depth filter");
+    parameters.add(enabled.set("enabled", true));
+    parameters.add(blend.set("blend", 0.35, 0.01, 1));							// weight of a new sample
+    parameters.add(edgeThreshold.set("edge threshold", 80, 1, MK_MAX_EDGE_THRESHOLD));	// mm
+    parameters.add(maxAge.set("max age", 6, 0, 254));							// frames a hole keeps its depth
+    parameters.add(maxHoleWidth.set("max hole width", 8, 0, 64));				// pixels filled along a row
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::setup(int _width, int _height) {
+    width = _width;
+    height = _height;
+    // a few bands per core, so uneven bands balance out
+    numBands = MAX(1, MIN(height / 16, 32));
+    
+    state.assign(width * height, 0);
+    age.assign(width * height, 255);
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::reset() {
+    std::fill(state.begin(), state.end(), 0);
+    std::fill(age.begin(), age.end(), 255);
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::update(const XnDepthPixel* _input, XnDepthPixel* _output, mkWorkerPool* _pool) {
+    if (_input == NULL || _output == NULL || state.empty())
+        return;
+    
+    auto band = [&](int _band) { filterBand(_band, _input, _output); };
+    if (_pool != NULL)
+        _pool->parallelFor(numBands, band);
+    else
+        for (int i = 0; i < numBands; i++)
+            band(i);
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::filterBand(int _band, const XnDepthPixel* _input, XnDepthPixel* _output) {
+    int y0 = _band * height / numBands;
+    int y1 = (_band + 1) * height / numBands;
+    int offset = y0 * width;
+    int blendValue = ofClamp(blend.get() * 256, 1, 256);
+    
+    filterTemporal(_input + offset, &state[offset], &age[offset], (y1 - y0) * width, blendValue, edgeThreshold.get(), maxAge.get(), _output + offset);
+    
+    int holeWidth = maxHoleWidth.get();
+    if (holeWidth > 0)
+        for (int y = y0; y < y1; y++)
+            fillRow(_output + y * width, width, holeWidth);
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::filterTemporalScalar(const XnDepthPixel* _input, XnDepthPixel* _state, XnUInt8* _age, int _count,
+                                         int _blend, int _edgeThreshold, int _maxAge, XnDepthPixel* _output) {
+    _edgeThreshold = MIN(_edgeThreshold, MK_MAX_EDGE_THRESHOLD);
+    for (int i = 0; i < _count; i++) {
+        int d = _input[i];
+        int s = _state[i];
+        if (d != XN_DEPTH_NO_SAMPLE_VALUE) {
+            int difference = d - s;
+            if (s != XN_DEPTH_NO_SAMPLE_VALUE && abs(difference) < _edgeThreshold)
+                s += (difference * _blend) >> 8;
+            else
+                s = d;
+            _age[i] = 0;
+        }
+        else {
+            _age[i] = MIN(_age[i] + 1, 255);
+            if (_age[i] > _maxAge)
+                s = XN_DEPTH_NO_SAMPLE_VALUE;
+        }
+        _state[i] = s;
+        _output[i] = s;
+    }
+}
+
+#ifdef MK_SIMD_SSE2
+//--------------------------------------------------------------
+static inline __m128i filterTemporalSSE2(__m128i _depth, __m128i _state, __m128i _valid, __m128i _alive, __m128i _blend, __m128i _edge) {
+    // depth is below 32768, so signed 16 bit arithmetic is exact
+    __m128i difference = _mm_sub_epi16(_depth, _state);
+    __m128i distance = _mm_max_epi16(difference, _mm_sub_epi16(_mm_setzero_si128(), difference));
+    __m128i close = _mm_andnot_si128(_mm_cmpeq_epi16(_state, _mm_setzero_si128()), _mm_cmplt_epi16(distance, _edge));
+    // (difference * blend) >> 8 as (difference * 16) * (blend * 16) >> 16;
+    // exact where it is used, as the difference is under the edge threshold
+    __m128i step = _mm_mulhi_epi16(_mm_slli_epi16(difference, 4), _blend);
+    __m128i sample = _mm_or_si128(_mm_and_si128(close, _mm_add_epi16(_state, step)), _mm_andnot_si128(close, _depth));
+    __m128i held = _mm_and_si128(_alive, _state);
+    return _mm_or_si128(_mm_and_si128(_valid, sample), _mm_andnot_si128(_valid, held));
+}
+#endif
+
+//--------------------------------------------------------------
+void mkDepthFilter::filterTemporal(const XnDepthPixel* _input, XnDepthPixel* _state, XnUInt8* _age, int _count,
+                                   int _blend, int _edgeThreshold, int _maxAge, XnDepthPixel* _output) {
+    int i = 0;
+#if defined(MK_SIMD_SSE2)
+    const __m128i blendV = _mm_set1_epi16(_blend * 16);
+    const __m128i edgeV = _mm_set1_epi16(MIN(_edgeThreshold, MK_MAX_EDGE_THRESHOLD));
+    const __m128i maxAgeV = _mm_set1_epi8((char)_maxAge);
+    const __m128i oneV = _mm_set1_epi8(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= _count; i += 16) {
+        __m128i depthLow = _mm_loadu_si128((const __m128i*)(_input + i));
+        __m128i depthHigh = _mm_loadu_si128((const __m128i*)(_input + i + 8));
+        __m128i validLow = _mm_xor_si128(_mm_cmpeq_epi16(depthLow, zero), _mm_set1_epi16(-1));
+        __m128i validHigh = _mm_xor_si128(_mm_cmpeq_epi16(depthHigh, zero), _mm_set1_epi16(-1));
+        
+        // ages in 8 bit: 0 on a sample, otherwise one older, saturating
+        __m128i valid = _mm_packs_epi16(validLow, validHigh);
+        __m128i age = _mm_andnot_si128(valid, _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(_age + i)), oneV));
+        _mm_storeu_si128((__m128i*)(_age + i), age);
+        __m128i alive = _mm_cmpeq_epi8(_mm_subs_epu8(age, maxAgeV), zero);
+        
+        __m128i stateLow = filterTemporalSSE2(depthLow, _mm_loadu_si128((const __m128i*)(_state + i)), validLow,
+                                              _mm_unpacklo_epi8(alive, alive), blendV, edgeV);
+        __m128i stateHigh = filterTemporalSSE2(depthHigh, _mm_loadu_si128((const __m128i*)(_state + i + 8)), validHigh,
+                                               _mm_unpackhi_epi8(alive, alive), blendV, edgeV);
+        _mm_storeu_si128((__m128i*)(_state + i), stateLow);
+        _mm_storeu_si128((__m128i*)(_state + i + 8), stateHigh);
+        _mm_storeu_si128((__m128i*)(_output + i), stateLow);
+        _mm_storeu_si128((__m128i*)(_output + i + 8), stateHigh);
+    }
+#elif defined(MK_SIMD_NEON)
+    const int16x8_t blendV = vdupq_n_s16(_blend * 8);     // vqdmulh doubles
+    const int16x8_t edgeV = vdupq_n_s16(MIN(_edgeThreshold, MK_MAX_EDGE_THRESHOLD));
+    const uint8x16_t maxAgeV = vdupq_n_u8(_maxAge);
+    const uint8x16_t oneV = vdupq_n_u8(1);
+    for (; i + 16 <= _count; i += 16) {
+        int16x8_t depth[2] = { vreinterpretq_s16_u16(vld1q_u16(_input + i)), vreinterpretq_s16_u16(vld1q_u16(_input + i + 8)) };
+        uint16x8_t valid[2] = { vtstq_s16(depth[0], depth[0]), vtstq_s16(depth[1], depth[1]) };
+        
+        uint8x16_t valid8 = vcombine_u8(vmovn_u16(valid[0]), vmovn_u16(valid[1]));
+        uint8x16_t age = vbicq_u8(vqaddq_u8(vld1q_u8(_age + i), oneV), valid8);
+        vst1q_u8(_age + i, age);
+        uint8x16_t alive8 = vcleq_u8(age, maxAgeV);
+        uint16x8_t alive[2] = { vmovl_u8(vget_low_u8(alive8)), vmovl_u8(vget_high_u8(alive8)) };
+        alive[0] = vtstq_u16(alive[0], alive[0]);
+        alive[1] = vtstq_u16(alive[1], alive[1]);
+        
+        for (int h = 0; h < 2; h++) {
+            int16x8_t state = vreinterpretq_s16_u16(vld1q_u16(_state + i + h * 8));
+            int16x8_t difference = vsubq_s16(depth[h], state);
+            uint16x8_t close = vandq_u16(vtstq_s16(state, state), vcltq_s16(vabsq_s16(difference), edgeV));
+            int16x8_t step = vqdmulhq_s16(vshlq_n_s16(difference, 4), blendV);
+            int16x8_t sample = vbslq_s16(close, vaddq_s16(state, step), depth[h]);
+            int16x8_t held = vreinterpretq_s16_u16(vandq_u16(alive[h], vreinterpretq_u16_s16(state)));
+            uint16x8_t result = vreinterpretq_u16_s16(vbslq_s16(valid[h], sample, held));
+            vst1q_u16(_state + i + h * 8, result);
+            vst1q_u16(_output + i + h * 8, result);
+        }
+    }
+#endif
+    if (i < _count)
+        filterTemporalScalar(_input + i, _state + i, _age + i, _count - i, _blend, _edgeThreshold, _maxAge, _output + i);
+}
+
+//--------------------------------------------------------------
+void mkDepthFilter::fillRow(XnDepthPixel* _row, int _width, int _maxHoleWidth) {
+    int x = 0;
+    while (x < _width) {
+#if defined(MK_SIMD_SSE2)
+        // most of a filtered row has no holes, skip it 8 pixels at a time
+        const __m128i zero = _mm_setzero_si128();
+        while (x + 8 <= _width && _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(_row + x)), zero)) == 0)
+            x += 8;
+#elif defined(MK_SIMD_NEON)
+        while (x + 8 <= _width && vmaxvq_u16(vceqzq_u16(vld1q_u16(_row + x))) == 0)
+            x += 8;
+#endif
+        if (x >= _width)
+            break;
+        if (_row[x] != XN_DEPTH_NO_SAMPLE_VALUE) {
+            x++;
+            continue;
+        }
+        int start = x;
+        while (x < _width && _row[x] == XN_DEPTH_NO_SAMPLE_VALUE)
+            x++;
+        // only holes with a sample on both sides, the image border stays open
+        if (start == 0 || x == _width || x - start > _maxHoleWidth)
+            continue;
+        XnDepthPixel fill = MAX(_row[start - 1], _row[x]);
+        for (int i = start; i < x; i++)
+            _row[i] = fill;
+    }
+}
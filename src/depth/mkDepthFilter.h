@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkWorkerPool.h"
+
+// Spatio-temporal cleanup of raw depth, run once per frame between capture
+// and everything that consumes depth. Per pixel it keeps the filtered depth
+// and the number of frames since the last valid sample:
+//  - a valid sample close to the filtered depth is blended in, a sample that
+//    jumps further than the edge threshold replaces it, so edges stay sharp
+//    while flicker on flat surfaces is smoothed away;
+//  - a hole keeps the last valid depth until it is older than max age;
+//  - holes left after that, up to max hole width pixels wide, are filled
+//    along the row from the farther of their two neighbours, as shadows
+//    belong to the background.
+// The frame is split into row bands that run on a worker pool; within a row
+// the temporal part is SSE2 / NEON with a scalar reference.
+
+class mkDepthFilter {
+public:
+    mkDepthFilter();
+    
+    void    setup(int _width, int _height);
+    void    reset();
+    
+    // _output may not alias _input, runs the bands on _pool if there is one
+    void    update(const XnDepthPixel* _input, XnDepthPixel* _output, mkWorkerPool* _pool = NULL);
+    
+    bool    isEnabled() const				{ return enabled.get(); }
+    
+    ofParameterGroup	parameters;
+    
+    // one row range of the temporal stage, _age counts frames per pixel
+    static void filterTemporal(const XnDepthPixel* _input, XnDepthPixel* _state, XnUInt8* _age, int _count,
+                               int _blend, int _edgeThreshold, int _maxAge, XnDepthPixel* _output);
+    static void filterTemporalScalar(const XnDepthPixel* _input, XnDepthPixel* _state, XnUInt8* _age, int _count,
+                                     int _blend, int _edgeThreshold, int _maxAge, XnDepthPixel* _output);
+    static void fillRow(XnDepthPixel* _row, int _width, int _maxHoleWidth);
+    
+protected:
+    void    filterBand(int _band, const XnDepthPixel* _input, XnDepthPixel* _output);
+    
+    ofParameter<bool>	enabled;
+    ofParameter<float>	blend;
+    ofParameter<int>	edgeThreshold;
+    ofParameter<int>	maxAge;
+    ofParameter<int>	maxHoleWidth;
+    
+    int     width;
+    int     height;
+    int     numBands;
+    
+    vector<XnDepthPixel>	state;
+    vector<XnUInt8>         age;
+};
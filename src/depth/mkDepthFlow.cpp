@@ -0,0 +1,146 @@
+#include "mkDepthFlow.h"
+
+//--------------------------------------------------------------
+mkDepthFlow::mkDepthFlow() : width(0), height(0), hasPrevious(false), changed(false) {
+    // names match ftOpticalFlow so both load the same settings
+    parameters.setName("optical flow");
+    parameters.add(strength.set("strength", 10, 0, 100));
+    parameters.add(offset.set("offset", 3, 1, 10));
+    parameters.add(lambda.set("lambda", 0.01, 0, 0.1));
+    parameters.add(threshold.set("threshold", 0.02, 0, 0.2));
+    parameters.add(doInverseX.set("inverse x", false));
+    parameters.add(doInverseY.set("inverse y", false));
+    parameters.add(doTimeBlur.set("do time blur", true));
+    timeBlurParameters.setName("time blur");
+    timeBlurParameters.add(decay.set("Decay", 0.1, 0, 1));
+    timeBlurParameters.add(blurRadius.set("Decay Blur Radius", 2, 0, 10));
+    parameters.add(timeBlurParameters);
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::setup(int _width, int _height) {
+    width = _width;
+    height = _height;
+    
+    previous.assign(width * height, 0);
+    flow.assign(width * height * 2, 0);
+    flowDecay.assign(width * height * 2, 0);
+    blurScratch.assign(width * height * 2, 0);
+    
+    flowTexture.allocate(width, height, GL_RG32F);
+    flowDecayTexture.allocate(width, height, GL_RG32F);
+    
+    reset();
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::reset() {
+    std::fill(flow.begin(), flow.end(), 0);
+    std::fill(flowDecay.begin(), flowDecay.end(), 0);
+    hasPrevious = false;
+    changed = false;
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::update(const float* _field) {
+    changed = false;
+    if (_field == NULL || previous.empty())
+        return;
+    
+    if (hasPrevious) {
+        computeFlow(_field, &previous[0], width, height, offset.get(), lambda.get(), threshold.get(), strength.get(),
+                    doInverseX.get() ? -1 : 1, doInverseY.get() ? -1 : 1, &flow[0]);
+        if (doTimeBlur.get())
+            updateDecay();
+        changed = true;
+    }
+    
+    memcpy(&previous[0], _field, width * height * sizeof(float));
+    hasPrevious = true;
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::updateTextures() {
+    flowTexture.loadData(&flow[0], width, height, GL_RG);
+    if (doTimeBlur.get())
+        flowDecayTexture.loadData(&flowDecay[0], width, height, GL_RG);
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::computeFlow(const float* _current, const float* _previous, int _width, int _height,
+                              int _offset, float _lambda, float _threshold, float _strength,
+                              float _inverseX, float _inverseY, float* _flow) {
+    float thresholdScale = 1.0 / MAX(1.0 - _threshold, 0.0001);
+    
+    for (int y = 0; y < _height; y++) {
+        // clamp to edge, like the rectangle texture lookups in the shader
+        const int up = MAX(y - _offset, 0) * _width;
+        const int down = MIN(y + _offset, _height - 1) * _width;
+        const int row = y * _width;
+        float* out = _flow + row * 2;
+        
+        for (int x = 0; x < _width; x++) {
+            const int left = MAX(x - _offset, 0);
+            const int right = MIN(x + _offset, _width - 1);
+            
+            float difference = _current[row + x] - _previous[row + x];
+            float gradX = (_previous[row + right] - _previous[row + left]) + (_current[row + right] - _current[row + left]);
+            float gradY = (_previous[down + x] - _previous[up + x]) + (_current[down + x] - _current[up + x]);
+            float gradMagnitude = sqrtf(gradX * gradX + gradY * gradY + _lambda);
+            
+            float flowX = -difference * gradX / gradMagnitude * _inverseX;
+            float flowY = -difference * gradY / gradMagnitude * _inverseY;
+            
+            // remove everything under the threshold and rescale the rest to [0, 1]
+            float magnitude = sqrtf(flowX * flowX + flowY * flowY);
+            float scaled = MIN((MAX(magnitude, _threshold) - _threshold) * thresholdScale, 1.0f);
+            float scale = (magnitude > 0) ? scaled / magnitude * _strength : 0;
+            
+            out[x * 2] = flowX * scale;
+            out[x * 2 + 1] = flowY * scale;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkDepthFlow::updateDecay() {
+    // fade the history and add the new flow, then soften it with a box blur
+    float keep = 1.0 - decay.get();
+    int count = width * height * 2;
+    for (int i = 0; i < count; i++)
+        flowDecay[i] = flowDecay[i] * keep + flow[i];
+    
+    int radius = blurRadius.get();
+    if (radius <= 0)
+        return;
+    
+    // horizontal into the scratch buffer, vertical back
+    for (int y = 0; y < height; y++) {
+        const float* in = &flowDecay[y * width * 2];
+        float* out = &blurScratch[y * width * 2];
+        for (int x = 0; x < width; x++) {
+            int x0 = MAX(x - radius, 0);
+            int x1 = MIN(x + radius, width - 1);
+            float sumX = 0, sumY = 0;
+            for (int i = x0; i <= x1; i++) {
+                sumX += in[i * 2];
+                sumY += in[i * 2 + 1];
+            }
+            float norm = 1.0 / (x1 - x0 + 1);
+            out[x * 2] = sumX * norm;
+            out[x * 2 + 1] = sumY * norm;
+        }
+    }
+    for (int y = 0; y < height; y++) {
+        int y0 = MAX(y - radius, 0);
+        int y1 = MIN(y + radius, height - 1);
+        float norm = 1.0 / (y1 - y0 + 1);
+        float* out = &flowDecay[y * width * 2];
+        for (int x = 0; x < width * 2; x++) {
+            float sum = 0;
+            for (int i = y0; i <= y1; i++)
+                sum += blurScratch[i * width * 2 + x];
+            out[x] = sum * norm;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+
+// CPU optical flow on consecutive depth fields at flow resolution, a drop in
+// for ftOpticalFlow when the Kinect is the only sensor. It runs the same
+// gradient method as the flowTools shader and takes the same parameters, so
+// the optical_flow group in settings.xml tunes both. Depth does not care
+// about lighting and needs no second capture pipeline.
+//
+// Input is the normalised field from mkDepthConvert, 1 at near and 0 at far;
+// output is RG velocity, like ftOpticalFlow::getOpticalFlow().
+
+class mkDepthFlow {
+public:
+    mkDepthFlow();
+    
+    void    setup(int _width, int _height);
+    void    reset();
+    
+    // _field is _width * _height floats, the first call only primes the history
+    void    update(const float* _field);
+    
+    // uploads the flow, render thread only
+    void    updateTextures();
+    
+    bool    didChange() const				{ return changed; }
+    int     getWidth() const				{ return width; }
+    int     getHeight() const				{ return height; }
+    
+    const float*	getFlow() const				{ return &flow[0]; }		// RG
+    const float*	getFlowDecay() const		{ return &flowDecay[0]; }	// RG
+    
+    ofTexture&	getOpticalFlow()				{ return flowTexture; }
+    ofTexture&	getOpticalFlowDecay()			{ return doTimeBlur.get() ? flowDecayTexture : flowTexture; }
+    
+    ofParameterGroup	parameters;
+    
+    // one flow pass on two fields, exposed for benchmarks and offline use
+    static void computeFlow(const float* _current, const float* _previous, int _width, int _height,
+                            int _offset, float _lambda, float _threshold, float _strength,
+                            float _inverseX, float _inverseY, float* _flow);
+    
+protected:
+    ofParameter<float>	strength;
+    ofParameter<int>	offset;
+    ofParameter<float>	lambda;
+    ofParameter<float>	threshold;
+    ofParameter<bool>	doInverseX;
+    ofParameter<bool>	doInverseY;
+    ofParameter<bool>	doTimeBlur;
+    ofParameterGroup	timeBlurParameters;
+    ofParameter<float>	decay;
+    ofParameter<int>	blurRadius;
+    
+    void    updateDecay();
+    
+    int     width;
+    int     height;
+    bool    hasPrevious;
+    bool    changed;
+    
+    vector<float>       previous;
+    vector<float>       flow;
+    vector<float>       flowDecay;
+    vector<float>       blurScratch;
+    
+    ofTexture           flowTexture;
+    ofTexture           flowDecayTexture;
+};
@@ -0,0 +1,205 @@
+#include "mkDepthPyramid.h"
+#include "mkSimd.h"
+
+//--------------------------------------------------------------
+mkDepthPyramid::mkDepthPyramid() : width(0), height(0), numLevels(0), base(NULL) {
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::setup(int _width, int _height, int _numLevels) {
+    width = _width;
+    height = _height;
+    
+    // stop before a level would get an odd size
+    numLevels = 1;
+    offsets.assign(1, 0);
+    int size = 0;
+    int w = width, h = height;
+    while (numLevels < _numLevels && w % 2 == 0 && h % 2 == 0) {
+        w /= 2;
+        h /= 2;
+        offsets.push_back(size);
+        size += w * h;
+        numLevels++;
+    }
+    nearest.assign(size, 0);
+    average.assign(size, 0);
+    base = NULL;
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::update(const XnDepthPixel* _depth) {
+    base = _depth;
+    if (_depth == NULL)
+        return;
+    
+    const XnDepthPixel* nearestSource = _depth;
+    const XnDepthPixel* averageSource = _depth;
+    int w = width, h = height;
+    for (int level = 1; level < numLevels; level++) {
+        XnDepthPixel* nearestTarget = &nearest[offsets[level]];
+        XnDepthPixel* averageTarget = &average[offsets[level]];
+        reduceNearest(nearestSource, w, h, nearestTarget);
+        reduceAverage(averageSource, w, h, averageTarget);
+        nearestSource = nearestTarget;
+        averageSource = averageTarget;
+        w /= 2;
+        h /= 2;
+    }
+}
+
+//--------------------------------------------------------------
+mkDepthView mkDepthPyramid::getLevel(int _level, mkDepthReduction _reduction) const {
+    if (base == NULL || _level < 0 || _level >= numLevels)
+        return mkDepthView();
+    if (_level == 0)
+        return mkDepthView(base, width, height);
+    const vector<XnDepthPixel>& levels = (_reduction == MK_DEPTH_NEAREST) ? nearest : average;
+    return mkDepthView(&levels[offsets[_level]], width >> _level, height >> _level);
+}
+
+//--------------------------------------------------------------
+mkDepthView mkDepthPyramid::getLevelFor(int _width, int _height, mkDepthReduction _reduction) const {
+    int level = 0;
+    while (level + 1 < numLevels && (width >> (level + 1)) >= _width && (height >> (level + 1)) >= _height)
+        level++;
+    return getLevel(level, _reduction);
+}
+
+//--------------------------------------------------------------
+static void reduceNearestRow(const XnDepthPixel* _top, const XnDepthPixel* _bottom, int _from, int _to, XnDepthPixel* _out) {
+    // no sample (0) wraps to the largest value under the - 1
+    for (int x = _from; x < _to; x++) {
+        XnDepthPixel a = MIN((XnDepthPixel)(_top[x * 2] - 1), (XnDepthPixel)(_top[x * 2 + 1] - 1));
+        XnDepthPixel b = MIN((XnDepthPixel)(_bottom[x * 2] - 1), (XnDepthPixel)(_bottom[x * 2 + 1] - 1));
+        _out[x] = MIN(a, b) + 1;
+    }
+}
+
+//--------------------------------------------------------------
+static void reduceAverageRow(const XnDepthPixel* _top, const XnDepthPixel* _bottom, int _from, int _to, XnDepthPixel* _out) {
+    for (int x = _from; x < _to; x++) {
+        int a = _top[x * 2], b = _top[x * 2 + 1], c = _bottom[x * 2], d = _bottom[x * 2 + 1];
+        int count = (a != 0) + (b != 0) + (c != 0) + (d != 0);
+        _out[x] = count ? (a + b + c + d + count / 2) / count : 0;
+    }
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::reduceNearestScalar(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target) {
+    for (int y = 0; y < _height / 2; y++)
+        reduceNearestRow(_source + y * 2 * _width, _source + (y * 2 + 1) * _width, 0, _width / 2, _target + y * (_width / 2));
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::reduceNearest(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target) {
+#if defined(MK_SIMD_SSE2)
+    // SSE2 only has a signed 16 bit min, flip the sign bit around it
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    for (int y = 0; y < _height / 2; y++) {
+        const XnDepthPixel* top = _source + y * 2 * _width;
+        const XnDepthPixel* bottom = top + _width;
+        XnDepthPixel* out = _target + y * (_width / 2);
+        int x = 0;
+        for (; x + 16 <= _width; x += 16) {
+            __m128i pairs[2];
+            for (int h = 0; h < 2; h++) {
+                __m128i a = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(top + x + h * 8)), one), sign);
+                __m128i b = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(bottom + x + h * 8)), one), sign);
+                __m128i m = _mm_min_epi16(a, b);
+                m = _mm_min_epi16(m, _mm_srli_epi32(m, 16));
+                // the pair minimum is in the low half of each 32 bit lane, sign extend to pack it
+                pairs[h] = _mm_srai_epi32(_mm_slli_epi32(m, 16), 16);
+            }
+            __m128i packed = _mm_packs_epi32(pairs[0], pairs[1]);
+            _mm_storeu_si128((__m128i*)(out + x / 2), _mm_add_epi16(_mm_xor_si128(packed, sign), one));
+        }
+        reduceNearestRow(top, bottom, x / 2, _width / 2, out);
+    }
+#elif defined(MK_SIMD_NEON)
+    const uint16x8_t one = vdupq_n_u16(1);
+    for (int y = 0; y < _height / 2; y++) {
+        const XnDepthPixel* top = _source + y * 2 * _width;
+        const XnDepthPixel* bottom = top + _width;
+        XnDepthPixel* out = _target + y * (_width / 2);
+        int x = 0;
+        for (; x + 16 <= _width; x += 16) {
+            uint16x8x2_t a = vld2q_u16(top + x);
+            uint16x8x2_t b = vld2q_u16(bottom + x);
+            uint16x8_t m = vminq_u16(vminq_u16(vsubq_u16(a.val[0], one), vsubq_u16(a.val[1], one)),
+                                     vminq_u16(vsubq_u16(b.val[0], one), vsubq_u16(b.val[1], one)));
+            vst1q_u16(out + x / 2, vaddq_u16(m, one));
+        }
+        reduceNearestRow(top, bottom, x / 2, _width / 2, out);
+    }
+#else
+    reduceNearestScalar(_source, _width, _height, _target);
+#endif
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::reduceAverageScalar(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target) {
+    for (int y = 0; y < _height / 2; y++)
+        reduceAverageRow(_source + y * 2 * _width, _source + (y * 2 + 1) * _width, 0, _width / 2, _target + y * (_width / 2));
+}
+
+//--------------------------------------------------------------
+void mkDepthPyramid::reduceAverage(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target) {
+#if defined(MK_SIMD_SSE2)
+    // depth is below 32768, so the pair sums can use the signed madd;
+    // the quotient is exact in float as sums stay far below 2^24
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = 0; y < _height / 2; y++) {
+        const XnDepthPixel* top = _source + y * 2 * _width;
+        const XnDepthPixel* bottom = top + _width;
+        XnDepthPixel* out = _target + y * (_width / 2);
+        int x = 0;
+        for (; x + 16 <= _width; x += 16) {
+            __m128i results[2];
+            for (int h = 0; h < 2; h++) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(top + x + h * 8));
+                __m128i b = _mm_loadu_si128((const __m128i*)(bottom + x + h * 8));
+                __m128i sum = _mm_add_epi32(_mm_madd_epi16(a, ones), _mm_madd_epi16(b, ones));
+                // valid lanes are 1, pair sums count them
+                __m128i validA = _mm_andnot_si128(_mm_cmpeq_epi16(a, zero), ones);
+                __m128i validB = _mm_andnot_si128(_mm_cmpeq_epi16(b, zero), ones);
+                __m128i count = _mm_add_epi32(_mm_madd_epi16(validA, ones), _mm_madd_epi16(validB, ones));
+                
+                __m128i rounded = _mm_add_epi32(sum, _mm_srli_epi32(count, 1));
+                __m128i empty = _mm_cmpeq_epi32(count, zero);
+                __m128i safeCount = _mm_sub_epi32(count, empty);    // 0 becomes 1
+                __m128i quotient = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(rounded), _mm_cvtepi32_ps(safeCount)));
+                results[h] = _mm_andnot_si128(empty, quotient);
+            }
+            _mm_storeu_si128((__m128i*)(out + x / 2), _mm_packs_epi32(results[0], results[1]));
+        }
+        reduceAverageRow(top, bottom, x / 2, _width / 2, out);
+    }
+#elif defined(MK_SIMD_NEON) && defined(__aarch64__)
+    // the float divide needs AArch64
+    for (int y = 0; y < _height / 2; y++) {
+        const XnDepthPixel* top = _source + y * 2 * _width;
+        const XnDepthPixel* bottom = top + _width;
+        XnDepthPixel* out = _target + y * (_width / 2);
+        int x = 0;
+        for (; x + 8 <= _width; x += 8) {
+            uint16x8_t a = vld1q_u16(top + x);
+            uint16x8_t b = vld1q_u16(bottom + x);
+            uint32x4_t sum = vaddq_u32(vpaddlq_u16(a), vpaddlq_u16(b));
+            uint16x8_t validA = vshrq_n_u16(vtstq_u16(a, a), 15);
+            uint16x8_t validB = vshrq_n_u16(vtstq_u16(b, b), 15);
+            uint32x4_t count = vaddq_u32(vpaddlq_u16(validA), vpaddlq_u16(validB));
+            
+            uint32x4_t rounded = vaddq_u32(sum, vshrq_n_u32(count, 1));
+            float32x4_t quotient = vdivq_f32(vcvtq_f32_u32(rounded), vcvtq_f32_u32(vmaxq_u32(count, vdupq_n_u32(1))));
+            uint32x4_t result = vandq_u32(vcvtq_u32_f32(quotient), vtstq_u32(count, count));
+            vst1_u16(out + x / 2, vmovn_u32(result));
+        }
+        reduceAverageRow(top, bottom, x / 2, _width / 2, out);
+    }
+#else
+    reduceAverageScalar(_source, _width, _height, _target);
+#endif
+}
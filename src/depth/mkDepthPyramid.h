@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+
+// Read only window on one level of a depth pyramid.
+struct mkDepthView {
+    mkDepthView() : pixels(NULL), width(0), height(0) {}
+    mkDepthView(const XnDepthPixel* _pixels, int _width, int _height) : pixels(_pixels), width(_width), height(_height) {}
+    
+    bool                isValid() const				{ return pixels != NULL; }
+    XnDepthPixel        get(int _x, int _y) const	{ return pixels[_y * width + _x]; }
+    
+    const XnDepthPixel* pixels;
+    int                 width;
+    int                 height;
+};
+
+enum mkDepthReduction {
+    MK_DEPTH_NEAREST = 0,   // nearest valid sample of each 2 x 2 block
+    MK_DEPTH_AVERAGE        // rounded average of the valid samples
+};
+
+// Every level halves the one before it, built once per sensor frame by the
+// capture thread and published with the frame, so consumers read the size
+// they need instead of resampling full frames themselves. Level 0 is the
+// frame's own depth, not a copy. Both reductions ignore missing samples and
+// only give 0 where a whole block had none; the reductions are SSE2 / NEON
+// with scalar references that they match exactly.
+
+class mkDepthPyramid {
+public:
+    mkDepthPyramid();
+    
+    void    setup(int _width, int _height, int _numLevels = 5);
+    void    update(const XnDepthPixel* _depth);
+    
+    int     getNumLevels() const		{ return numLevels; }
+    mkDepthView getLevel(int _level, mkDepthReduction _reduction = MK_DEPTH_AVERAGE) const;
+    
+    // the smallest level that is still at least _width x _height
+    mkDepthView getLevelFor(int _width, int _height, mkDepthReduction _reduction = MK_DEPTH_AVERAGE) const;
+    
+    // one level down, _width and _height of the source, both even
+    static void reduceNearest(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target);
+    static void reduceNearestScalar(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target);
+    static void reduceAverage(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target);
+    static void reduceAverageScalar(const XnDepthPixel* _source, int _width, int _height, XnDepthPixel* _target);
+    
+protected:
+    int     width;
+    int     height;
+    int     numLevels;
+    
+    const XnDepthPixel*     base;
+    // levels 1 and up, one after the other
+    vector<XnDepthPixel>    nearest;
+    vector<XnDepthPixel>    average;
+    vector<int>             offsets;
+};
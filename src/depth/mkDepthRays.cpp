@@ -0,0 +1,161 @@
+#include "mkDepthRays.h"
+#include "mkSimd.h"
+
+//--------------------------------------------------------------
+mkDepthRays::mkDepthRays() : width(0), height(0), xToZ(0), yToZ(0) {
+}
+
+//--------------------------------------------------------------
+bool mkDepthRays::setup(xn::DepthGenerator& _depthGenerator) {
+    XnMapOutputMode mode;
+    XnFieldOfView fieldOfView;
+    if (_depthGenerator.GetMapOutputMode(mode) != XN_STATUS_OK || _depthGenerator.GetFieldOfView(fieldOfView) != XN_STATUS_OK) {
+        ofLogError("mkDepthRays") << "depth generator has no output mode or field of view";
+        return false;
+    }
+    setup(mode.nXRes, mode.nYRes, fieldOfView);
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkDepthRays::setup(int _width, int _height, const XnFieldOfView& _fieldOfView) {
+    width = _width;
+    height = _height;
+    xToZ = tan(_fieldOfView.fHFOV / 2) * 2;
+    yToZ = tan(_fieldOfView.fVFOV / 2) * 2;
+    
+    // OpenNI divides in float and offsets in double, so does the table
+    rayX.resize(width);
+    for (int u = 0; u < width; u++)
+        rayX[u] = (float)u / (float)width - 0.5;
+    rayY.resize(height);
+    for (int v = 0; v < height; v++)
+        rayY[v] = 0.5 - (float)v / (float)height;
+}
+
+//--------------------------------------------------------------
+void mkDepthRays::toWorldScalar(const XnDepthPixel* _depth, XnPoint3D* _world) const {
+    for (int v = 0; v < height; v++) {
+        for (int u = 0; u < width; u++) {
+            double z = _depth[v * width + u];
+            XnPoint3D& p = _world[v * width + u];
+            p.X = (XnFloat)(rayX[u] * z * xToZ);
+            p.Y = (XnFloat)(rayY[v] * z * yToZ);
+            p.Z = (XnFloat)z;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkDepthRays::toWorldScalar(int _count, const XnPoint3D* _projective, XnPoint3D* _world) const {
+    for (int i = 0; i < _count; i++) {
+        XnPoint3D p = _projective[i];
+        double normalizedX = p.X / (float)width - 0.5;
+        double normalizedY = 0.5 - p.Y / (float)height;
+        _world[i].X = (XnFloat)(normalizedX * p.Z * xToZ);
+        _world[i].Y = (XnFloat)(normalizedY * p.Z * yToZ);
+        _world[i].Z = p.Z;
+    }
+}
+
+#ifdef MK_SIMD_SSE2
+//--------------------------------------------------------------
+static inline void storePoints(XnPoint3D* _points, __m128 _x, __m128 _y, __m128 _z) {
+    // x0 x1 x2 x3, y.., z.. to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    __m128 xyLow = _mm_unpacklo_ps(_x, _y);
+    __m128 xyHigh = _mm_unpackhi_ps(_x, _y);
+    __m128 a = _mm_shuffle_ps(xyLow, _mm_shuffle_ps(_z, xyLow, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+    __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(xyLow, _z, _MM_SHUFFLE(1, 1, 3, 3)), xyHigh, _MM_SHUFFLE(1, 0, 2, 0));
+    __m128 c = _mm_shuffle_ps(_z, xyHigh, _MM_SHUFFLE(3, 2, 3, 2));
+    c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 3, 2, 0));
+    float* out = (float*)_points;
+    _mm_storeu_ps(out, a);
+    _mm_storeu_ps(out + 4, b);
+    _mm_storeu_ps(out + 8, c);
+}
+
+//--------------------------------------------------------------
+static inline __m128 scaleRays(__m128d _rayLow, __m128d _rayHigh, __m128d _zLow, __m128d _zHigh, __m128d _toZ) {
+    // (ray * z) * toZ in double, then to float, the OpenNI order
+    __m128 low = _mm_cvtpd_ps(_mm_mul_pd(_mm_mul_pd(_rayLow, _zLow), _toZ));
+    __m128 high = _mm_cvtpd_ps(_mm_mul_pd(_mm_mul_pd(_rayHigh, _zHigh), _toZ));
+    return _mm_movelh_ps(low, high);
+}
+#endif
+
+//--------------------------------------------------------------
+void mkDepthRays::toWorld(const XnDepthPixel* _depth, XnPoint3D* _world) const {
+#ifdef MK_SIMD_SSE2
+    const __m128d xToZV = _mm_set1_pd(xToZ);
+    const __m128d yToZV = _mm_set1_pd(yToZ);
+    const __m128i zero = _mm_setzero_si128();
+    for (int v = 0; v < height; v++) {
+        const XnDepthPixel* row = _depth + v * width;
+        XnPoint3D* out = _world + v * width;
+        const __m128d rayYV = _mm_set1_pd(rayY[v]);
+        int u = 0;
+        for (; u + 4 <= width; u += 4) {
+            __m128i z32 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(row + u)), zero);
+            __m128d zLow = _mm_cvtepi32_pd(z32);
+            __m128d zHigh = _mm_cvtepi32_pd(_mm_shuffle_epi32(z32, _MM_SHUFFLE(3, 2, 3, 2)));
+            __m128 x = scaleRays(_mm_loadu_pd(&rayX[u]), _mm_loadu_pd(&rayX[u + 2]), zLow, zHigh, xToZV);
+            __m128 y = scaleRays(rayYV, rayYV, zLow, zHigh, yToZV);
+            storePoints(out + u, x, y, _mm_cvtepi32_ps(z32));
+        }
+        for (; u < width; u++) {
+            double z = row[u];
+            out[u].X = (XnFloat)(rayX[u] * z * xToZ);
+            out[u].Y = (XnFloat)(rayY[v] * z * yToZ);
+            out[u].Z = (XnFloat)z;
+        }
+    }
+#else
+    toWorldScalar(_depth, _world);
+#endif
+}
+
+//--------------------------------------------------------------
+void mkDepthRays::toWorld(int _count, const XnPoint3D* _projective, XnPoint3D* _world) const {
+    int i = 0;
+#ifdef MK_SIMD_SSE2
+    const __m128d xToZV = _mm_set1_pd(xToZ);
+    const __m128d yToZV = _mm_set1_pd(yToZ);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128 widthV = _mm_set1_ps(width);
+    const __m128 heightV = _mm_set1_ps(height);
+    for (; i + 4 <= _count; i += 4) {
+        const XnPoint3D* p = _projective + i;
+        __m128 x = _mm_setr_ps(p[0].X, p[1].X, p[2].X, p[3].X);
+        __m128 y = _mm_setr_ps(p[0].Y, p[1].Y, p[2].Y, p[3].Y);
+        __m128 z = _mm_setr_ps(p[0].Z, p[1].Z, p[2].Z, p[3].Z);
+        
+        // the ray of each point, divided in float like the table
+        __m128 u = _mm_div_ps(x, widthV);
+        __m128 v = _mm_div_ps(y, heightV);
+        __m128d zLow = _mm_cvtps_pd(z);
+        __m128d zHigh = _mm_cvtps_pd(_mm_movehl_ps(z, z));
+        __m128d rayXLow = _mm_sub_pd(_mm_cvtps_pd(u), half);
+        __m128d rayXHigh = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(u, u)), half);
+        __m128d rayYLow = _mm_sub_pd(half, _mm_cvtps_pd(v));
+        __m128d rayYHigh = _mm_sub_pd(half, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+        
+        storePoints(_world + i, scaleRays(rayXLow, rayXHigh, zLow, zHigh, xToZV), scaleRays(rayYLow, rayYHigh, zLow, zHigh, yToZV), z);
+    }
+#endif
+    if (i < _count)
+        toWorldScalar(_count - i, _projective + i, _world + i);
+}
+
+//--------------------------------------------------------------
+void mkDepthRays::toProjective(int _count, const XnPoint3D* _world, XnPoint3D* _projective) const {
+    for (int i = 0; i < _count; i++) {
+        XnPoint3D p = _world[i];
+        if (p.Z <= 0) {
+            _projective[i].X = _projective[i].Y = _projective[i].Z = 0;
+            continue;
+        }
+        _projective[i].X = (XnFloat)((p.X / (p.Z * xToZ) + 0.5) * width);
+        _projective[i].Y = (XnFloat)((0.5 - p.Y / (p.Z * yToZ)) * height);
+        _projective[i].Z = p.Z;
+    }
+}
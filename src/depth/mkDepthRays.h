@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnCppWrapper.h"
+
+// Projective to real world conversion without going through OpenNI for
+// every point. The field of view math is done once in setup(): every column
+// and row gets its normalised ray coordinate, the ray of pixel (u, v) being
+// (rayX[u] * xToZ, rayY[v] * yToZ, 1). Converting a pixel is then two
+// multiplies per axis, done in the same order and precision as
+// xnConvertProjectiveToRealWorld, so the results are bit for bit the same.
+//
+// Whole frames use the table, batches of arbitrary projective points compute
+// the same ray on the fly. Both are SSE2 on x86 with a scalar fallback.
+
+class mkDepthRays {
+public:
+    mkDepthRays();
+    
+    bool    setup(xn::DepthGenerator& _depthGenerator);
+    void    setup(int _width, int _height, const XnFieldOfView& _fieldOfView);
+    bool    isSetup() const				{ return width > 0; }
+    
+    // every pixel of a frame, _world needs width * height points;
+    // pixels without a sample come out at the origin, as from OpenNI
+    void    toWorld(const XnDepthPixel* _depth, XnPoint3D* _world) const;
+    
+    // _projective and _world may be the same array
+    void    toWorld(int _count, const XnPoint3D* _projective, XnPoint3D* _world) const;
+    
+    // the inverse, for the few points that are filtered in world space;
+    // points at or behind the sensor come out at the origin
+    void    toProjective(int _count, const XnPoint3D* _world, XnPoint3D* _projective) const;
+    
+    // reference implementations, one point at a time
+    void    toWorldScalar(const XnDepthPixel* _depth, XnPoint3D* _world) const;
+    void    toWorldScalar(int _count, const XnPoint3D* _projective, XnPoint3D* _world) const;
+    
+    int     getWidth() const			{ return width; }
+    int     getHeight() const			{ return height; }
+    
+protected:
+    int     width;
+    int     height;
+    double  xToZ;
+    double  yToZ;
+    
+    vector<double>  rayX;
+    vector<double>  rayY;
+};
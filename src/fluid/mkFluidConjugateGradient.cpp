@@ -0,0 +1,70 @@
+#include "mkFluidConjugateGradient.h"
+
+//--------------------------------------------------------------
+mkFluidConjugateGradient::mkFluidConjugateGradient() : pool(NULL), width(0), height(0), numBands(1), lastResidual(0) {
+}
+
+//--------------------------------------------------------------
+void mkFluidConjugateGradient::setup(int _width, int _height, mkWorkerPool* _pool, int _maxBands) {
+    pool = _pool;
+    width = _width;
+    height = _height;
+    numBands = MAX(1, MIN((height - 2) / 4, _maxBands));
+    bandSums.assign(numBands, 0);
+    bandSquares.assign(numBands, 0);
+    
+    residual.allocate(width, height, 1);
+    preconditioned.allocate(width, height, 1);
+    direction.allocate(width, height, 1);
+    q.allocate(width, height, 1);
+    inverseDiagonal.allocate(width, height, 1);
+}
+
+//--------------------------------------------------------------
+int mkFluidConjugateGradient::solve(mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, int _minIterations, int _maxIterations, float _tolerance) {
+    float inverseNumCells = 1.0f / ((width - 2) * (height - 2));
+    forBands([&](int _band, int _y0, int _y1) { bandSums[_band] = mkFluidKernels::inverseDiagonal(_fluid, inverseDiagonal, _y0, _y1); });
+    double numFluid = sum(bandSums);
+    
+    // start from last frame's pressure, without the part of the residual
+    // that is the same everywhere
+    forBands([&](int, int _y0, int _y1) { mkFluidKernels::residual(_pressure, _divergence, _fluid, _alpha, residual, _y0, _y1); });
+    forBands([&](int _band, int _y0, int _y1) { bandSums[_band] = mkFluidKernels::dot(residual, _fluid, _y0, _y1); });
+    float mean = numFluid > 0 ? sum(bandSums) / numFluid : 0;
+    forBands([&](int, int _y0, int _y1) { mkFluidKernels::addScaled(_fluid, -mean, 1, residual, _y0, _y1); });
+    // a step of 0 only preconditions
+    forBands([&](int _band, int _y0, int _y1) { bandSums[_band] = mkFluidKernels::conjugateStep(direction, q, inverseDiagonal, 0, _pressure, residual, preconditioned, bandSquares[_band], _y0, _y1); });
+    double rz = sum(bandSums);
+    lastResidual = sqrt(sum(bandSquares) * inverseNumCells);
+    direction.copyFrom(preconditioned);
+    
+    int numIterations = 0;
+    while (numIterations < _maxIterations && (numIterations < _minIterations || lastResidual > _tolerance) && rz > 0) {
+        forBands([&](int _band, int _y0, int _y1) { bandSums[_band] = mkFluidKernels::laplacian(direction, _fluid, q, _y0, _y1); });
+        double directionQ = sum(bandSums);
+        // only rounding is left
+        if (directionQ <= 0)
+            break;
+        
+        float step = rz / directionQ;
+        forBands([&](int _band, int _y0, int _y1) { bandSums[_band] = mkFluidKernels::conjugateStep(direction, q, inverseDiagonal, step, _pressure, residual, preconditioned, bandSquares[_band], _y0, _y1); });
+        double nextRz = sum(bandSums);
+        lastResidual = sqrt(sum(bandSquares) * inverseNumCells);
+        numIterations++;
+        if (numIterations >= _maxIterations || (numIterations >= _minIterations && lastResidual <= _tolerance))
+            break;
+        
+        float beta = nextRz / rz;
+        forBands([&](int, int _y0, int _y1) { mkFluidKernels::addScaled(preconditioned, 1, beta, direction, _y0, _y1); });
+        rz = nextRz;
+    }
+    return numIterations;
+}
+
+//--------------------------------------------------------------
+double mkFluidConjugateGradient::sum(const vector<double>& _sums) const {
+    double sum = 0;
+    for (int i = 0; i < numBands; i++)
+        sum += _sums[i];
+    return sum;
+}
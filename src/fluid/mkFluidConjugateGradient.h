@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkFluidField.h"
+#include "mkFluidKernels.h"
+#include "mkWorkerPool.h"
+#include "mkSimd.h"
+
+// A conjugate gradient solver for the pressure step of mkFluidSimulation,
+// preconditioned with the inverse of the operator's diagonal (the number
+// of fluid neighbours). Each iteration costs about three Jacobi sweeps but
+// converges at the square root of their rate, which pays off when the
+// pressure has to be right rather than fast, as in offline renders.
+//
+// The walls make the equation singular: pressure is only known up to a
+// constant, and the part of the divergence that no pressure can take out,
+// its mean over the fluid, is left out of the residual the solver works
+// on. The operator is symmetric for 0 or 1 obstacle masks; soft edges make
+// it only nearly so and slow the convergence down. All storage is
+// allocated in setup().
+
+class mkFluidConjugateGradient {
+public:
+    mkFluidConjugateGradient();
+    
+    // _width and _height of the grid, the wall included; the kernels run on
+    // up to _maxBands bands of _pool
+    void    setup(int _width, int _height, mkWorkerPool* _pool, int _maxBands);
+    
+    // up to _maxIterations iterations on _pressure, with _alpha as in
+    // jacobi(); stops once the RMS residual over the cells inside the wall
+    // is at most _tolerance, but not before _minIterations. Returns the
+    // number of iterations run.
+    int     solve(mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, int _minIterations, int _maxIterations, float _tolerance = 0);
+    
+    // after solve(), the RMS residual it stopped at
+    float   getResidual() const			{ return lastResidual; }
+    
+protected:
+    // runs _function(band, y0, y1) on bands of the rows inside the wall
+    template<typename F>
+    void    forBands(F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            _function(_band, 1 + _band * (height - 2) / numBands, 1 + (_band + 1) * (height - 2) / numBands);
+        };
+        pool->parallelFor(numBands, band);
+    }
+    // the sum of what each band left in _sums
+    double  sum(const vector<double>& _sums) const;
+    
+    mkWorkerPool*   pool;
+    int             width;
+    int             height;
+    int             numBands;
+    vector<double>  bandSums;
+    vector<double>  bandSquares;
+    float           lastResidual;
+    
+    mkFluidField    residual;
+    mkFluidField    preconditioned;     // z, the residual over the diagonal
+    mkFluidField    direction;
+    mkFluidField    q;                  // the operator applied to direction
+    mkFluidField    inverseDiagonal;
+};
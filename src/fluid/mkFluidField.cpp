@@ -0,0 +1,93 @@
+#include "mkFluidField.h"
+#include "XnOS.h"
+
+//--------------------------------------------------------------
+mkFluidField::mkFluidField() : width(0), height(0), stride(0), numChannels(0), numRows(0), firstRow(0), planeSize(0), data(NULL) {
+}
+
+//--------------------------------------------------------------
+mkFluidField::~mkFluidField() {
+    if (data != NULL)
+        xnOSFreeAligned(data);
+}
+
+//--------------------------------------------------------------
+void mkFluidField::allocate(int _width, int _height, int _numChannels) {
+    allocateWindow(_width, _height, _numChannels, _height);
+}
+
+//--------------------------------------------------------------
+void mkFluidField::allocateWindow(int _width, int _height, int _numChannels, int _numRows) {
+    if (data != NULL)
+        xnOSFreeAligned(data);
+    
+    width = _width;
+    height = _height;
+    numChannels = _numChannels;
+    numRows = _numRows;
+    firstRow = 0;
+    stride = (width + 7) & ~7;
+    planeSize = (size_t)stride * numRows;
+    data = (float*)xnOSMallocAligned(planeSize * numChannels * sizeof(float), MK_FLUID_ALIGNMENT);
+    clear();
+}
+
+//--------------------------------------------------------------
+void mkFluidField::clear() {
+    if (data != NULL)
+        memset(data, 0, planeSize * numChannels * sizeof(float));
+}
+
+//--------------------------------------------------------------
+void mkFluidField::copyFrom(const mkFluidField& _other) {
+    if (width != _other.width || height != _other.height || numChannels != _other.numChannels || numRows != _other.numRows)
+        allocateWindow(_other.width, _other.height, _other.numChannels, _other.numRows);
+    firstRow = _other.firstRow;
+    memcpy(data, _other.data, planeSize * numChannels * sizeof(float));
+}
+
+//--------------------------------------------------------------
+void mkFluidField::swap(mkFluidField& _other) {
+    std::swap(width, _other.width);
+    std::swap(height, _other.height);
+    std::swap(stride, _other.stride);
+    std::swap(numChannels, _other.numChannels);
+    std::swap(numRows, _other.numRows);
+    std::swap(firstRow, _other.firstRow);
+    std::swap(planeSize, _other.planeSize);
+    std::swap(data, _other.data);
+}
+
+//--------------------------------------------------------------
+void mkFluidField::add(const ofFloatPixels& _pixels, float _strength) {
+    if (!_pixels.isAllocated() || data == NULL)
+        return;
+    
+    int pixelWidth = _pixels.getWidth(), pixelHeight = _pixels.getHeight();
+    int pixelChannels = _pixels.getNumChannels();
+    int channels = MIN(numChannels, pixelChannels);
+    const float* pixels = _pixels.getPixels();
+    for (int y = 1; y < height - 1; y++) {
+        int py = y * pixelHeight / height;
+        for (int c = 0; c < channels; c++) {
+            float* row = getRow(c, y);
+            for (int x = 1; x < width - 1; x++) {
+                int px = x * pixelWidth / width;
+                row[x] += pixels[(py * pixelWidth + px) * pixelChannels + c] * _strength;
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidField::toPixels(ofFloatPixels& _pixels) const {
+    if (!_pixels.isAllocated() || _pixels.getWidth() != width || _pixels.getHeight() != height || _pixels.getNumChannels() != numChannels)
+        _pixels.allocate(width, height, numChannels);
+    float* pixels = _pixels.getPixels();
+    for (int c = 0; c < numChannels; c++)
+        for (int y = 0; y < height; y++) {
+            const float* row = getRow(c, y);
+            for (int x = 0; x < width; x++)
+                pixels[(y * width + x) * numChannels + c] = row[x];
+        }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ofMain.h"
+
+// A float grid of the fluid simulation, one plane per channel (structure of
+// arrays), so a kernel reads one quantity of 8 neighbouring cells with one
+// load. Rows are padded to a multiple of 8 floats and planes are aligned
+// for AVX2. The outermost ring of cells is the wall of the simulation and
+// is never written by the kernels.
+//
+// A window holds only some rows of such a field, addressed with the field's
+// row numbers from setFirstRow() on, so the kernels can keep a tile of a
+// field in cache without knowing; add() and toPixels() need whole fields.
+
+#define MK_FLUID_ALIGNMENT 32
+
+class mkFluidField {
+public:
+    mkFluidField();
+    ~mkFluidField();
+    
+    void    allocate(int _width, int _height, int _numChannels);
+    // _numRows rows of a _width x _height field
+    void    allocateWindow(int _width, int _height, int _numChannels, int _numRows);
+    void    clear();
+    void    copyFrom(const mkFluidField& _other);
+    void    swap(mkFluidField& _other);
+    
+    int     getWidth() const				{ return width; }
+    int     getHeight() const				{ return height; }
+    int     getStride() const				{ return stride; }
+    int     getNumChannels() const			{ return numChannels; }
+    bool    isAllocated() const				{ return data != NULL; }
+    
+    // of a window, the row its first one stands for
+    void    setFirstRow(int _y)					{ firstRow = _y; }
+    int     getFirstRow() const				{ return firstRow; }
+    
+    // of a window, from its first row on
+    float*          getChannel(int _channel)					{ return data + _channel * planeSize; }
+    const float*    getChannel(int _channel) const				{ return data + _channel * planeSize; }
+    float*          getRow(int _channel, int _y)				{ return getChannel(_channel) + (_y - firstRow) * stride; }
+    const float*    getRow(int _channel, int _y) const			{ return getChannel(_channel) + (_y - firstRow) * stride; }
+    float           get(int _channel, int _x, int _y) const	{ return getRow(_channel, _y)[_x]; }
+    
+    // adds interleaved pixels times _strength, sampled to this size if they
+    // differ, channels beyond the field's are ignored
+    void    add(const ofFloatPixels& _pixels, float _strength = 1.0);
+    // interleaved, for drawing and for the GPU
+    void    toPixels(ofFloatPixels& _pixels) const;
+    
+private:
+    mkFluidField(const mkFluidField&);
+    mkFluidField& operator=(const mkFluidField&);
+    
+    int     width;
+    int     height;
+    int     stride;
+    int     numChannels;
+    int     numRows;
+    int     firstRow;
+    size_t  planeSize;
+    float*  data;
+};
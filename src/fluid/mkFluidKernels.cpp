@@ -0,0 +1,810 @@
+#include "mkFluidKernels.h"
+#include "mkSimd.h"
+
+static bool useSimd = true;
+
+//--------------------------------------------------------------
+void mkFluidKernels::setSimd(bool _simd) {
+    useSimd = _simd;
+}
+
+//--------------------------------------------------------------
+bool mkFluidKernels::getSimd() {
+    return useSimd;
+}
+
+//--------------------------------------------------------------
+static inline bool avx2() {
+#ifdef MK_SIMD_X86
+    return useSimd && mkCpuHasAvx2();
+#else
+    return false;
+#endif
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static inline float sumAVX2(__m256 _v) {
+    __m128 v = _mm_add_ps(_mm256_castps256_ps128(_v), _mm256_extractf128_ps(_v, 1));
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::fluidMask(const mkFluidField& _obstacle, mkFluidField& _fluid, int _y0, int _y1) {
+    int width = _fluid.getWidth();
+    for (int y = _y0; y < _y1; y++) {
+        const float* o = _obstacle.getRow(0, y);
+        float* f = _fluid.getRow(0, y);
+        for (int x = 0; x < width; x++)
+            f[x] = 1.0f - MIN(MAX(o[x], 0.0f), 1.0f);
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::scale(mkFluidField& _field, float _factor, int _y0, int _y1) {
+    int width = _field.getWidth();
+    for (int c = 0; c < _field.getNumChannels(); c++)
+        for (int y = _y0; y < _y1; y++) {
+            float* row = _field.getRow(c, y);
+            for (int x = 0; x < width; x++)
+                row[x] *= _factor;
+        }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::clampLength(mkFluidField& _field, float _max, float _force, int _y0, int _y1) {
+    int width = _field.getWidth(), numChannels = _field.getNumChannels();
+    for (int y = _y0; y < _y1; y++) {
+        for (int x = 0; x < width; x++) {
+            float lengthSquared = 0;
+            for (int c = 0; c < numChannels; c++) {
+                float v = _field.getRow(c, y)[x];
+                lengthSquared += v * v;
+            }
+            if (lengthSquared <= _max * _max)
+                continue;
+            float length = sqrtf(lengthSquared);
+            float factor = (length - (length - _max) * _force) / length;
+            for (int c = 0; c < numChannels; c++)
+                _field.getRow(c, y)[x] *= factor;
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int curlAVX2(const float* _vxB, const float* _vxT, const float* _vy, const float* _f, const float* _fB, const float* _fT, float _h, float* _curl, int _x, int _x1) {
+    const __m256 h = _mm256_set1_ps(_h);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(_vy + _x + 1), _mm256_loadu_ps(_f + _x + 1)), _mm256_mul_ps(_mm256_loadu_ps(_vy + _x - 1), _mm256_loadu_ps(_f + _x - 1)));
+        __m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(_vxT + _x), _mm256_loadu_ps(_fT + _x)), _mm256_mul_ps(_mm256_loadu_ps(_vxB + _x), _mm256_loadu_ps(_fB + _x)));
+        _mm256_storeu_ps(_curl + _x, _mm256_mul_ps(_mm256_mul_ps(h, _mm256_sub_ps(dy, dx)), _mm256_loadu_ps(_f + _x)));
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::curl(const mkFluidField& _velocity, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _curl, int _y0, int _y1) {
+    int x1 = _velocity.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* vxB = _velocity.getRow(0, y - 1);
+        const float* vxT = _velocity.getRow(0, y + 1);
+        const float* vy = _velocity.getRow(1, y);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _curl.getRow(0, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = curlAVX2(vxB, vxT, vy, f, fB, fT, _halfInverseCell, out, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float dy = vy[x + 1] * f[x + 1] - vy[x - 1] * f[x - 1];
+            float dx = vxT[x] * fT[x] - vxB[x] * fB[x];
+            out[x] = _halfInverseCell * (dy - dx) * f[x];
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int confinementAVX2(const float* _c, const float* _cB, const float* _cT, const float* _f, float _h, float _scale, float* _vx, float* _vy, float* _fx, float* _fy, int _x, int _x1) {
+    const __m256 h = _mm256_set1_ps(_h);
+    const __m256 scale = _mm256_set1_ps(_scale);
+    const __m256 epsilon = _mm256_set1_ps(0.00001f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 gx = _mm256_mul_ps(h, _mm256_sub_ps(_mm256_andnot_ps(sign, _mm256_loadu_ps(_c + _x + 1)), _mm256_andnot_ps(sign, _mm256_loadu_ps(_c + _x - 1))));
+        __m256 gy = _mm256_mul_ps(h, _mm256_sub_ps(_mm256_andnot_ps(sign, _mm256_loadu_ps(_cT + _x)), _mm256_andnot_ps(sign, _mm256_loadu_ps(_cB + _x))));
+        __m256 length = _mm256_add_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy))), epsilon);
+        __m256 s = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(scale, _mm256_loadu_ps(_c + _x)), _mm256_loadu_ps(_f + _x)), length);
+        __m256 fx = _mm256_mul_ps(gy, s);
+        __m256 fy = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(gx, s));
+        _mm256_storeu_ps(_fx + _x, fx);
+        _mm256_storeu_ps(_fy + _x, fy);
+        _mm256_storeu_ps(_vx + _x, _mm256_add_ps(_mm256_loadu_ps(_vx + _x), fx));
+        _mm256_storeu_ps(_vy + _x, _mm256_add_ps(_mm256_loadu_ps(_vy + _x), fy));
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::confinement(const mkFluidField& _curl, const mkFluidField& _fluid, float _halfInverseCell, float _scale, mkFluidField& _velocity, mkFluidField& _confinement, int _y0, int _y1) {
+    int x1 = _curl.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* c = _curl.getRow(0, y);
+        const float* cB = _curl.getRow(0, y - 1);
+        const float* cT = _curl.getRow(0, y + 1);
+        const float* f = _fluid.getRow(0, y);
+        float* vx = _velocity.getRow(0, y);
+        float* vy = _velocity.getRow(1, y);
+        float* fx = _confinement.getRow(0, y);
+        float* fy = _confinement.getRow(1, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = confinementAVX2(c, cB, cT, f, _halfInverseCell, _scale, vx, vy, fx, fy, x, x1);
+#endif
+        for (; x < x1; x++) {
+            // towards the stronger vortex, turned a quarter against its spin
+            float gx = _halfInverseCell * (fabsf(c[x + 1]) - fabsf(c[x - 1]));
+            float gy = _halfInverseCell * (fabsf(cT[x]) - fabsf(cB[x]));
+            float length = sqrtf(gx * gx + gy * gy) + 0.00001f;
+            float s = _scale * c[x] * f[x] / length;
+            fx[x] = gy * s;
+            fy[x] = 0.0f - gx * s;
+            vx[x] += fx[x];
+            vy[x] += fy[x];
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int advectAVX2(const float* _vx, const float* _vy, const float* _f, int _y, const mkFluidField& _source, float _timeStep, float _dissipation, mkFluidField& _destination, int _x, int _x1) {
+    const int width = _source.getWidth(), height = _source.getHeight(), stride = _source.getStride();
+    const __m256 timeStep = _mm256_set1_ps(_timeStep);
+    const __m256 dissipation = _mm256_set1_ps(_dissipation);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 maxX = _mm256_set1_ps(width - 1), maxY = _mm256_set1_ps(height - 1);
+    const __m256i maxIX = _mm256_set1_epi32(width - 2), maxIY = _mm256_set1_epi32(height - 2);
+    const __m256i strideV = _mm256_set1_epi32(stride);
+    const __m256 offsets = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 yV = _mm256_set1_ps(_y);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 px = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(_x), offsets), _mm256_mul_ps(timeStep, _mm256_loadu_ps(_vx + _x)));
+        __m256 py = _mm256_sub_ps(yV, _mm256_mul_ps(timeStep, _mm256_loadu_ps(_vy + _x)));
+        px = _mm256_min_ps(_mm256_max_ps(px, zero), maxX);
+        py = _mm256_min_ps(_mm256_max_ps(py, zero), maxY);
+        __m256i ix = _mm256_min_epi32(_mm256_cvttps_epi32(px), maxIX);
+        __m256i iy = _mm256_min_epi32(_mm256_cvttps_epi32(py), maxIY);
+        __m256 tx = _mm256_sub_ps(px, _mm256_cvtepi32_ps(ix));
+        __m256 ty = _mm256_sub_ps(py, _mm256_cvtepi32_ps(iy));
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(iy, strideV), ix);
+        __m256 scale = _mm256_mul_ps(dissipation, _mm256_loadu_ps(_f + _x));
+        for (int c = 0; c < _source.getNumChannels(); c++) {
+            const float* s = _source.getChannel(c);
+            __m256 a = _mm256_i32gather_ps(s, index, 4);
+            __m256 b = _mm256_i32gather_ps(s + 1, index, 4);
+            __m256 d = _mm256_i32gather_ps(s + stride, index, 4);
+            __m256 e = _mm256_i32gather_ps(s + stride + 1, index, 4);
+            __m256 bottom = _mm256_add_ps(a, _mm256_mul_ps(tx, _mm256_sub_ps(b, a)));
+            __m256 top = _mm256_add_ps(d, _mm256_mul_ps(tx, _mm256_sub_ps(e, d)));
+            __m256 v = _mm256_add_ps(bottom, _mm256_mul_ps(ty, _mm256_sub_ps(top, bottom)));
+            _mm256_storeu_ps(_destination.getRow(c, _y) + _x, _mm256_mul_ps(v, scale));
+        }
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::advect(const mkFluidField& _velocity, const mkFluidField& _source, const mkFluidField& _fluid, float _timeStep, float _dissipation, mkFluidField& _destination, int _y0, int _y1) {
+    const int width = _source.getWidth(), height = _source.getHeight(), stride = _source.getStride();
+    const int x1 = width - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* vx = _velocity.getRow(0, y);
+        const float* vy = _velocity.getRow(1, y);
+        const float* f = _fluid.getRow(0, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = advectAVX2(vx, vy, f, y, _source, _timeStep, _dissipation, _destination, x, x1);
+#endif
+        for (; x < x1; x++) {
+            // back along the velocity, clamped to the grid
+            float px = MIN(MAX((float)x - _timeStep * vx[x], 0.0f), (float)(width - 1));
+            float py = MIN(MAX((float)y - _timeStep * vy[x], 0.0f), (float)(height - 1));
+            int ix = MIN((int)px, width - 2);
+            int iy = MIN((int)py, height - 2);
+            float tx = px - ix, ty = py - iy;
+            float scale = _dissipation * f[x];
+            for (int c = 0; c < _source.getNumChannels(); c++) {
+                const float* s = _source.getChannel(c) + iy * stride + ix;
+                float bottom = s[0] + tx * (s[1] - s[0]);
+                float top = s[stride] + tx * (s[stride + 1] - s[stride]);
+                _destination.getRow(c, y)[x] = (bottom + ty * (top - bottom)) * scale;
+            }
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int diffuseAVX2(const float* _x0, const float* _xB, const float* _xT, const float* _b, const float* _f, const float* _fB, const float* _fT, float _alpha, float _inverseBeta, float* _out, int _x, int _x1) {
+    const __m256 alpha = _mm256_set1_ps(_alpha);
+    const __m256 inverseBeta = _mm256_set1_ps(_inverseBeta);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 l = _mm256_mul_ps(_mm256_loadu_ps(_x0 + _x - 1), _mm256_loadu_ps(_f + _x - 1));
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(_x0 + _x + 1), _mm256_loadu_ps(_f + _x + 1));
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(_xB + _x), _mm256_loadu_ps(_fB + _x));
+        __m256 t = _mm256_mul_ps(_mm256_loadu_ps(_xT + _x), _mm256_loadu_ps(_fT + _x));
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(l, r), _mm256_add_ps(b, t)), _mm256_mul_ps(alpha, _mm256_loadu_ps(_b + _x)));
+        _mm256_storeu_ps(_out + _x, _mm256_mul_ps(_mm256_mul_ps(sum, inverseBeta), _mm256_loadu_ps(_f + _x)));
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::diffuse(const mkFluidField& _x, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha, float _inverseBeta, mkFluidField& _out, int _y0, int _y1) {
+    int x1 = _x.getWidth() - 1;
+    for (int c = 0; c < _x.getNumChannels(); c++) {
+        for (int y = _y0; y < _y1; y++) {
+            const float* xC = _x.getRow(c, y);
+            const float* xB = _x.getRow(c, y - 1);
+            const float* xT = _x.getRow(c, y + 1);
+            const float* b = _b.getRow(c, y);
+            const float* f = _fluid.getRow(0, y);
+            const float* fB = _fluid.getRow(0, y - 1);
+            const float* fT = _fluid.getRow(0, y + 1);
+            float* out = _out.getRow(c, y);
+            int x = 1;
+#ifdef MK_SIMD_X86
+            if (avx2())
+                x = diffuseAVX2(xC, xB, xT, b, f, fB, fT, _alpha, _inverseBeta, out, x, x1);
+#endif
+            // obstacles hold the fluid still
+            for (; x < x1; x++) {
+                float sum = (xC[x - 1] * f[x - 1] + xC[x + 1] * f[x + 1]) + (xB[x] * fB[x] + xT[x] * fT[x]) + _alpha * b[x];
+                out[x] = sum * _inverseBeta * f[x];
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::buoyancy(const mkFluidField& _temperature, const mkFluidField& _density, const mkFluidField& _fluid, float _ambient, float _sigma, float _weight, const ofVec2f& _gravity, mkFluidField& _velocity, mkFluidField& _buoyancy, int _y0, int _y1) {
+    int x1 = _velocity.getWidth() - 1;
+    int numColors = MIN(_density.getNumChannels(), 3);
+    for (int y = _y0; y < _y1; y++) {
+        const float* t = _temperature.getRow(0, y);
+        const float* f = _fluid.getRow(0, y);
+        float* vx = _velocity.getRow(0, y);
+        float* vy = _velocity.getRow(1, y);
+        float* bx = _buoyancy.getRow(0, y);
+        float* by = _buoyancy.getRow(1, y);
+        for (int x = 1; x < x1; x++) {
+            // warm smoke rises, dense smoke sinks
+            float density = 0;
+            for (int c = 0; c < numColors; c++)
+                density += _density.getRow(c, y)[x];
+            density /= numColors;
+            float force = t[x] > _ambient ? ((t[x] - _ambient) * _sigma - density * _weight) * f[x] : 0.0f;
+            bx[x] = force * _gravity.x;
+            by[x] = force * _gravity.y;
+            vx[x] += bx[x];
+            vy[x] += by[x];
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int divergenceAVX2(const float* _vx, const float* _vyB, const float* _vyT, const float* _f, const float* _fB, const float* _fT, float _h, float* _divergence, int _x, int _x1) {
+    const __m256 h = _mm256_set1_ps(_h);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(_vx + _x + 1), _mm256_loadu_ps(_f + _x + 1)), _mm256_mul_ps(_mm256_loadu_ps(_vx + _x - 1), _mm256_loadu_ps(_f + _x - 1)));
+        __m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(_vyT + _x), _mm256_loadu_ps(_fT + _x)), _mm256_mul_ps(_mm256_loadu_ps(_vyB + _x), _mm256_loadu_ps(_fB + _x)));
+        _mm256_storeu_ps(_divergence + _x, _mm256_mul_ps(_mm256_mul_ps(h, _mm256_add_ps(dx, dy)), _mm256_loadu_ps(_f + _x)));
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::divergence(const mkFluidField& _velocity, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _divergence, int _y0, int _y1) {
+    int x1 = _velocity.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* vx = _velocity.getRow(0, y);
+        const float* vyB = _velocity.getRow(1, y - 1);
+        const float* vyT = _velocity.getRow(1, y + 1);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _divergence.getRow(0, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = divergenceAVX2(vx, vyB, vyT, f, fB, fT, _halfInverseCell, out, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float dx = vx[x + 1] * f[x + 1] - vx[x - 1] * f[x - 1];
+            float dy = vyT[x] * fT[x] - vyB[x] * fB[x];
+            out[x] = _halfInverseCell * (dx + dy) * f[x];
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int jacobiAVX2(const float* _p, const float* _pB, const float* _pT, const float* _d, const float* _f, const float* _fB, const float* _fT, float _alpha, float _weight, float* _out, float& _squared, int _x, int _x1) {
+    const __m256 alpha = _mm256_set1_ps(_alpha);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 four = _mm256_set1_ps(4);
+    const __m256 weight = _mm256_set1_ps(_weight);
+    __m256 squared = _mm256_setzero_ps();
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 c = _mm256_loadu_ps(_p + _x);
+        __m256 l = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x - 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x - 1), c)));
+        __m256 r = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x + 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x + 1), c)));
+        __m256 b = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fB + _x), _mm256_sub_ps(_mm256_loadu_ps(_pB + _x), c)));
+        __m256 t = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fT + _x), _mm256_sub_ps(_mm256_loadu_ps(_pT + _x), c)));
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(l, r), _mm256_add_ps(b, t)), _mm256_mul_ps(alpha, _mm256_loadu_ps(_d + _x)));
+        __m256 f = _mm256_loadu_ps(_f + _x);
+        __m256 next = _mm256_add_ps(c, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_mul_ps(sum, quarter), c)));
+        _mm256_storeu_ps(_out + _x, _mm256_mul_ps(next, f));
+        __m256 residual = _mm256_mul_ps(_mm256_sub_ps(sum, _mm256_mul_ps(four, c)), f);
+        squared = _mm256_add_ps(squared, _mm256_mul_ps(residual, residual));
+    }
+    _squared += sumAVX2(squared);
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+double mkFluidKernels::jacobi(const mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, float _weight, mkFluidField& _out, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    double squared = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* p = _pressure.getRow(0, y);
+        const float* pB = _pressure.getRow(0, y - 1);
+        const float* pT = _pressure.getRow(0, y + 1);
+        const float* d = _divergence.getRow(0, y);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _out.getRow(0, y);
+        float rowSquared = 0;
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = jacobiAVX2(p, pB, pT, d, f, fB, fT, _alpha, _weight, out, rowSquared, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float c = p[x];
+            float l = c + f[x - 1] * (p[x - 1] - c);
+            float r = c + f[x + 1] * (p[x + 1] - c);
+            float b = c + fB[x] * (pB[x] - c);
+            float t = c + fT[x] * (pT[x] - c);
+            float sum = (l + r) + (b + t) + _alpha * d[x];
+            out[x] = (c + _weight * (sum * 0.25f - c)) * f[x];
+            float residual = (sum - 4 * c) * f[x];
+            rowSquared += residual * residual;
+        }
+        squared += rowSquared;
+    }
+    return squared;
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int residualAVX2(const float* _p, const float* _pB, const float* _pT, const float* _d, const float* _f, const float* _fB, const float* _fT, float _alpha, float* _out, float& _squared, int _x, int _x1) {
+    const __m256 alpha = _mm256_set1_ps(_alpha);
+    __m256 squared = _mm256_setzero_ps();
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 c = _mm256_loadu_ps(_p + _x);
+        __m256 l = _mm256_mul_ps(_mm256_loadu_ps(_f + _x - 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x - 1), c));
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(_f + _x + 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x + 1), c));
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(_fB + _x), _mm256_sub_ps(_mm256_loadu_ps(_pB + _x), c));
+        __m256 t = _mm256_mul_ps(_mm256_loadu_ps(_fT + _x), _mm256_sub_ps(_mm256_loadu_ps(_pT + _x), c));
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(l, r), _mm256_add_ps(b, t)), _mm256_mul_ps(alpha, _mm256_loadu_ps(_d + _x)));
+        __m256 residual = _mm256_mul_ps(sum, _mm256_loadu_ps(_f + _x));
+        _mm256_storeu_ps(_out + _x, residual);
+        squared = _mm256_add_ps(squared, _mm256_mul_ps(residual, residual));
+    }
+    _squared += sumAVX2(squared);
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+double mkFluidKernels::residual(const mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, mkFluidField& _out, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    double squared = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* p = _pressure.getRow(0, y);
+        const float* pB = _pressure.getRow(0, y - 1);
+        const float* pT = _pressure.getRow(0, y + 1);
+        const float* d = _divergence.getRow(0, y);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _out.getRow(0, y);
+        float rowSquared = 0;
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = residualAVX2(p, pB, pT, d, f, fB, fT, _alpha, out, rowSquared, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float c = p[x];
+            float l = f[x - 1] * (p[x - 1] - c);
+            float r = f[x + 1] * (p[x + 1] - c);
+            float b = fB[x] * (pB[x] - c);
+            float t = fT[x] * (pT[x] - c);
+            out[x] = ((l + r) + (b + t) + _alpha * d[x]) * f[x];
+            rowSquared += out[x] * out[x];
+        }
+        squared += rowSquared;
+    }
+    return squared;
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int sorAVX2(float* _p, const float* _pB, const float* _pT, const float* _d, const float* _f, const float* _fB, const float* _fT, float _alpha, float _omega, bool _first, float& _squared, int _x, int _x1) {
+    const __m256 alpha = _mm256_set1_ps(_alpha);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 four = _mm256_set1_ps(4);
+    const __m256 omega = _mm256_set1_ps(_omega);
+    // the cells of this colour take every other lane, the same lanes all
+    // along the row; only those are stored, the others belong to the
+    // neighbouring rows' readers
+    const __m256i mask = _first ? _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0) : _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    __m256 squared = _mm256_setzero_ps();
+    // each store waits for the next loads, a masked store does not forward
+    // to the load of its last lane as the next left neighbour
+    __m256 pending = _mm256_setzero_ps();
+    int pendingX = -1;
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 c = _mm256_loadu_ps(_p + _x);
+        __m256 l = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x - 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x - 1), c)));
+        __m256 r = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x + 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x + 1), c)));
+        __m256 b = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fB + _x), _mm256_sub_ps(_mm256_loadu_ps(_pB + _x), c)));
+        __m256 t = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fT + _x), _mm256_sub_ps(_mm256_loadu_ps(_pT + _x), c)));
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(l, r), _mm256_add_ps(b, t)), _mm256_mul_ps(alpha, _mm256_loadu_ps(_d + _x)));
+        __m256 f = _mm256_loadu_ps(_f + _x);
+        __m256 next = _mm256_add_ps(c, _mm256_mul_ps(omega, _mm256_sub_ps(_mm256_mul_ps(sum, quarter), c)));
+        if (pendingX >= 0)
+            _mm256_maskstore_ps(_p + pendingX, mask, pending);
+        pending = _mm256_mul_ps(next, f);
+        pendingX = _x;
+        __m256 residual = _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(sum, _mm256_mul_ps(four, c)), f), _mm256_castsi256_ps(mask));
+        squared = _mm256_add_ps(squared, _mm256_mul_ps(residual, residual));
+    }
+    if (pendingX >= 0)
+        _mm256_maskstore_ps(_p + pendingX, mask, pending);
+    _squared += sumAVX2(squared);
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+double mkFluidKernels::sor(mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, float _omega, int _color, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    double squared = 0;
+    for (int y = _y0; y < _y1; y++) {
+        float* p = _pressure.getRow(0, y);
+        const float* pB = _pressure.getRow(0, y - 1);
+        const float* pT = _pressure.getRow(0, y + 1);
+        const float* d = _divergence.getRow(0, y);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float rowSquared = 0;
+        // the first cell of this colour in the row
+        int x = 1 + ((1 + y + _color) & 1);
+#ifdef MK_SIMD_X86
+        if (avx2()) {
+            x = sorAVX2(p, pB, pT, d, f, fB, fT, _alpha, _omega, x == 1, rowSquared, 1, x1);
+            x += ((x + y + _color) & 1);
+        }
+#endif
+        for (; x < x1; x += 2) {
+            float c = p[x];
+            float l = c + f[x - 1] * (p[x - 1] - c);
+            float r = c + f[x + 1] * (p[x + 1] - c);
+            float b = c + fB[x] * (pB[x] - c);
+            float t = c + fT[x] * (pT[x] - c);
+            float sum = (l + r) + (b + t) + _alpha * d[x];
+            p[x] = (c + _omega * (sum * 0.25f - c)) * f[x];
+            float residual = (sum - 4 * c) * f[x];
+            rowSquared += residual * residual;
+        }
+        squared += rowSquared;
+    }
+    return squared;
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int laplacianAVX2(const float* _p, const float* _pB, const float* _pT, const float* _f, const float* _fB, const float* _fT, float* _out, float& _dot, int _x, int _x1) {
+    __m256 dot = _mm256_setzero_ps();
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 c = _mm256_loadu_ps(_p + _x);
+        __m256 l = _mm256_mul_ps(_mm256_loadu_ps(_f + _x - 1), _mm256_sub_ps(c, _mm256_loadu_ps(_p + _x - 1)));
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(_f + _x + 1), _mm256_sub_ps(c, _mm256_loadu_ps(_p + _x + 1)));
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(_fB + _x), _mm256_sub_ps(c, _mm256_loadu_ps(_pB + _x)));
+        __m256 t = _mm256_mul_ps(_mm256_loadu_ps(_fT + _x), _mm256_sub_ps(c, _mm256_loadu_ps(_pT + _x)));
+        __m256 out = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(l, r), _mm256_add_ps(b, t)), _mm256_loadu_ps(_f + _x));
+        _mm256_storeu_ps(_out + _x, out);
+        dot = _mm256_add_ps(dot, _mm256_mul_ps(c, out));
+    }
+    _dot += sumAVX2(dot);
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+double mkFluidKernels::laplacian(const mkFluidField& _pressure, const mkFluidField& _fluid, mkFluidField& _out, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    double dot = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* p = _pressure.getRow(0, y);
+        const float* pB = _pressure.getRow(0, y - 1);
+        const float* pT = _pressure.getRow(0, y + 1);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _out.getRow(0, y);
+        float rowDot = 0;
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = laplacianAVX2(p, pB, pT, f, fB, fT, out, rowDot, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float c = p[x];
+            float l = f[x - 1] * (c - p[x - 1]);
+            float r = f[x + 1] * (c - p[x + 1]);
+            float b = fB[x] * (c - pB[x]);
+            float t = fT[x] * (c - pT[x]);
+            out[x] = ((l + r) + (b + t)) * f[x];
+            rowDot += c * out[x];
+        }
+        dot += rowDot;
+    }
+    return dot;
+}
+
+//--------------------------------------------------------------
+double mkFluidKernels::inverseDiagonal(const mkFluidField& _fluid, mkFluidField& _out, int _y0, int _y1) {
+    int x1 = _fluid.getWidth() - 1;
+    double numFluid = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* out = _out.getRow(0, y);
+        for (int x = 1; x < x1; x++) {
+            float diagonal = f[x] * ((f[x - 1] + f[x + 1]) + (fB[x] + fT[x]));
+            out[x] = diagonal > 0 ? 1.0f / diagonal : 0;
+            numFluid += f[x];
+        }
+    }
+    return numFluid;
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int conjugateStepAVX2(const float* _d, const float* _q, const float* _m, float _step, float* _p, float* _r, float* _z, float& _rz, float& _rr, int _x, int _x1) {
+    const __m256 step = _mm256_set1_ps(_step);
+    __m256 rz = _mm256_setzero_ps(), rr = _mm256_setzero_ps();
+    for (; _x + 8 <= _x1; _x += 8) {
+        _mm256_storeu_ps(_p + _x, _mm256_add_ps(_mm256_loadu_ps(_p + _x), _mm256_mul_ps(step, _mm256_loadu_ps(_d + _x))));
+        __m256 r = _mm256_sub_ps(_mm256_loadu_ps(_r + _x), _mm256_mul_ps(step, _mm256_loadu_ps(_q + _x)));
+        __m256 z = _mm256_mul_ps(r, _mm256_loadu_ps(_m + _x));
+        _mm256_storeu_ps(_r + _x, r);
+        _mm256_storeu_ps(_z + _x, z);
+        rz = _mm256_add_ps(rz, _mm256_mul_ps(r, z));
+        rr = _mm256_add_ps(rr, _mm256_mul_ps(r, r));
+    }
+    _rz += sumAVX2(rz);
+    _rr += sumAVX2(rr);
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+double mkFluidKernels::conjugateStep(const mkFluidField& _direction, const mkFluidField& _q, const mkFluidField& _inverseDiagonal, float _step, mkFluidField& _pressure, mkFluidField& _residual, mkFluidField& _z, double& _residualSquared, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    double rz = 0;
+    _residualSquared = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* d = _direction.getRow(0, y);
+        const float* q = _q.getRow(0, y);
+        const float* m = _inverseDiagonal.getRow(0, y);
+        float* p = _pressure.getRow(0, y);
+        float* r = _residual.getRow(0, y);
+        float* z = _z.getRow(0, y);
+        float rowRz = 0, rowRr = 0;
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = conjugateStepAVX2(d, q, m, _step, p, r, z, rowRz, rowRr, x, x1);
+#endif
+        for (; x < x1; x++) {
+            p[x] += _step * d[x];
+            r[x] -= _step * q[x];
+            z[x] = r[x] * m[x];
+            rowRz += r[x] * z[x];
+            rowRr += r[x] * r[x];
+        }
+        rz += rowRz;
+        _residualSquared += rowRr;
+    }
+    return rz;
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int addScaledAVX2(const float* _x, float _a, float _b, float* _y, int _i, int _i1) {
+    const __m256 a = _mm256_set1_ps(_a), b = _mm256_set1_ps(_b);
+    for (; _i + 8 <= _i1; _i += 8)
+        _mm256_storeu_ps(_y + _i, _mm256_add_ps(_mm256_mul_ps(a, _mm256_loadu_ps(_x + _i)), _mm256_mul_ps(b, _mm256_loadu_ps(_y + _i))));
+    return _i;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::addScaled(const mkFluidField& _x, float _a, float _b, mkFluidField& _y, int _y0, int _y1) {
+    int x1 = _y.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* in = _x.getRow(0, y);
+        float* out = _y.getRow(0, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = addScaledAVX2(in, _a, _b, out, x, x1);
+#endif
+        for (; x < x1; x++)
+            out[x] = _a * in[x] + _b * out[x];
+    }
+}
+
+//--------------------------------------------------------------
+double mkFluidKernels::dot(const mkFluidField& _a, const mkFluidField& _b, int _y0, int _y1) {
+    int x1 = _a.getWidth() - 1;
+    double dot = 0;
+    for (int y = _y0; y < _y1; y++) {
+        const float* a = _a.getRow(0, y);
+        const float* b = _b.getRow(0, y);
+        float rowDot = 0;
+        for (int x = 1; x < x1; x++)
+            rowDot += a[x] * b[x];
+        dot += rowDot;
+    }
+    return dot;
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::restrictResidual(const mkFluidField& _residual, mkFluidField& _coarse, int _y0, int _y1) {
+    int x1 = _coarse.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        // coarse cell y covers the fine rows 2y - 1 and 2y, the same for x
+        const float* r0 = _residual.getRow(0, 2 * y - 1);
+        const float* r1 = _residual.getRow(0, 2 * y);
+        float* out = _coarse.getRow(0, y);
+        for (int x = 1; x < x1; x++)
+            out[x] = (r0[2 * x - 1] + r0[2 * x]) + (r1[2 * x - 1] + r1[2 * x]);
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::restrictFluid(const mkFluidField& _fluid, mkFluidField& _coarse, int _y0, int _y1) {
+    int x1 = _coarse.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* f0 = _fluid.getRow(0, 2 * y - 1);
+        const float* f1 = _fluid.getRow(0, 2 * y);
+        float* out = _coarse.getRow(0, y);
+        for (int x = 1; x < x1; x++)
+            out[x] = MAX(MAX(f0[2 * x - 1], f0[2 * x]), MAX(f1[2 * x - 1], f1[2 * x]));
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::prolongate(const mkFluidField& _coarse, const mkFluidField& _coarseFluid, const mkFluidField& _fluid, mkFluidField& _pressure, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        // bilinear between the cell centres: 3/4 from the coarse cell under
+        // this one and 1/4 from its neighbour on this cell's side
+        int cy = ((y - 1) >> 1) + 1;
+        int ny = (y - 1) & 1 ? cy + 1 : cy - 1;
+        const float* e = _coarse.getRow(0, cy);
+        const float* eN = _coarse.getRow(0, ny);
+        const float* cf = _coarseFluid.getRow(0, cy);
+        const float* cfN = _coarseFluid.getRow(0, ny);
+        const float* f = _fluid.getRow(0, y);
+        float* p = _pressure.getRow(0, y);
+        for (int x = 1; x < x1; x++) {
+            int cx = ((x - 1) >> 1) + 1;
+            int nx = (x - 1) & 1 ? cx + 1 : cx - 1;
+            // obstacle cells have no error, leave them out of the average
+            float w = 9 * cf[cx], wX = 3 * cf[nx], wY = 3 * cfN[cx], wXY = cfN[nx];
+            float weight = (w + wX) + (wY + wXY);
+            if (weight > 0)
+                p[x] += ((w * e[cx] + wX * e[nx]) + (wY * eN[cx] + wXY * eN[nx])) / weight * f[x];
+        }
+    }
+}
+
+#ifdef MK_SIMD_X86
+//--------------------------------------------------------------
+MK_TARGET_AVX2 static int subtractGradientAVX2(const float* _p, const float* _pB, const float* _pT, const float* _f, const float* _fB, const float* _fT, float _h, float* _vx, float* _vy, int _x, int _x1) {
+    const __m256 h = _mm256_set1_ps(_h);
+    for (; _x + 8 <= _x1; _x += 8) {
+        __m256 c = _mm256_loadu_ps(_p + _x);
+        __m256 l = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x - 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x - 1), c)));
+        __m256 r = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_f + _x + 1), _mm256_sub_ps(_mm256_loadu_ps(_p + _x + 1), c)));
+        __m256 b = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fB + _x), _mm256_sub_ps(_mm256_loadu_ps(_pB + _x), c)));
+        __m256 t = _mm256_add_ps(c, _mm256_mul_ps(_mm256_loadu_ps(_fT + _x), _mm256_sub_ps(_mm256_loadu_ps(_pT + _x), c)));
+        __m256 f = _mm256_loadu_ps(_f + _x);
+        _mm256_storeu_ps(_vx + _x, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(_vx + _x), _mm256_mul_ps(h, _mm256_sub_ps(r, l))), f));
+        _mm256_storeu_ps(_vy + _x, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(_vy + _x), _mm256_mul_ps(h, _mm256_sub_ps(t, b))), f));
+    }
+    return _x;
+}
+#endif
+
+//--------------------------------------------------------------
+void mkFluidKernels::subtractGradient(const mkFluidField& _pressure, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _velocity, int _y0, int _y1) {
+    int x1 = _pressure.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        const float* p = _pressure.getRow(0, y);
+        const float* pB = _pressure.getRow(0, y - 1);
+        const float* pT = _pressure.getRow(0, y + 1);
+        const float* f = _fluid.getRow(0, y);
+        const float* fB = _fluid.getRow(0, y - 1);
+        const float* fT = _fluid.getRow(0, y + 1);
+        float* vx = _velocity.getRow(0, y);
+        float* vy = _velocity.getRow(1, y);
+        int x = 1;
+#ifdef MK_SIMD_X86
+        if (avx2())
+            x = subtractGradientAVX2(p, pB, pT, f, fB, fT, _halfInverseCell, vx, vy, x, x1);
+#endif
+        for (; x < x1; x++) {
+            float c = p[x];
+            float l = c + f[x - 1] * (p[x - 1] - c);
+            float r = c + f[x + 1] * (p[x + 1] - c);
+            float b = c + fB[x] * (pB[x] - c);
+            float t = c + fT[x] * (pT[x] - c);
+            vx[x] = (vx[x] - _halfInverseCell * (r - l)) * f[x];
+            vy[x] = (vy[x] - _halfInverseCell * (t - b)) * f[x];
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidKernels::multiplyByLength(mkFluidField& _field, const mkFluidField& _scalar, float _factor, int _y0, int _y1) {
+    int x1 = _field.getWidth() - 1;
+    for (int y = _y0; y < _y1; y++) {
+        for (int x = 1; x < x1; x++) {
+            float lengthSquared = 0;
+            for (int c = 0; c < _scalar.getNumChannels(); c++) {
+                float v = _scalar.getRow(c, y)[x];
+                lengthSquared += v * v;
+            }
+            float factor = MAX(0.0f, 1.0f + _factor * sqrtf(lengthSquared));
+            for (int c = 0; c < _field.getNumChannels(); c++)
+                _field.getRow(c, y)[x] *= factor;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkFluidField.h"
+
+// The row kernels of mkFluidSimulation. Each one works on the rows _y0 to
+// _y1 - 1 and, within them, on the cells inside the wall, so row bands can
+// run on separate threads. Advection, vorticity, diffusion, divergence,
+// the pressure solvers' kernels and the gradient have AVX2 paths, chosen at
+// runtime; their scalar paths do the same arithmetic in the same order and
+// differ at most by the rounding of fused multiply-adds and of sums.
+//
+// _fluid is 1 in fluid cells and 0 in obstacles. Velocity is zero inside
+// obstacles and pressure does not cross into them (a neighbouring obstacle
+// cell takes the centre cell's pressure).
+
+class mkFluidKernels {
+public:
+    // false runs the scalar paths, for comparisons
+    static void setSimd(bool _simd);
+    static bool getSimd();
+    
+    // whole rows, walls included
+    static void fluidMask(const mkFluidField& _obstacle, mkFluidField& _fluid, int _y0, int _y1);
+    static void scale(mkFluidField& _field, float _factor, int _y0, int _y1);
+    // lengths over the channels above _max are pulled back by _force
+    static void clampLength(mkFluidField& _field, float _max, float _force, int _y0, int _y1);
+    
+    static void curl(const mkFluidField& _velocity, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _curl, int _y0, int _y1);
+    // adds the vorticity confinement force to _velocity and keeps it in _confinement
+    static void confinement(const mkFluidField& _curl, const mkFluidField& _fluid, float _halfInverseCell, float _scale, mkFluidField& _velocity, mkFluidField& _confinement, int _y0, int _y1);
+    // semi-Lagrangian, bilinear, _timeStep in cells per unit of velocity
+    static void advect(const mkFluidField& _velocity, const mkFluidField& _source, const mkFluidField& _fluid, float _timeStep, float _dissipation, mkFluidField& _destination, int _y0, int _y1);
+    // one Jacobi sweep of the implicit viscosity step
+    static void diffuse(const mkFluidField& _x, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha, float _inverseBeta, mkFluidField& _out, int _y0, int _y1);
+    // adds the smoke force to _velocity and keeps it in _buoyancy
+    static void buoyancy(const mkFluidField& _temperature, const mkFluidField& _density, const mkFluidField& _fluid, float _ambient, float _sigma, float _weight, const ofVec2f& _gravity, mkFluidField& _velocity, mkFluidField& _buoyancy, int _y0, int _y1);
+    static void divergence(const mkFluidField& _velocity, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _divergence, int _y0, int _y1);
+    // one Jacobi sweep of the pressure Poisson equation, _alpha is -cell size
+    // squared, a _weight below 1 damps it into a multigrid smoother; returns
+    // the squared residual of _pressure summed over the rows, which the
+    // sweep has at hand (a sweep moves each cell by _weight / 4 of it)
+    static double jacobi(const mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, float _weight, mkFluidField& _out, int _y0, int _y1);
+    // what the pressure still misses, 0 once jacobi() no longer changes it;
+    // returns the squares of _out summed over the rows
+    static double residual(const mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, mkFluidField& _out, int _y0, int _y1);
+    // one half sweep of red-black successive over-relaxation, in place: the
+    // cells with (x + y) % 2 == _color move _omega of the way jacobi() would
+    // move them, reading only cells of the other colour; returns the squared
+    // residual of the cells it moved, before moving them
+    static double sor(mkFluidField& _pressure, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, float _omega, int _color, int _y0, int _y1);
+    // for conjugate gradients: the pressure operator, the sum over the fluid
+    // neighbours of the centre minus the neighbour, so that residual() is
+    // _alpha * _divergence - laplacian(); returns the dot product of
+    // _pressure and _out
+    static double laplacian(const mkFluidField& _pressure, const mkFluidField& _fluid, mkFluidField& _out, int _y0, int _y1);
+    // the Jacobi preconditioner, 1 / the operator's diagonal, 0 in
+    // obstacles; returns the number of fluid cells
+    static double inverseDiagonal(const mkFluidField& _fluid, mkFluidField& _out, int _y0, int _y1);
+    // _pressure += _step * _direction, _residual -= _step * _q, _z the
+    // preconditioned residual; returns residual . _z, and residual . residual
+    // in _residualSquared
+    static double conjugateStep(const mkFluidField& _direction, const mkFluidField& _q, const mkFluidField& _inverseDiagonal, float _step, mkFluidField& _pressure, mkFluidField& _residual, mkFluidField& _z, double& _residualSquared, int _y0, int _y1);
+    // _y = _a * _x + _b * _y
+    static void addScaled(const mkFluidField& _x, float _a, float _b, mkFluidField& _y, int _y0, int _y1);
+    static double dot(const mkFluidField& _a, const mkFluidField& _b, int _y0, int _y1);
+    // multigrid transfers between a grid and one of half its interior size,
+    // rounded up, _y0 and _y1 are rows of the coarse grid for the first two
+    // and of the fine one for prolongate(); the residual is summed, a coarse
+    // cell is fluid where any of its four is and the coarse error is added
+    // bilinearly from the fluid coarse cells only
+    static void restrictResidual(const mkFluidField& _residual, mkFluidField& _coarse, int _y0, int _y1);
+    static void restrictFluid(const mkFluidField& _fluid, mkFluidField& _coarse, int _y0, int _y1);
+    static void prolongate(const mkFluidField& _coarse, const mkFluidField& _coarseFluid, const mkFluidField& _fluid, mkFluidField& _pressure, int _y0, int _y1);
+    static void subtractGradient(const mkFluidField& _pressure, const mkFluidField& _fluid, float _halfInverseCell, mkFluidField& _velocity, int _y0, int _y1);
+    // _field *= max(0, 1 + _factor * |_scalar|), the length over _scalar's channels
+    static void multiplyByLength(mkFluidField& _field, const mkFluidField& _scalar, float _factor, int _y0, int _y1);
+};
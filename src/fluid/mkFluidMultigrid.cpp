@@ -0,0 +1,112 @@
+#include "mkFluidMultigrid.h"
+
+// damped Jacobi smooths the checkerboard error that plain Jacobi leaves
+#define MK_MULTIGRID_WEIGHT 0.8f
+#define MK_MULTIGRID_PRE_SWEEPS 2
+#define MK_MULTIGRID_POST_SWEEPS 2
+
+//--------------------------------------------------------------
+mkFluidMultigrid::mkFluidMultigrid() : pool(NULL), numBands(1), lastResidual(0) {
+}
+
+//--------------------------------------------------------------
+mkFluidMultigrid::~mkFluidMultigrid() {
+    for (int i = 0; i < levels.size(); i++)
+        delete levels[i];
+}
+
+//--------------------------------------------------------------
+void mkFluidMultigrid::setup(int _width, int _height, mkWorkerPool* _pool, int _maxBands) {
+    for (int i = 0; i < levels.size(); i++)
+        delete levels[i];
+    levels.clear();
+    
+    pool = _pool;
+    numBands = MAX(1, MIN((_height - 2) / 4, _maxBands));
+    bandSums.assign(numBands, 0);
+    residual.allocate(_width, _height, 1);
+    
+    int width = _width - 2, height = _height - 2;
+    while (MIN(width, height) > MK_MULTIGRID_MIN_SIZE) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        Level* level = new Level();
+        level->numBands = MAX(1, MIN(height / 4, _maxBands));
+        level->error.allocate(width + 2, height + 2, 1);
+        level->errorBack.allocate(width + 2, height + 2, 1);
+        level->rhs.allocate(width + 2, height + 2, 1);
+        level->residual.allocate(width + 2, height + 2, 1);
+        level->fluid.allocate(width + 2, height + 2, 1);
+        levels.push_back(level);
+    }
+}
+
+//--------------------------------------------------------------
+int mkFluidMultigrid::solve(mkFluidField& _pressure, mkFluidField& _back, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, int _minCycles, int _maxCycles, float _tolerance) {
+    // obstacles move every frame
+    const mkFluidField* fluid = &_fluid;
+    for (int i = 0; i < levels.size(); i++) {
+        Level& level = *levels[i];
+        forBands(level.fluid.getHeight(), level.numBands, [&](int _y0, int _y1) { mkFluidKernels::restrictFluid(*fluid, level.fluid, _y0, _y1); });
+        fluid = &level.fluid;
+    }
+    
+    // a residual pass costs about a tenth of a cycle, measure after every
+    // cycle only when that can end the solve early
+    bool adaptive = _tolerance > 0;
+    if (adaptive)
+        lastResidual = residualRms(_pressure, _divergence, _fluid, _alpha);
+    int numCycles = 0;
+    while (numCycles < _maxCycles && (numCycles < _minCycles || !adaptive || lastResidual > _tolerance)) {
+        if (levels.empty())
+            // too small to coarsen
+            smooth(_pressure, _back, _divergence, _fluid, _alpha, numBands, MK_MULTIGRID_PRE_SWEEPS + MK_MULTIGRID_POST_SWEEPS);
+        else
+            cycle(0, _pressure, _back, _divergence, _fluid, residual, _alpha, numBands);
+        numCycles++;
+        if (adaptive)
+            lastResidual = residualRms(_pressure, _divergence, _fluid, _alpha);
+    }
+    if (!adaptive)
+        lastResidual = residualRms(_pressure, _divergence, _fluid, _alpha);
+    return numCycles;
+}
+
+//--------------------------------------------------------------
+float mkFluidMultigrid::residualRms(const mkFluidField& _x, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha) {
+    int height = _x.getHeight();
+    double squared = sumBands(height, [&](int _y0, int _y1) { return mkFluidKernels::residual(_x, _b, _fluid, _alpha, residual, _y0, _y1); });
+    return sqrt(squared / ((_x.getWidth() - 2) * (height - 2)));
+}
+
+//--------------------------------------------------------------
+void mkFluidMultigrid::smooth(mkFluidField& _x, mkFluidField& _back, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha, int _numBands, int _numSweeps) {
+    for (int i = 0; i < _numSweeps; i++) {
+        _x.swap(_back);
+        forBands(_x.getHeight(), _numBands, [&](int _y0, int _y1) { mkFluidKernels::jacobi(_back, _b, _fluid, _alpha, MK_MULTIGRID_WEIGHT, _x, _y0, _y1); });
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidMultigrid::cycle(int _level, mkFluidField& _x, mkFluidField& _back, const mkFluidField& _b, const mkFluidField& _fluid, mkFluidField& _residual, float _alpha, int _numBands) {
+    int height = _x.getHeight();
+    smooth(_x, _back, _b, _fluid, _alpha, _numBands, MK_MULTIGRID_PRE_SWEEPS);
+    forBands(height, _numBands, [&](int _y0, int _y1) { mkFluidKernels::residual(_x, _b, _fluid, _alpha, _residual, _y0, _y1); });
+    
+    // the coarse level solves for the error of this one, the residual being
+    // its right hand side; the residual already carries _alpha
+    Level& coarse = *levels[_level];
+    int coarseHeight = coarse.error.getHeight();
+    forBands(coarseHeight, coarse.numBands, [&](int _y0, int _y1) { mkFluidKernels::restrictResidual(_residual, coarse.rhs, _y0, _y1); });
+    coarse.error.clear();
+    if (_level + 1 < levels.size())
+        cycle(_level + 1, coarse.error, coarse.errorBack, coarse.rhs, coarse.fluid, coarse.residual, 1, coarse.numBands);
+    else {
+        // a few cells across, sweep until the error has crossed it a few times
+        int size = MAX(coarse.error.getWidth(), coarseHeight);
+        smooth(coarse.error, coarse.errorBack, coarse.rhs, coarse.fluid, 1, 1, size * size);
+    }
+    
+    forBands(height, _numBands, [&](int _y0, int _y1) { mkFluidKernels::prolongate(coarse.error, coarse.fluid, _fluid, _x, _y0, _y1); });
+    smooth(_x, _back, _b, _fluid, _alpha, _numBands, MK_MULTIGRID_POST_SWEEPS);
+}
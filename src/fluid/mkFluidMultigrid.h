@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkFluidField.h"
+#include "mkFluidKernels.h"
+#include "mkWorkerPool.h"
+#include "mkSimd.h"
+
+// A geometric multigrid solver for the pressure step of mkFluidSimulation,
+// the same equation as mkFluidKernels::jacobi() solved with V-cycles.
+// Jacobi sweeps only smooth the error over a few cells each, so a grid
+// twice the size needs four times the sweeps; a V-cycle smooths on every
+// level of a pyramid of halved grids, down to a few cells, which takes out
+// the error at every scale for about twice the work of the finest level.
+//
+// Each level keeps its own fluid mask, fluid where any of the four finer
+// cells is, so pressure keeps off obstacles on every level. Obstacles
+// thinner than a level's cells vanish there; that only slows the cycle, the
+// finest level still sees them. All storage is allocated in setup().
+
+#define MK_MULTIGRID_MIN_SIZE 4
+
+class mkFluidMultigrid {
+public:
+    mkFluidMultigrid();
+    ~mkFluidMultigrid();
+    
+    // _width and _height of the finest grid, the wall included; the kernels
+    // of each level run on up to _maxBands bands of _pool
+    void    setup(int _width, int _height, mkWorkerPool* _pool, int _maxBands);
+    
+    // up to _maxCycles V-cycles on _pressure, with _alpha as in jacobi();
+    // _back is a field of the same size to ping-pong with, both may come
+    // back swapped. Stops once the RMS of residual() over the cells inside
+    // the wall is at most _tolerance, but not before _minCycles; a
+    // _tolerance of 0 runs all of them. Returns the number of cycles run.
+    int     solve(mkFluidField& _pressure, mkFluidField& _back, const mkFluidField& _divergence, const mkFluidField& _fluid, float _alpha, int _minCycles, int _maxCycles, float _tolerance = 0);
+    
+    int     getNumLevels() const			{ return levels.size() + 1; }
+    // after solve(), the RMS residual it stopped at
+    float   getResidual() const				{ return lastResidual; }
+    
+protected:
+    struct Level {
+        int             numBands;
+        mkFluidField    error;
+        mkFluidField    errorBack;
+        mkFluidField    rhs;
+        mkFluidField    residual;
+        mkFluidField    fluid;
+    };
+    
+    template<typename F>
+    void    forBands(int _height, int _numBands, F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            _function(1 + _band * (_height - 2) / _numBands, 1 + (_band + 1) * (_height - 2) / _numBands);
+        };
+        pool->parallelFor(_numBands, band);
+    }
+    
+    // forBands() on the finest level for functions returning a partial sum,
+    // adds them up
+    template<typename F>
+    double  sumBands(int _height, F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            bandSums[_band] = _function(1 + _band * (_height - 2) / numBands, 1 + (_band + 1) * (_height - 2) / numBands);
+        };
+        pool->parallelFor(numBands, band);
+        double sum = 0;
+        for (int i = 0; i < numBands; i++)
+            sum += bandSums[i];
+        return sum;
+    }
+    
+    float   residualRms(const mkFluidField& _x, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha);
+    void    smooth(mkFluidField& _x, mkFluidField& _back, const mkFluidField& _b, const mkFluidField& _fluid, float _alpha, int _numBands, int _numSweeps);
+    void    cycle(int _level, mkFluidField& _x, mkFluidField& _back, const mkFluidField& _b, const mkFluidField& _fluid, mkFluidField& _residual, float _alpha, int _numBands);
+    
+    mkWorkerPool*   pool;
+    int             numBands;
+    vector<double>  bandSums;
+    float           lastResidual;
+    mkFluidField    residual;
+    vector<Level*>  levels;             // the coarse ones, finest first
+};
@@ -0,0 +1,326 @@
+#include "mkFluidSimulation.h"
+
+//--------------------------------------------------------------
+mkFluidSimulation::mkFluidSimulation() : width(0), height(0), numBands(1), lastTime(0), pressureIterations(0), pressureResidual(0) {
+    parameters.setName("fluid solver");
+    parameters.add(doReset.set("reset", false));
+    parameters.add(speed.set("speed", 20, 0, 100));
+    parameters.add(cellSize.set("cell size", 1.25, 0.1, 2));
+    parameters.add(numJacobiIterations.set("iterations", 40, 1, 100));
+    parameters.add(pressureSolver.set("pressure solver", MK_PRESSURE_JACOBI, MK_PRESSURE_JACOBI, MK_PRESSURE_NUM_SOLVERS - 1));
+    parameters.add(numMultigridCycles.set("multigrid cycles", 2, 1, 10));
+    parameters.add(sorOmega.set("sor omega", 1.8, 1, 1.99));
+    parameters.add(tolerance.set("tolerance", 0.001, 0, 0.01));
+    parameters.add(minIterations.set("min iterations", 1, 0, 10));
+    parameters.add(tiled.set("tiled", false));
+    parameters.add(viscosity.set("viscosity", 0.1, 0, 1));
+    parameters.add(vorticity.set("vorticity", 0.6, 0, 1));
+    parameters.add(dissipation.set("dissipation", 0.002, 0, 0.02));
+    advancedDissipationParameters.setName("advanced dissipation");
+    advancedDissipationParameters.add(velocityOffset.set("velocity offset", -0.001, -0.01, 0.01));
+    advancedDissipationParameters.add(densityOffset.set("density offset", 0, -0.01, 0.01));
+    advancedDissipationParameters.add(temperatureOffset.set("temperature offset", 0.005, -0.01, 0.01));
+    parameters.add(advancedDissipationParameters);
+    smokeBuoyancyParameters.setName("smoke buoyancy");
+    smokeBuoyancyParameters.add(smokeSigma.set("sigma", 0.05, 0, 1));
+    smokeBuoyancyParameters.add(smokeWeight.set("weight", 0.05, 0, 1));
+    smokeBuoyancyParameters.add(ambientTemperature.set("ambient temperature", 0, 0, 1));
+    smokeBuoyancyParameters.add(gravity.set("gravity", ofVec2f(0.01, 0), ofVec2f(-1, -1), ofVec2f(1, 1)));
+    parameters.add(smokeBuoyancyParameters);
+    maxValues.setName("maximum");
+    maxValues.add(clampForce.set("clampForce", 0.05, 0, 0.1));
+    maxValues.add(maxDensity.set("density", 2, 0, 5));
+    maxValues.add(maxVelocity.set("velocity", 4, 0, 10));
+    maxValues.add(maxTemperature.set("temperature", 2, 0, 5));
+    parameters.add(maxValues);
+    parameters.add(densityFromPressure.set("density from pressure", 0, -0.1, 0.1));
+    parameters.add(densityFromVorticity.set("density from vorticity", -0.1, -0.5, 0.5));
+}
+
+//--------------------------------------------------------------
+mkFluidSimulation::~mkFluidSimulation() {
+    for (size_t i = 0; i < tiles.size(); i++)
+        delete tiles[i];
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::setup(int _width, int _height, int _numThreads) {
+    width = _width;
+    height = _height;
+    if (_numThreads != 1)
+        pool.setup(_numThreads - 1);
+    // a few bands per thread, so uneven bands balance out
+    numBands = MAX(1, MIN((height - 2) / 4, (pool.getNumThreads() + 1) * 4));
+    bandSums.assign(numBands, 0);
+    
+    velocity.allocate(width, height, 2);
+    density.allocate(width, height, 4);
+    temperature.allocate(width, height, 1);
+    pressure.allocate(width, height, 1);
+    divergence.allocate(width, height, 1);
+    curl.allocate(width, height, 1);
+    confinement.allocate(width, height, 2);
+    buoyancy.allocate(width, height, 2);
+    obstacle.allocate(width, height, 1);
+    combinedObstacle.allocate(width, height, 1);
+    fluid.allocate(width, height, 1);
+    velocityBack.allocate(width, height, 2);
+    velocityStart.allocate(width, height, 2);
+    densityBack.allocate(width, height, 4);
+    temperatureBack.allocate(width, height, 1);
+    pressureBack.allocate(width, height, 1);
+    
+    multigrid.setup(width, height, &pool, numBands);
+    conjugateGradient.setup(width, height, &pool, numBands);
+    
+    // as many rows as fit the cache with the planes of a viscosity sweep:
+    // velocity, its start, the result and both windows, 2 channels each,
+    // and the fluid; but at least a tile per band
+    for (size_t i = 0; i < tiles.size(); i++)
+        delete tiles[i];
+    tiles.clear();
+    int tileRows = MAX(2 * MK_FLUID_TILE_SWEEPS, MK_FLUID_TILE_BYTES / (int)(velocity.getStride() * sizeof(float) * 11));
+    int numTiles = MAX(numBands, (height - 2 + tileRows - 1) / tileRows);
+    for (int i = 0; i < numTiles; i++) {
+        Tile* tile = new Tile();
+        tile->y0 = 1 + i * (height - 2) / numTiles;
+        tile->y1 = 1 + (i + 1) * (height - 2) / numTiles;
+        for (int j = 0; j < 2; j++) {
+            tile->window[j].allocateWindow(width, height, 2, tile->y1 - tile->y0 + 2 * MK_FLUID_TILE_SWEEPS);
+            tile->window[j].setFirstRow(tile->y0 - MK_FLUID_TILE_SWEEPS);
+        }
+        tiles.push_back(tile);
+    }
+    tileSums.assign(numTiles, 0);
+    
+    reset();
+    lastTime = ofGetElapsedTimef();
+}
+
+//--------------------------------------------------------------
+bool mkFluidSimulation::loadSettings(const string& _path) {
+    ofXml xml;
+    if (!xml.load(_path)) {
+        ofLogWarning("mkFluidSimulation") << "could not load " << _path;
+        return false;
+    }
+    xml.deserialize(parameters);
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::reset() {
+    velocity.clear();
+    density.clear();
+    temperature.clear();
+    pressure.clear();
+    divergence.clear();
+    curl.clear();
+    confinement.clear();
+    buoyancy.clear();
+    
+    // the wall around the grid is the only obstacle
+    obstacle.clear();
+    for (int y = 0; y < height; y++) {
+        float* row = obstacle.getRow(0, y);
+        if (y == 0 || y == height - 1)
+            for (int x = 0; x < width; x++)
+                row[x] = 1;
+        row[0] = 1;
+        row[width - 1] = 1;
+    }
+    combinedObstacle.copyFrom(obstacle);
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::update(float _deltaTime) {
+    float time = ofGetElapsedTimef();
+    float deltaTime = _deltaTime > 0 ? _deltaTime : MIN(time - lastTime, 1.0f / 30.0f);
+    lastTime = time;
+    float timeStep = deltaTime * speed.get();
+    float halfInverseCell = 0.5f / cellSize.get();
+    
+    if (doReset.get()) {
+        reset();
+        doReset = false;
+    }
+    // the per-cell steps that follow each other run in one pass, each
+    // band's rows still in cache from the step before
+    forAllBands([&](int _y0, int _y1) {
+        mkFluidKernels::fluidMask(combinedObstacle, fluid, _y0, _y1);
+        if (maxDensity.get() > 0)
+            mkFluidKernels::clampLength(density, maxDensity.get(), clampForce.get(), _y0, _y1);
+        if (maxVelocity.get() > 0)
+            mkFluidKernels::clampLength(velocity, maxVelocity.get(), clampForce.get(), _y0, _y1);
+        if (maxTemperature.get() > 0)
+            mkFluidKernels::clampLength(temperature, maxTemperature.get(), clampForce.get(), _y0, _y1);
+    });
+    
+    // VORTICITY CONFINEMENT
+    if (vorticity.get() > 0) {
+        forBands([&](int _y0, int _y1) { mkFluidKernels::curl(velocity, fluid, halfInverseCell, curl, _y0, _y1); });
+        float scale = timeStep * vorticity.get();
+        forBands([&](int _y0, int _y1) { mkFluidKernels::confinement(curl, fluid, halfInverseCell, scale, velocity, confinement, _y0, _y1); });
+    }
+    else
+        confinement.clear();
+    
+    // ADVECT VELOCITY, VISCOSITY
+    float advectStep = timeStep / cellSize.get();
+    advect(velocity, velocityBack, advectStep, 1.0f - (dissipation.get() + velocityOffset.get()));
+    if (viscosity.get() > 0)
+        diffuse(timeStep);
+    
+    // SMOKE BUOYANCY
+    if (smokeSigma.get() > 0 && smokeWeight.get() > 0) {
+        float temperatureDissipation = 1.0f - (dissipation.get() + temperatureOffset.get());
+        float sigma = timeStep * smokeSigma.get();
+        // a cell's temperature is advected along its own velocity, before
+        // its buoyancy adds to it
+        temperature.swap(temperatureBack);
+        forBands([&](int _y0, int _y1) {
+            mkFluidKernels::advect(velocity, temperatureBack, fluid, advectStep, temperatureDissipation, temperature, _y0, _y1);
+            mkFluidKernels::clampLength(temperature, 2, 1, _y0, _y1);
+            mkFluidKernels::buoyancy(temperature, density, fluid, ambientTemperature.get(), sigma, smokeWeight.get(), gravity.get(), velocity, buoyancy, _y0, _y1);
+        });
+    }
+    else {
+        temperature.clear();
+        buoyancy.clear();
+    }
+    
+    // PRESSURE
+    project();
+    
+    // ADVECT DENSITY
+    float densityDissipation = 1.0f - (dissipation.get() + densityOffset.get());
+    density.swap(densityBack);
+    forBands([&](int _y0, int _y1) {
+        mkFluidKernels::advect(velocity, densityBack, fluid, advectStep, densityDissipation, density, _y0, _y1);
+        if (densityFromPressure.get() != 0)
+            mkFluidKernels::multiplyByLength(density, pressure, densityFromPressure.get(), _y0, _y1);
+        if (densityFromVorticity.get() != 0)
+            mkFluidKernels::multiplyByLength(density, confinement, densityFromVorticity.get(), _y0, _y1);
+    });
+    
+    // temporary obstacles last one update
+    combinedObstacle.copyFrom(obstacle);
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::advect(mkFluidField& _field, mkFluidField& _back, float _timeStep, float _dissipation) {
+    _field.swap(_back);
+    // velocity moves itself along its previous state
+    const mkFluidField& along = &_field == &velocity ? _back : velocity;
+    forBands([&](int _y0, int _y1) { mkFluidKernels::advect(along, _back, fluid, _timeStep, _dissipation, _field, _y0, _y1); });
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::diffuse(float _timeStep) {
+    float alpha = cellSize.get() * cellSize.get() / (viscosity.get() * _timeStep);
+    float inverseBeta = 1.0f / (4.0f + alpha);
+    auto sweep = [&](const mkFluidField& _x, mkFluidField& _out, int _y0, int _y1) {
+        mkFluidKernels::diffuse(_x, velocityStart, fluid, alpha, inverseBeta, _out, _y0, _y1);
+        return 0.0;
+    };
+    if (tiled.get()) {
+        // the first sweeps read the start, no need to copy it
+        velocity.swap(velocityStart);
+        for (int i = 0; i < numJacobiIterations.get(); i += MK_FLUID_TILE_SWEEPS) {
+            if (i > 0)
+                velocity.swap(velocityBack);
+            sweepTiles(i > 0 ? velocityBack : velocityStart, velocity, MIN(MK_FLUID_TILE_SWEEPS, numJacobiIterations.get() - i), sweep, false, [](const mkFluidField&, int, int) {});
+        }
+    }
+    else {
+        velocityStart.copyFrom(velocity);
+        for (int i = 0; i < numJacobiIterations.get(); i++) {
+            velocity.swap(velocityBack);
+            forBands([&](int _y0, int _y1) { sweep(velocityBack, velocity, _y0, _y1); });
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkFluidSimulation::project() {
+    float halfInverseCell = 0.5f / cellSize.get();
+    float alpha = -cellSize.get() * cellSize.get();
+    // last frame's pressure, faded, is the first guess
+    forBands([&](int _y0, int _y1) {
+        mkFluidKernels::divergence(velocity, fluid, halfInverseCell, divergence, _y0, _y1);
+        mkFluidKernels::scale(pressure, 0.9f, _y0, _y1);
+    });
+    bool subtracted = false;
+    
+    // the residual is in cell size squared times divergence
+    if (pressureSolver.get() == MK_PRESSURE_MULTIGRID) {
+        pressureIterations = multigrid.solve(pressure, pressureBack, divergence, fluid, alpha, minIterations.get(), numMultigridCycles.get(), tolerance.get() * -alpha);
+        pressureResidual = multigrid.getResidual() / -alpha;
+    }
+    else if (pressureSolver.get() == MK_PRESSURE_CONJUGATE_GRADIENT) {
+        pressureIterations = conjugateGradient.solve(pressure, divergence, fluid, alpha, minIterations.get(), numJacobiIterations.get(), tolerance.get() * -alpha);
+        pressureResidual = conjugateGradient.getResidual() / -alpha;
+    }
+    else if (pressureSolver.get() == MK_PRESSURE_SOR) {
+        // the black cells read the red ones already moved, the residual
+        // measured on the way is a little behind
+        float residualScale = 1.0f / (-alpha * sqrt((width - 2) * (height - 2)));
+        pressureIterations = 0;
+        while (pressureIterations < numJacobiIterations.get()) {
+            double squared = sumBands([&](int _y0, int _y1) { return mkFluidKernels::sor(pressure, divergence, fluid, alpha, sorOmega.get(), 0, _y0, _y1); });
+            squared += sumBands([&](int _y0, int _y1) { return mkFluidKernels::sor(pressure, divergence, fluid, alpha, sorOmega.get(), 1, _y0, _y1); });
+            pressureResidual = sqrt(squared) * residualScale;
+            pressureIterations++;
+            if (pressureIterations >= minIterations.get() && pressureResidual <= tolerance.get())
+                break;
+        }
+    }
+    else if (tiled.get()) {
+        // as below, but checked only after each tile's sweeps, so it may
+        // stop a few sweeps later; the first ones stop at "min iterations",
+        // so frames at rest still take one sweep. The last sweeps subtract
+        // the gradient on the way out.
+        float residualScale = 1.0f / (-alpha * sqrt((width - 2) * (height - 2)));
+        auto sweep = [&](const mkFluidField& _pressure, mkFluidField& _out, int _y0, int _y1) { return mkFluidKernels::jacobi(_pressure, divergence, fluid, alpha, 1, _out, _y0, _y1); };
+        auto gradient = [&](const mkFluidField& _pressure, int _y0, int _y1) { mkFluidKernels::subtractGradient(_pressure, fluid, halfInverseCell, velocity, _y0, _y1); };
+        pressureIterations = 0;
+        while (pressureIterations < numJacobiIterations.get()) {
+            int first = pressureIterations < minIterations.get() ? minIterations.get() : numJacobiIterations.get();
+            int numSweeps = MIN(MK_FLUID_TILE_SWEEPS, first - pressureIterations);
+            subtracted = pressureIterations + numSweeps == numJacobiIterations.get();
+            pressure.swap(pressureBack);
+            double squared = sweepTiles(pressureBack, pressure, numSweeps, sweep, subtracted, gradient);
+            pressureResidual = sqrt(squared) * residualScale;
+            pressureIterations += numSweeps;
+            if (pressureIterations >= minIterations.get() && pressureResidual <= tolerance.get())
+                break;
+        }
+    }
+    else {
+        // each sweep measures the residual of the pressure it starts from,
+        // the one it leaves is lower still
+        float residualScale = 1.0f / (-alpha * sqrt((width - 2) * (height - 2)));
+        pressureIterations = 0;
+        while (pressureIterations < numJacobiIterations.get()) {
+            pressure.swap(pressureBack);
+            double squared = sumBands([&](int _y0, int _y1) { return mkFluidKernels::jacobi(pressureBack, divergence, fluid, alpha, 1, pressure, _y0, _y1); });
+            pressureResidual = sqrt(squared) * residualScale;
+            pressureIterations++;
+            if (pressureIterations >= minIterations.get() && pressureResidual <= tolerance.get())
+                break;
+        }
+    }
+    if (!subtracted)
+        forBands([&](int _y0, int _y1) { mkFluidKernels::subtractGradient(pressure, fluid, halfInverseCell, velocity, _y0, _y1); });
+}
+
+//--------------------------------------------------------------
+string mkFluidSimulation::getPressureSolverName(mkPressureSolver _solver) {
+    switch (_solver) {
+        case MK_PRESSURE_JACOBI:                return "jacobi";
+        case MK_PRESSURE_MULTIGRID:             return "multigrid";
+        case MK_PRESSURE_SOR:                   return "red-black sor";
+        case MK_PRESSURE_CONJUGATE_GRADIENT:    return "conjugate gradient";
+        default:                                return "unknown";
+    }
+}
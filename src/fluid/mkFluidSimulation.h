@@ -0,0 +1,259 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkFluidField.h"
+#include "mkFluidKernels.h"
+#include "mkFluidMultigrid.h"
+#include "mkFluidConjugateGradient.h"
+#include "mkWorkerPool.h"
+#include "mkSimd.h"
+
+// The marbling fluid on the CPU, for machines without a GPU: the same steps
+// in the same order as ftFluidSimulation, with the same parameters, so the
+// "fluid_solver" group of settings.xml drives either one. Per update:
+// clamp, vorticity confinement, advect velocity, viscosity, advect
+// temperature and add its buoyancy, pressure projection, advect density.
+//
+// Forces come in as interleaved ofFloatPixels instead of textures, in the
+// simulation's size or resampled to it; the fields go out as structure of
+// arrays mkFluidFields. Every step runs its kernels (see mkFluidKernels) on
+// row bands spread over a worker pool, with denormals flushed to zero.
+//
+// The pressure step runs the Jacobi sweeps of the shaders, "iterations" of
+// them, red-black SOR sweeps, "iterations" of them over-relaxed by "sor
+// omega", in place without a second pressure field, multigrid V-cycles
+// (see mkFluidMultigrid), which reach the same residual in a fraction of
+// the work and keep doing so on finer grids, or "iterations" of
+// preconditioned conjugate gradients (see mkFluidConjugateGradient), for
+// when the pressure has to be right. Each stops early once the divergence
+// left over is below "tolerance", after "min iterations" sweeps or cycles,
+// so frames where the fluid is nearly at rest hand most of the solve's time
+// back.
+//
+// The per-cell steps that follow each other run in one pass over each
+// band: the mask and the clamps, advecting temperature with its clamp and
+// buoyancy, divergence with fading the pressure, and advecting density with
+// what it takes from pressure and vorticity. "tiled" also runs the Jacobi
+// sweeps of viscosity and pressure a few at a time on tiles of rows sized
+// for the cache, each tile sweeping its rows and a halo that shrinks by a
+// row per sweep (see sweepTiles()), and subtracts the gradient with the last
+// pressure sweeps; the fields then stream from memory once per few sweeps
+// instead of once per sweep, for the price of sweeping the halos twice.
+// With a "tolerance" of 0 the results are the same to the bit; otherwise
+// the tiles check it only every MK_FLUID_TILE_SWEEPS sweeps and may run up
+// to MK_FLUID_TILE_SWEEPS - 1 sweeps past where the pressure solve pass by
+// pass stops. It pays off once the fields outgrow the cache and the threads
+// share the memory bandwidth; with a cache that holds them, or sweeps bound
+// by arithmetic, the halos make it a little slower.
+
+// the cache a tile's rows should fit in, and the sweeps run per tile
+#define MK_FLUID_TILE_BYTES (512 * 1024)
+#define MK_FLUID_TILE_SWEEPS 4
+
+enum mkPressureSolver {
+    MK_PRESSURE_JACOBI = 0,
+    MK_PRESSURE_MULTIGRID,
+    MK_PRESSURE_SOR,
+    MK_PRESSURE_CONJUGATE_GRADIENT,
+    MK_PRESSURE_NUM_SOLVERS
+};
+
+class mkFluidSimulation {
+public:
+    mkFluidSimulation();
+    ~mkFluidSimulation();
+    
+    // _numThreads counts the caller, 1 runs everything on it, 0 uses all cores
+    void    setup(int _width, int _height, int _numThreads = 0);
+    // the "fluid_solver" group of a settings file saved by the app's gui
+    bool    loadSettings(const string& _path);
+    void    reset();
+    
+    // _deltaTime in seconds, 0 takes the last frame time up to 1/30
+    void    update(float _deltaTime = 0);
+    
+    void    addVelocity(const ofFloatPixels& _velocity, float _strength = 1.0)		{ velocity.add(_velocity, _strength); }
+    void    addDensity(const ofFloatPixels& _density, float _strength = 1.0)		{ density.add(_density, _strength); }
+    void    addTemperature(const ofFloatPixels& _temperature, float _strength = 1.0)	{ temperature.add(_temperature, _strength); }
+    void    addPressure(const ofFloatPixels& _pressure, float _strength = 1.0)		{ pressure.add(_pressure, _strength); }
+    // stays until reset
+    void    addObstacle(const ofFloatPixels& _obstacle)		{ obstacle.add(_obstacle); combinedObstacle.add(_obstacle); }
+    // for the next update only
+    void    addTempObstacle(const ofFloatPixels& _obstacle)	{ combinedObstacle.add(_obstacle); }
+    
+    int     getWidth() const					{ return width; }
+    int     getHeight() const					{ return height; }
+    float   getSpeed() const					{ return speed.get(); }
+    float   getCellSize() const				{ return cellSize.get(); }
+    
+    const mkFluidField& getVelocity() const		{ return velocity; }
+    const mkFluidField& getDensity() const		{ return density; }
+    const mkFluidField& getTemperature() const	{ return temperature; }
+    const mkFluidField& getPressure() const		{ return pressure; }
+    const mkFluidField& getDivergence() const	{ return divergence; }
+    const mkFluidField& getConfinement() const	{ return confinement; }
+    const mkFluidField& getSmokeBuoyancy() const	{ return buoyancy; }
+    const mkFluidField& getObstacle() const		{ return combinedObstacle; }
+    
+    // of the last update: sweeps or cycles the pressure solve ran, and the
+    // RMS divergence it left, in the units of getDivergence()
+    int     getPressureIterations() const		{ return pressureIterations; }
+    float   getPressureResidual() const		{ return pressureResidual; }
+    
+    mkPressureSolver	getPressureSolver() const				{ return (mkPressureSolver)pressureSolver.get(); }
+    void				setPressureSolver(mkPressureSolver _solver)	{ pressureSolver.set(_solver); }
+    void				setTolerance(float _tolerance)			{ tolerance.set(_tolerance); }
+    bool				getTiled() const						{ return tiled.get(); }
+    void				setTiled(bool _tiled)					{ tiled.set(_tiled); }
+    static string		getPressureSolverName(mkPressureSolver _solver);
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    // runs _function(y0, y1) on bands of the rows inside the wall
+    template<typename F>
+    void    forBands(F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            _function(1 + _band * (height - 2) / numBands, 1 + (_band + 1) * (height - 2) / numBands);
+        };
+        pool.parallelFor(numBands, band);
+    }
+    // forBands() for functions returning a partial sum, adds them up
+    template<typename F>
+    double  sumBands(F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            bandSums[_band] = _function(1 + _band * (height - 2) / numBands, 1 + (_band + 1) * (height - 2) / numBands);
+        };
+        pool.parallelFor(numBands, band);
+        double sum = 0;
+        for (int i = 0; i < numBands; i++)
+            sum += bandSums[i];
+        return sum;
+    }
+    // the same on all rows, walls included
+    template<typename F>
+    void    forAllBands(F _function) {
+        auto band = [&](int _band) {
+            mkFlushDenormals flush;
+            _function(_band * height / numBands, (_band + 1) * height / numBands);
+        };
+        pool.parallelFor(numBands, band);
+    }
+    
+    // up to MK_FLUID_TILE_SWEEPS sweeps from _in to _out tile by tile,
+    // _sweep(from, to, y0, y1) being a Jacobi sweep that reads a row above
+    // and below. A tile's first sweep reads _in for its rows and a halo of a
+    // row per sweep left, and writes its first window; each further one
+    // reads the last window and writes the other, a row less of halo around
+    // the tile, and the last writes the tile's rows to _out. If _finishing,
+    // the last one stays in the window with a row around the tile, for
+    // _finish(result, y0, y1). Returns the sum of the last sweep's returns
+    // over the tiles' own rows.
+    template<typename S, typename F>
+    double  sweepTiles(const mkFluidField& _in, mkFluidField& _out, int _numSweeps, S _sweep, bool _finishing, F _finish) {
+        auto tile = [&](int _tile) {
+            mkFlushDenormals flush;
+            Tile& t = *tiles[_tile];
+            const mkFluidField* from = &_in;
+            for (int i = 0; i < _numSweeps - 1; i++) {
+                int halo = _numSweeps - i - (_finishing ? 0 : 1);
+                mkFluidField& to = t.window[i % 2];
+                _sweep(*from, to, MAX(1, t.y0 - halo), MIN(height - 1, t.y1 + halo));
+                from = &to;
+            }
+            if (!_finishing) {
+                tileSums[_tile] = _sweep(*from, _out, t.y0, t.y1);
+                return;
+            }
+            
+            // the neighbours sweep the row around too, count it once
+            mkFluidField& to = t.window[(_numSweeps - 1) % 2];
+            _sweep(*from, to, MAX(1, t.y0 - 1), t.y0);
+            tileSums[_tile] = _sweep(*from, to, t.y0, t.y1);
+            _sweep(*from, to, t.y1, MIN(height - 1, t.y1 + 1));
+            for (int c = 0; c < _out.getNumChannels(); c++)
+                for (int y = t.y0; y < t.y1; y++)
+                    memcpy(_out.getRow(c, y), to.getRow(c, y), _out.getStride() * sizeof(float));
+            _finish(to, t.y0, t.y1);
+        };
+        pool.parallelFor(tiles.size(), tile);
+        double sum = 0;
+        for (size_t i = 0; i < tiles.size(); i++)
+            sum += tileSums[i];
+        return sum;
+    }
+    
+    void    advect(mkFluidField& _field, mkFluidField& _back, float _timeStep, float _dissipation);
+    void    diffuse(float _timeStep);
+    void    project();
+    
+    ofParameter<bool>	doReset;
+    ofParameter<float>	speed;
+    ofParameter<float>	cellSize;
+    ofParameter<int>	numJacobiIterations;
+    ofParameter<int>	pressureSolver;
+    ofParameter<int>	numMultigridCycles;
+    ofParameter<float>	sorOmega;
+    ofParameter<float>	tolerance;
+    ofParameter<int>	minIterations;
+    ofParameter<bool>	tiled;
+    ofParameter<float>	viscosity;
+    ofParameter<float>	vorticity;
+    ofParameter<float>	dissipation;
+    ofParameterGroup	advancedDissipationParameters;
+    ofParameter<float>	velocityOffset;
+    ofParameter<float>	densityOffset;
+    ofParameter<float>	temperatureOffset;
+    ofParameterGroup	smokeBuoyancyParameters;
+    ofParameter<float>	smokeSigma;
+    ofParameter<float>	smokeWeight;
+    ofParameter<float>	ambientTemperature;
+    ofParameter<ofVec2f>	gravity;
+    ofParameterGroup	maxValues;
+    ofParameter<float>	clampForce;
+    ofParameter<float>	maxDensity;
+    ofParameter<float>	maxVelocity;
+    ofParameter<float>	maxTemperature;
+    ofParameter<float>	densityFromPressure;
+    ofParameter<float>	densityFromVorticity;
+    
+    int             width;
+    int             height;
+    int             numBands;
+    vector<double>  bandSums;
+    float           lastTime;
+    int             pressureIterations;
+    float           pressureResidual;
+    mkWorkerPool    pool;
+    mkFluidMultigrid    multigrid;
+    mkFluidConjugateGradient    conjugateGradient;
+    
+    struct Tile {
+        int             y0;
+        int             y1;
+        mkFluidField    window[2];      // its rows and the halo, 2 channels
+    };
+    vector<Tile*>   tiles;
+    vector<double>  tileSums;
+    
+    mkFluidField    velocity;           // 2 channels
+    mkFluidField    density;            // 4, rgba
+    mkFluidField    temperature;
+    mkFluidField    pressure;
+    mkFluidField    divergence;
+    mkFluidField    curl;
+    mkFluidField    confinement;        // 2
+    mkFluidField    buoyancy;           // 2
+    mkFluidField    obstacle;           // 1 in obstacles, the wall included
+    mkFluidField    combinedObstacle;   // with this frame's temporary ones
+    mkFluidField    fluid;              // 1 - combinedObstacle
+    
+    // the other half of each ping-pong pair
+    mkFluidField    velocityBack;
+    mkFluidField    velocityStart;      // before viscosity
+    mkFluidField    densityBack;
+    mkFluidField    temperatureBack;
+    mkFluidField    pressureBack;
+};
@@ -0,0 +1,142 @@
+#include "mkHandForces.h"
+
+//--------------------------------------------------------------
+mkHandForces::mkHandForces() : width(0), height(0), inputWidth(0), inputHeight(0), changed(false), hadForces(false), lastTimestamp(0) {
+    parameters.setName("hand forces");
+    parameters.add(velocityStrength.set("velocity strength", 4, 0, 20));
+    parameters.add(densityStrength.set("density strength", 1, 0, 5));
+    parameters.add(temperatureStrength.set("temperature strength", 1, 0, 5));
+    parameters.add(radius.set("radius", 0.05, 0, 0.2));
+    parameters.add(edge.set("edge", 1, 0, 4));
+    parameters.add(maxSpeed.set("max speed", 4, 0, 10));
+}
+
+//--------------------------------------------------------------
+void mkHandForces::setup(int _flowWidth, int _flowHeight, int _inputWidth, int _inputHeight) {
+    width = _flowWidth;
+    height = _flowHeight;
+    inputWidth = _inputWidth;
+    inputHeight = _inputHeight;
+    
+    velocity.assign(width * height * 2, 0);
+    density.assign(width * height * 4, 0);
+    temperature.assign(width * height, 0);
+    
+    previousHands.setup(16);
+    currentHands.setup(16);
+    
+    velocityTexture.allocate(width, height, GL_RG32F);
+    densityTexture.allocate(width, height, GL_RGBA32F);
+    temperatureTexture.allocate(width, height, GL_R32F);
+    
+    reset();
+}
+
+//--------------------------------------------------------------
+void mkHandForces::reset() {
+    std::fill(velocity.begin(), velocity.end(), 0);
+    std::fill(density.begin(), density.end(), 0);
+    std::fill(temperature.begin(), temperature.end(), 0);
+    previousHands.clear();
+    changed = false;
+    hadForces = false;
+    lastTimestamp = 0;
+}
+
+//--------------------------------------------------------------
+void mkHandForces::handEvent(mkHandEventBatch& _batch) {
+    for (int i = 0; i < _batch.events.size(); i++)
+        if (_batch.events[i].status == HAND_TRACKING_STOPPED)
+            previousHands.erase(_batch.events[i].id);
+}
+
+//--------------------------------------------------------------
+void mkHandForces::update(const vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros) {
+    
+    float deltaTime = (lastTimestamp != 0 && _timestampMicros > lastTimestamp) ? (_timestampMicros - lastTimestamp) / 1000000.0 : 0;
+    lastTimestamp = _timestampMicros;
+    
+    // only clear when the previous frame actually wrote something
+    if (hadForces) {
+        std::fill(velocity.begin(), velocity.end(), 0);
+        std::fill(density.begin(), density.end(), 0);
+        std::fill(temperature.begin(), temperature.end(), 0);
+    }
+    
+    currentHands.clear();
+    for (int i = 0; i < _hands.size(); i++) {
+        XnUserID id = _hands[i].id;
+        ofVec2f position(_hands[i].position.x / inputWidth, _hands[i].position.y / inputHeight);
+        *currentHands.insert(id) = position;
+        
+        ofVec2f handVelocity(0, 0);
+        const ofVec2f* previous = previousHands.find(id);
+        if (previous && deltaTime > 0) {
+            handVelocity.set((position.x - previous->x) / deltaTime,
+                             (position.y - previous->y) / deltaTime);
+            float speed = handVelocity.length();
+            if (speed > maxSpeed)
+                handVelocity *= maxSpeed / speed;
+        }
+        
+        // a stable colour per hand, hue from the tracker id
+        ofFloatColor color = ofFloatColor::fromHsb(fmodf(id * 0.618034f, 1.0f), 0.8, 1.0);
+        splat(position, handVelocity * velocityStrength.get(), color, temperatureStrength.get());
+    }
+    
+    changed = hadForces || !currentHands.empty();
+    hadForces = !currentHands.empty();
+    swap(previousHands, currentHands);
+}
+
+//--------------------------------------------------------------
+void mkHandForces::splat(const ofVec2f& _position, const ofVec2f& _velocity, const ofFloatColor& _color, float _temperature) {
+    
+    // radius is relative to the flow width, like the mouse draw forces
+    float r = radius.get() * width;
+    if (r <= 0)
+        return;
+    
+    float cx = _position.x * width;
+    float cy = _position.y * height;
+    int x0 = MAX(0, (int)floorf(cx - r));
+    int x1 = MIN(width - 1, (int)ceilf(cx + r));
+    int y0 = MAX(0, (int)floorf(cy - r));
+    int y1 = MIN(height - 1, (int)ceilf(cy + r));
+    
+    float invRadius = 1.0 / r;
+    float densityScale = densityStrength.get();
+    float edgePower = edge.get();
+    
+    for (int y = y0; y <= y1; y++) {
+        float dy = (y + 0.5f - cy) * invRadius;
+        for (int x = x0; x <= x1; x++) {
+            float dx = (x + 0.5f - cx) * invRadius;
+            float d = sqrtf(dx * dx + dy * dy);
+            if (d >= 1.0f)
+                continue;
+            
+            float a = 1.0f - d;
+            if (edgePower != 1.0f)
+                a = powf(a, edgePower);
+            
+            int i = y * width + x;
+            velocity[i * 2    ] += _velocity.x * a;
+            velocity[i * 2 + 1] += _velocity.y * a;
+            
+            density[i * 4    ] += _color.r * a * densityScale;
+            density[i * 4 + 1] += _color.g * a * densityScale;
+            density[i * 4 + 2] += _color.b * a * densityScale;
+            density[i * 4 + 3] += a * densityScale;
+            
+            temperature[i] += _temperature * a;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void mkHandForces::updateTextures() {
+    velocityTexture.loadData(&velocity[0], width, height, GL_RG);
+    densityTexture.loadData(&density[0], width, height, GL_RGBA);
+    temperatureTexture.loadData(&temperature[0], width, height, GL_RED);
+}
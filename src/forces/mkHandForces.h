@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkKinectFrame.h"
+#include "mkIdMap.h"
+#include "mkHandEvent.h"
+
+// Turns the tracked hands into velocity, density and temperature splats at
+// flow resolution. All hands are rasterised on the CPU into one field per
+// force type, so the fluid gets a single add call per type per frame no
+// matter how many hands are tracked.
+
+class mkHandForces {
+public:
+    mkHandForces();
+    
+    void    setup(int _flowWidth, int _flowHeight, int _inputWidth = MK_DEPTH_WIDTH, int _inputHeight = MK_DEPTH_HEIGHT);
+    
+    // CPU reference path, headless: fills the fields from one sensor frame
+    void    update(const vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros);
+    void    reset();
+    // subscriber of mkHandEventBus: an ended hand leaves no velocity for
+    // a new one under its id
+    void    handEvent(mkHandEventBatch& _batch);
+    
+    // uploads the fields, render thread only
+    void    updateTextures();
+    
+    bool    didChange() const			{ return changed; }
+    int     getWidth() const			{ return width; }
+    int     getHeight() const			{ return height; }
+    
+    const float*	getVelocity() const		{ return &velocity[0]; }	// RG
+    const float*	getDensity() const		{ return &density[0]; }		// RGBA
+    const float*	getTemperature() const	{ return &temperature[0]; }	// R
+    
+    ofTexture&	getVelocityTexture()		{ return velocityTexture; }
+    ofTexture&	getDensityTexture()			{ return densityTexture; }
+    ofTexture&	getTemperatureTexture()		{ return temperatureTexture; }
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    ofParameter<float>	velocityStrength;
+    ofParameter<float>	densityStrength;
+    ofParameter<float>	temperatureStrength;
+    ofParameter<float>	radius;
+    ofParameter<float>	edge;
+    ofParameter<float>	maxSpeed;
+    
+    void    splat(const ofVec2f& _position, const ofVec2f& _velocity, const ofFloatColor& _color, float _temperature);
+    
+    int     width;
+    int     height;
+    int     inputWidth;
+    int     inputHeight;
+    bool    changed;
+    bool    hadForces;
+    
+    XnUInt64            lastTimestamp;
+    // normalised positions by hand id
+    mkIdMap<ofVec2f>    previousHands;
+    mkIdMap<ofVec2f>    currentHands;
+    
+    vector<float>       velocity;
+    vector<float>       density;
+    vector<float>       temperature;
+    
+    ofTexture           velocityTexture;
+    ofTexture           densityTexture;
+    ofTexture           temperatureTexture;
+};
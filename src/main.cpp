@@ -1,13 +1,43 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "mkBenchmark.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+	// --benchmark runs the CPU micro benchmarks headless and exits, with 1
+	// if any of their checks failed
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--benchmark")
+			return mkRunBenchmarks() > 0 ? 1 : 0;
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
+	ofApp* app = new ofApp();
+	
+	// --replay <file> replays a depth recording instead of the live sensor,
+	// given once per device for several,
+	// --devices <n> captures from n live sensors on one stage,
+	// --fast replays it as fast as the app consumes frames, none dropped,
+	// --depth-flow takes the optical flow from depth and skips the webcam,
+	// --blobs tracks hands with the blob tracker instead of NITE
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--replay" && i + 1 < argc)
+			app->replayPaths.push_back(argv[++i]);
+		else if (arg == "--devices" && i + 1 < argc)
+			app->numDevices = ofToInt(argv[++i]);
+		else if (arg == "--fast")
+			app->replayAsFastAsPossible = true;
+		else if (arg == "--depth-flow")
+			app->useDepthFlow = true;
+		else if (arg == "--blobs")
+			app->useBlobTracker = true;
+	}
+
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(app);
 
 }
@@ -3,24 +3,16 @@
 //--------------------------------------------------------------
 void ofApp::setup(){
     
+    logChannel = make_shared<mkLogChannel>();
+    logChannel->setup(make_shared<ofConsoleLoggerChannel>());
+    ofSetLoggerChannel(logChannel);
     ofSetLogLevel(OF_LOG_VERBOSE);
     
-    openNIDevice.setup();
-    //    openNIDevice.addImageGenerator();
-    openNIDevice.addDepthGenerator();
-    openNIDevice.setRegister(true);
-    openNIDevice.setMirror(true);
-    
-    openNIDevice.addHandsGenerator();
-    
-    
-    openNIDevice.addAllHandFocusGestures();
-    
-    openNIDevice.setMaxNumHands(2);
-    
-    
-    
-    openNIDevice.start();
+    if (useBlobTracker)
+        kinects.setHandSource(MK_HANDS_BLOBS);
+    if (replayPaths.empty() || !kinects.setupReplay(replayPaths, replayAsFastAsPossible ? MK_REPLAY_AS_FAST_AS_POSSIBLE : MK_REPLAY_REALTIME))
+        kinects.setup(MIN(numDevices, MAX_DEVICES), 2);
+    kinects.start();
     
     
     ofSetVerticalSync(false);
@@ -59,8 +51,32 @@ void ofApp::setup(){
     // MOUSE DRAW
     mouseForces.setup(flowWidth, flowHeight, drawWidth, drawHeight);
     
+    // DEPTH
+    kinects.setupStage(flowWidth, flowHeight, "calibration.xml");
+    depthConvert.setup(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT, flowWidth, flowHeight);
+    depthBackground.setup(MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT, flowWidth, flowHeight);
+    if (useDepthFlow) {
+        depthConvert.setDoField(true);
+        depthFlow.setup(flowWidth, flowHeight);
+    }
+    
+    // HAND FORCES
+    handForces.setup(flowWidth, flowHeight, kinects.getInputWidth(), kinects.getInputHeight());
+    predictedHands.reserve(16);
+    gestures.setup(16);
+    gestureEvents.reserve(16);
+    handEvents.setup();
+    ofAddListener(handEvents.batchEvent, this, &ofApp::handEvent);
+    ofAddListener(handEvents.batchEvent, &handForces, &mkHandForces::handEvent);
+    ofAddListener(handEvents.batchEvent, &gestures, &mkGestureEngine::handEvent);
+    didKinectUpdate = false;
+    
+    // SHARED STATE
+    statePublisher.setup(flowWidth / 4, flowHeight / 4);
+    
     // CAMERA
-    simpleCam.initGrabber(640, 480, true);
+    if (!useDepthFlow)
+        simpleCam.initGrabber(640, 480, true);
     didCamUpdate = false;
     cameraFbo.allocate(640, 480);
     cameraFbo.clear();
@@ -76,14 +92,56 @@ void ofApp::setup(){
 //--------------------------------------------------------------
 void ofApp::update(){
     
-    openNIDevice.update();
+    // never waits for the sensor, only picks up the latest published snapshot
+    didKinectUpdate = kinects.update();
+    
+    // hand events queued by the capture threads since the last frame
+    handEvents.update(kinects);
+    if (didKinectUpdate) {
+        // the first device is drawn and, alone, feeds the depth field
+        const mkKinectFrame& frame = kinects.getDevice(0).getFrame();
+        if (frame.width == MK_DEPTH_WIDTH && frame.height == MK_DEPTH_HEIGHT) {
+            depthConvert.update(frame.pyramid);
+            depthConvert.updateTexture();
+            depthBackground.update(frame.pyramid.getLevel(0).pixels);
+            depthBackground.updateTexture();
+        }
+        
+        if (useDepthFlow) {
+            depthFlow.update(kinects.isStitched() ? kinects.getField() : depthConvert.getField());
+            if (depthFlow.didChange()) {
+                depthFlow.updateTextures();
+                // only performers add density, not the room; the stitched
+                // field already ends at the far plane of the stage
+                if (kinects.isStitched()) {
+                    kinects.updateTexture();
+                    velocityMask.setDensity(kinects.getFieldTexture());
+                }
+                else
+                    velocityMask.setDensity(depthBackground.getMaskTexture());
+                velocityMask.setVelocity(depthFlow.getOpticalFlow());
+                velocityMask.update();
+            }
+        }
+        
+        // splats land where the hands are now, not where the sensor saw them
+        kinects.predictHands(ofGetElapsedTimeMicros(), predictedHands);
+        handForces.update(predictedHands, frame.sensorTimestamp);
+        if (handForces.didChange())
+            handForces.updateTextures();
+        
+        gestures.update(predictedHands, ofGetElapsedTimeMicros(), gestureEvents);
+        for (int i = 0; i < gestureEvents.size(); i++)
+            gestureEvent(gestureEvents[i]);
+    }
     
     deltaTime = ofGetElapsedTimef() - lastTime;
     lastTime = ofGetElapsedTimef();
     
-    simpleCam.update();
+    if (!useDepthFlow)
+        simpleCam.update();
     
-    if (simpleCam.isFrameNew()) {
+    if (!useDepthFlow && simpleCam.isFrameNew()) {
         ofPushStyle();
         ofEnableBlendMode(OF_BLENDMODE_DISABLED);
         cameraFbo.begin();
@@ -103,10 +161,18 @@ void ofApp::update(){
         velocityMask.update();
     }
     
-    fluidSimulation.addVelocity(opticalFlow.getOpticalFlowDecay());
+    fluidSimulation.addVelocity(getOpticalFlowDecay());
     fluidSimulation.addDensity(velocityMask.getColorMask());
     fluidSimulation.addTemperature(velocityMask.getLuminanceMask());
     
+    // all hands in one add per force type
+    if (didKinectUpdate && handForces.didChange()) {
+        fluidSimulation.addVelocity(handForces.getVelocityTexture());
+        fluidSimulation.addDensity(handForces.getDensityTexture());
+        fluidSimulation.addTemperature(handForces.getTemperatureTexture());
+        particleFlow.addFlowVelocity(handForces.getVelocityTexture());
+    }
+    
     mouseForces.update(deltaTime);
     
     for (int i=0; i<mouseForces.getNumForces(); i++) {
@@ -138,12 +204,14 @@ void ofApp::update(){
     if (particleFlow.isActive()) {
         particleFlow.setSpeed(fluidSimulation.getSpeed());
         particleFlow.setCellSize(fluidSimulation.getCellSize());
-        particleFlow.addFlowVelocity(opticalFlow.getOpticalFlow());
+        particleFlow.addFlowVelocity(getOpticalFlow());
         particleFlow.addFluidVelocity(fluidSimulation.getVelocity());
         //particleFlow.addDensity(fluidSimulation.getDensity());
         particleFlow.setObstacle(fluidSimulation.getObstacle());
     }
     particleFlow.update();
+    
+    statePublisher.publish(predictedHands, kinects.getInputWidth(), kinects.getInputHeight(), kinects.getNumDevices(), fluidSimulation.getVelocity(), fluidSimulation.getDensity(), ofGetElapsedTimeMicros());
 
 }
 
@@ -155,29 +223,28 @@ void ofApp::draw(){
     ofPushMatrix();
    
     
-    // draw debug (ie., image, depth, skeleton)
-    openNIDevice.drawDebug(0, 0, ofGetWidth(), ofGetHeight());
+    // draw debug (ie., depth)
+    depthConvert.getTexture().draw(0, 0, ofGetWidth(), ofGetHeight());
     ofPopMatrix();
     
 
-    // get number of current hands
-    int numHands = openNIDevice.getNumTrackedHands();
+    // hands of the latest snapshots from the capture threads, predicted
+    const vector<mkTrackedHand>& hands = predictedHands;
+    float handScaleX = ofGetWidth() / (float)kinects.getInputWidth();
+    float handScaleY = ofGetHeight() / (float)kinects.getInputHeight();
     
     // iterate through users
-    for (int i = 0; i < numHands; i++){
-        
-        // get a reference to this user
-        ofxOpenNIHand & hand = openNIDevice.getTrackedHand(i);
+    for (int i = 0; i < hands.size(); i++){
         
         // get hand position
-        ofPoint & handPosition = hand.getPosition();
+        const ofPoint & handPosition = hands[i].position;
         // do something with the positions like:
         
         
         
         // draw a rect at the position (don't confuse this with the debug draw which shows circles!!)
         ofSetColor(255);
-        ofCircle(handPosition.x, handPosition.y, 20);
+        ofCircle(handPosition.x * handScaleX, handPosition.y * handScaleY, 20);
         
        
         
@@ -570,18 +637,67 @@ void ofApp::drawMouseForces(int _x, int _y, int _width, int _height) {
 }
 
 //-------------------------------------------------------------
-void ofApp::handEvent(ofxOpenNIHandEvent & event){
-    // show hand event messages in the console
-    ofLogNotice() << getHandStatusAsString(event.handStatus) << "for hand" << event.id << "from device" << event.deviceID;
+void ofApp::handEvent(mkHandEventBatch & batch){
+    // show hands coming and going in the console, updates only verbose
+    for (int i = 0; i < batch.events.size(); i++) {
+        const mkHandEvent& event = batch.events[i];
+        if (event.status == HAND_TRACKING_UPDATED)
+            continue;
+        ofLogNotice("ofApp") << getHandStatusAsString(event.status) << " for hand " << event.id << " from device " << event.deviceIndex;
+    }
+    ofLogVerbose("ofApp") << batch.events.size() << " hand events in batch " << batch.frameIndex;
+}
+
+//--------------------------------------------------------------
+void ofApp::gestureEvent(const mkGestureEvent & event){
+    ofLogNotice("ofApp") << mkGestureEngine::getGestureName(event.type) << " by hand " << event.id;
+    switch (event.type) {
+        // a deliberate gesture wipes the canvas, as 'R' did
+        case MK_GESTURE_CIRCLE:
+            fluidSimulation.reset();
+            mouseForces.reset();
+            handForces.reset();
+            break;
+        default: break;
+    }
 }
 
 //--------------------------------------------------------------
 void ofApp::exit(){
-    openNIDevice.stop();
+    ofRemoveListener(handEvents.batchEvent, this, &ofApp::handEvent);
+    ofRemoveListener(handEvents.batchEvent, &handForces, &mkHandForces::handEvent);
+    ofRemoveListener(handEvents.batchEvent, &gestures, &mkGestureEngine::handEvent);
+    kinects.stop();
+    
+    // whatever is logged from here on goes straight to the console
+    ofSetLoggerChannel(make_shared<ofConsoleLoggerChannel>());
+    logChannel->close();
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
+    switch (key) {
+        case 'k':
+        case 'K':
+            if (kinects.isRecording())
+                kinects.stopRecording();
+            else
+                kinects.startRecording("kinect_" + ofGetTimestampString());
+            break;
+        case 'b':
+        case 'B': depthBackground.reset(); break;
+        case 'h':
+        case 'H': {
+            mkHandFilterMode mode = (mkHandFilterMode)((kinects.getDevice(0).getHandFilterMode() + 1) % MK_HAND_FILTER_NUM_MODES);
+            for (int i = 0; i < kinects.getNumDevices(); i++)
+                kinects.getDevice(i).setHandFilterMode(mode);
+            ofLogNotice("ofApp") << "hand filter: " << mkHandFilter::getModeName(mode);
+            break;
+        }
+            
+        default: break;
+    }
+    
 //    switch (key) {
 //        case 'G':
 //        case 'g': toggleGuiDraw = !toggleGuiDraw; break;
@@ -4,6 +4,15 @@
 #include "ofxOpenNI.h"
 #include "ofxGui.h"
 #include "ofxFlowTools.h"
+#include "mkMultiCapture.h"
+#include "mkHandForces.h"
+#include "mkDepthConvert.h"
+#include "mkDepthFlow.h"
+#include "mkDepthBackground.h"
+#include "mkStatePublisher.h"
+#include "mkGestureEngine.h"
+#include "mkHandEventBus.h"
+#include "mkLogChannel.h"
 
 #define MAX_DEVICES 2
 
@@ -34,6 +43,8 @@ enum drawModeEnum{
 class ofApp : public ofBaseApp{
 
 	public:
+        ofApp() : numDevices(1), replayAsFastAsPossible(false), useBlobTracker(false), useDepthFlow(false) {}
+    
 		void setup();
 		void update();
 		void draw();
@@ -53,12 +64,39 @@ class ofApp : public ofBaseApp{
     
 
     
+    // Kinect
+    mkMultiCapture		kinects;
+    int					numDevices;				// live sensors, at most MAX_DEVICES
+    vector<string>		replayPaths;			// replay recordings, one per device, instead of the live sensors
+    bool				replayAsFastAsPossible;
+    bool				useBlobTracker;			// hands from depth blobs, no focus gesture or hand limit
+    bool				didKinectUpdate;
+    vector<mkTrackedHand>	predictedHands;		// filtered hands moved forward to the frame time
+    mkHandEventBus		handEvents;				// begin, update and end of hands, one batch per frame
+    mkGestureEngine		gestures;
+    vector<mkGestureEvent>	gestureEvents;
+    mkHandForces		handForces;
+    mkDepthConvert		depthConvert;
+    mkDepthBackground	depthBackground;		// foreground mask, density source for the depth flow
+    
+    // Depth flow, replaces the camera and its optical flow when enabled
+    bool				useDepthFlow;
+    mkDepthFlow			depthFlow;
+    ofTexture&			getOpticalFlow()		{ return useDepthFlow ? depthFlow.getOpticalFlow() : opticalFlow.getOpticalFlow(); }
+    ofTexture&			getOpticalFlowDecay()	{ return useDepthFlow ? depthFlow.getOpticalFlowDecay() : opticalFlow.getOpticalFlowDecay(); }
+    
+    // Hands and fluid for the sound and lighting processes
+    mkStatePublisher	statePublisher;
+    
     // Camera
     ofVideoGrabber		simpleCam;
     bool				didCamUpdate;
     ftFbo				cameraFbo;
     ofParameter<bool>	doFlipCamera;
     
+    // Logging, written to the console by a thread of its own
+    shared_ptr<mkLogChannel>	logChannel;
+    
     // Time
     float				lastTime;
     float				deltaTime;
@@ -152,10 +190,7 @@ class ofApp : public ofBaseApp{
     
 private:
     
-    void handEvent(ofxOpenNIHandEvent & event);
-    
-    ofxOpenNI openNIDevice;
-    
-    int numHands = openNIDevice.getNumTrackedHands();
+    void handEvent(mkHandEventBatch & batch);
+    void gestureEvent(const mkGestureEvent & event);
 		
 };
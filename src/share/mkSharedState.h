@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Layout of the shared memory segment the app publishes every frame for
+// other processes, sound and lighting, on the same machine. This header
+// only needs the standard library so those processes can include it as is.
+//
+// The segment is one mkSharedState, protected by a sequence lock: the app
+// makes the sequence odd, writes the frame and makes it even again. Readers
+// never lock and never wait for the app. They read the parts they need
+// straight from the segment between beginRead() and retryRead(), and
+// discard what they read if the frame changed meanwhile:
+//
+//     uint32_t sequence;
+//     do {
+//         sequence = state->beginRead();
+//         numHands = state->frame.numHands;
+//         ...
+//     } while (state->retryRead(sequence));
+//
+// beginRead() returns an odd sequence while a frame is being written,
+// retryRead() always fails for it, so a reader retries until the app is
+// done. Values read before retryRead() succeeds may be torn and are only
+// to be used afterwards.
+//
+// The segment outlives the app, readers keep their mapping across a
+// restart. A reader checks isCompatible() before it trusts the layout.
+
+#define MK_SHARED_STATE_NAME        "marblingKinectState"
+#define MK_SHARED_STATE_MAGIC       0x53534b4d      // "MKSS"
+#define MK_SHARED_STATE_VERSION     1
+#define MK_SHARED_MAX_HANDS         32
+#define MK_SHARED_MAX_FIELD_WIDTH   64
+#define MK_SHARED_MAX_FIELD_HEIGHT  64
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the shared sequence must be lock-free to work across processes");
+
+enum mkSharedSessionState {
+    MK_SESSION_IDLE = 0,        // nobody in front of the sensors
+    MK_SESSION_TRACKING         // at least one hand is tracked
+};
+
+struct mkSharedHand {
+    uint32_t    id;                 // unique over all devices
+    float       position[2];        // interaction field, 0 to 1, left to right and top to bottom
+    float       worldPosition[3];   // stage mm, predicted to timeMicros
+    float       worldVelocity[3];   // mm/s
+};
+
+struct mkSharedFrame {
+    uint64_t    frameIndex;         // counts published frames, starts at 1
+    uint64_t    timeMicros;         // app clock, microseconds since the app started
+    uint32_t    sessionState;       // mkSharedSessionState
+    uint32_t    numDevices;
+    uint64_t    sessionStartMicros; // when the current session state began
+    
+    uint32_t    numHands;
+    mkSharedHand    hands[MK_SHARED_MAX_HANDS];
+    
+    // the fluid, downsampled; rows top to bottom, row length fieldWidth
+    uint32_t    fieldWidth;
+    uint32_t    fieldHeight;
+    float       velocity[MK_SHARED_MAX_FIELD_WIDTH * MK_SHARED_MAX_FIELD_HEIGHT * 2];  // x, y as the fluid simulation keeps them
+    float       density[MK_SHARED_MAX_FIELD_WIDTH * MK_SHARED_MAX_FIELD_HEIGHT * 4];   // r, g, b, a
+};
+
+struct mkSharedState {
+    // written once, before the first frame
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    size;               // sizeof(mkSharedState) of the app
+    char        pad0[64 - 3 * sizeof(uint32_t)];
+    
+    std::atomic<uint32_t>   sequence;
+    char        pad1[64 - sizeof(std::atomic<uint32_t>)];
+    
+    mkSharedFrame   frame;
+    
+    bool        isCompatible() const {
+        return magic == MK_SHARED_STATE_MAGIC && version == MK_SHARED_STATE_VERSION && size == sizeof(mkSharedState);
+    }
+    
+    // readers
+    uint32_t    beginRead() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+    bool        retryRead(uint32_t _sequence) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (_sequence & 1) || sequence.load(std::memory_order_relaxed) != _sequence;
+    }
+    
+    // the writer; a sequence left odd by a crash is closed by the next write
+    uint32_t    beginWrite() {
+        uint32_t odd = sequence.load(std::memory_order_relaxed) | 1;
+        sequence.store(odd, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return odd;
+    }
+    void        endWrite(uint32_t _odd) {
+        sequence.store(_odd + 1, std::memory_order_release);
+    }
+};
@@ -0,0 +1,121 @@
+#include "mkStatePublisher.h"
+
+//--------------------------------------------------------------
+mkStatePublisher::mkStatePublisher() : state(NULL), fieldWidth(0), fieldHeight(0), bufferIndex(0), numCopiedBuffers(0), frameIndex(0), sessionState(MK_SESSION_IDLE), sessionStartMicros(0), lastHandMicros(0) {
+    parameters.setName("state publisher");
+    parameters.add(idleDelay.set("idle delay", 2000, 0, 10000));	// ms without hands before the session ends
+}
+
+//--------------------------------------------------------------
+bool mkStatePublisher::setup(int _fieldWidth, int _fieldHeight, const string& _name) {
+    state = NULL;
+    fieldWidth = MIN(_fieldWidth, MK_SHARED_MAX_FIELD_WIDTH);
+    fieldHeight = MIN(_fieldHeight, MK_SHARED_MAX_FIELD_HEIGHT);
+    
+    velocityFbo.allocate(fieldWidth, fieldHeight, GL_RG32F);
+    densityFbo.allocate(fieldWidth, fieldHeight, GL_RGBA32F);
+    for (int i = 0; i < 2; i++) {
+        velocityBuffers[i].allocate(fieldWidth * fieldHeight * 2 * sizeof(float), GL_STREAM_READ);
+        densityBuffers[i].allocate(fieldWidth * fieldHeight * 4 * sizeof(float), GL_STREAM_READ);
+    }
+    bufferIndex = 0;
+    numCopiedBuffers = 0;
+    
+    if (!memory.create(_name, sizeof(mkSharedState)))
+        return false;
+    state = (mkSharedState*)memory.getWritableData();
+    
+    // readers of a previous run see the new layout only once it is complete
+    uint32_t sequence = state->beginWrite();
+    state->magic = 0;
+    state->version = MK_SHARED_STATE_VERSION;
+    state->size = sizeof(mkSharedState);
+    memset(&state->frame, 0, sizeof(mkSharedFrame));
+    state->frame.fieldWidth = fieldWidth;
+    state->frame.fieldHeight = fieldHeight;
+    state->magic = MK_SHARED_STATE_MAGIC;
+    state->endWrite(sequence);
+    
+    ofLogNotice("mkStatePublisher") << "publishing " << sizeof(mkSharedState) << " bytes as " << _name;
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkStatePublisher::publish(const vector<mkTrackedHand>& _hands, int _inputWidth, int _inputHeight, int _numDevices, ofTexture& _velocity, ofTexture& _density, unsigned long long _nowMicros) {
+    if (state == NULL)
+        return;
+    
+    // start this frame's copy, it is mapped on the next one
+    ofPushStyle();
+    ofEnableBlendMode(OF_BLENDMODE_DISABLED);
+    velocityFbo.begin();
+    _velocity.draw(0, 0, fieldWidth, fieldHeight);
+    velocityFbo.end();
+    densityFbo.begin();
+    _density.draw(0, 0, fieldWidth, fieldHeight);
+    densityFbo.end();
+    ofPopStyle();
+    velocityFbo.getTextureReference().copyTo(velocityBuffers[bufferIndex]);
+    densityFbo.getTextureReference().copyTo(densityBuffers[bufferIndex]);
+    numCopiedBuffers++;
+    bufferIndex ^= 1;
+    
+    updateSession(_hands.size(), _nowMicros);
+    
+    mkSharedFrame& frame = state->frame;
+    uint32_t sequence = state->beginWrite();
+    frame.frameIndex = ++frameIndex;
+    frame.timeMicros = _nowMicros;
+    frame.sessionState = sessionState;
+    frame.sessionStartMicros = sessionStartMicros;
+    frame.numDevices = _numDevices;
+    writeHands(frame, _hands, _inputWidth, _inputHeight);
+    
+    // bufferIndex now points at the copy of the previous frame
+    if (numCopiedBuffers > 1) {
+        const float* velocity = velocityBuffers[bufferIndex].map<float>(GL_READ_ONLY);
+        if (velocity != NULL)
+            memcpy(frame.velocity, velocity, fieldWidth * fieldHeight * 2 * sizeof(float));
+        velocityBuffers[bufferIndex].unmap();
+        const float* density = densityBuffers[bufferIndex].map<float>(GL_READ_ONLY);
+        if (density != NULL)
+            memcpy(frame.density, density, fieldWidth * fieldHeight * 4 * sizeof(float));
+        densityBuffers[bufferIndex].unmap();
+    }
+    state->endWrite(sequence);
+}
+
+//--------------------------------------------------------------
+void mkStatePublisher::writeHands(mkSharedFrame& _frame, const vector<mkTrackedHand>& _hands, int _inputWidth, int _inputHeight) {
+    int numHands = MIN((int)_hands.size(), MK_SHARED_MAX_HANDS);
+    float scaleX = 1.0f / _inputWidth;
+    float scaleY = 1.0f / _inputHeight;
+    for (int i = 0; i < numHands; i++) {
+        const mkTrackedHand& hand = _hands[i];
+        mkSharedHand& shared = _frame.hands[i];
+        shared.id = hand.id;
+        shared.position[0] = hand.position.x * scaleX;
+        shared.position[1] = hand.position.y * scaleY;
+        for (int a = 0; a < 3; a++) {
+            shared.worldPosition[a] = hand.worldPosition[a];
+            shared.worldVelocity[a] = hand.worldVelocity[a];
+        }
+    }
+    _frame.numHands = numHands;
+}
+
+//--------------------------------------------------------------
+void mkStatePublisher::updateSession(int _numHands, unsigned long long _nowMicros) {
+    if (_numHands > 0) {
+        lastHandMicros = _nowMicros;
+        if (sessionState != MK_SESSION_TRACKING) {
+            sessionState = MK_SESSION_TRACKING;
+            sessionStartMicros = _nowMicros;
+        }
+    }
+    // a hand lost for a moment does not end the session
+    else if (sessionState == MK_SESSION_TRACKING && _nowMicros - lastHandMicros > idleDelay.get() * 1000) {
+        sessionState = MK_SESSION_IDLE;
+        sessionStartMicros = _nowMicros;
+    }
+}
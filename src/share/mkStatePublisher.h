@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxFlowTools.h"
+#include "mkKinectFrame.h"
+#include "mkSharedMemory.h"
+#include "mkSharedState.h"
+
+// Publishes the hands, the session state and a downsampled fluid velocity
+// and density into the shared state segment once per frame, for readers in
+// other processes (see mkSharedState.h).
+//
+// The fluid lives on the GPU. Every frame its fields are drawn into small
+// fbos and copied into pixel buffers without waiting; the buffers copied
+// the frame before are mapped and written out, so the published field is
+// one frame older than the hands, and the render thread never stalls on a
+// readback.
+
+class mkStatePublisher {
+public:
+    mkStatePublisher();
+    
+    bool    setup(int _fieldWidth, int _fieldHeight, const string& _name = MK_SHARED_STATE_NAME);
+    bool    isPublishing() const			{ return state != NULL; }
+    
+    // render thread, after the fluid update; hands are in input pixels
+    void    publish(const vector<mkTrackedHand>& _hands, int _inputWidth, int _inputHeight, int _numDevices, ofTexture& _velocity, ofTexture& _density, unsigned long long _nowMicros);
+    
+    unsigned long long	getFrameIndex() const	{ return frameIndex; }
+    
+    ofParameterGroup	parameters;
+    
+    // writes the hands into a frame that is being written, at most
+    // MK_SHARED_MAX_HANDS, positions normalized to the input size
+    static void writeHands(mkSharedFrame& _frame, const vector<mkTrackedHand>& _hands, int _inputWidth, int _inputHeight);
+    
+protected:
+    ofParameter<float>	idleDelay;
+    
+    void    updateSession(int _numHands, unsigned long long _nowMicros);
+    
+    mkSharedMemory      memory;
+    mkSharedState*      state;
+    
+    int                 fieldWidth;
+    int                 fieldHeight;
+    flowTools::ftFbo    velocityFbo;
+    flowTools::ftFbo    densityFbo;
+    ofBufferObject      velocityBuffers[2];
+    ofBufferObject      densityBuffers[2];
+    int                 bufferIndex;
+    int                 numCopiedBuffers;
+    
+    unsigned long long  frameIndex;
+    mkSharedSessionState    sessionState;
+    unsigned long long  sessionStartMicros;
+    unsigned long long  lastHandMicros;
+};
@@ -0,0 +1,253 @@
+#include "mkBlobTracker.h"
+
+// 1/4 resolution
+#define MK_BLOB_LEVEL 2
+#define MK_BLOB_DOWNSAMPLE (1 << MK_BLOB_LEVEL)
+
+//--------------------------------------------------------------
+mkBlobTracker::mkBlobTracker() : depthWidth(0), depthHeight(0), width(0), height(0), maxBlobs(0), maxTracks(0), nearest(NULL), nextID(1), lastMicros(0), maxMicros(0), averageMicros(0) {
+    parameters.setName("blob tracker");
+    parameters.add(nearClip.set("near", 500, 0, 10000));
+    parameters.add(farClip.set("far", 2500, 0, 10000));
+    parameters.add(depthStep.set("depth step", 60, 10, 500));		// mm between connected neighbours
+    parameters.add(frontDepth.set("front depth", 100, 10, 500));	// mm behind the nearest point
+    parameters.add(minArea.set("min area", 30, 1, 1000));			// tracking pixels
+    parameters.add(maxDistance.set("max distance", 80, 1, 640));	// depth pixels per frame
+    parameters.add(maxMissed.set("max missed", 5, 0, 60));
+    parameters.add(minAge.set("min age", 2, 1, 30));
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::setup(int _depthWidth, int _depthHeight, int _maxBlobs) {
+    depthWidth = _depthWidth;
+    depthHeight = _depthHeight;
+    width = depthWidth / MK_BLOB_DOWNSAMPLE;
+    height = depthHeight / MK_BLOB_DOWNSAMPLE;
+    maxBlobs = _maxBlobs;
+    
+    // neighbours further apart than a step do not join, so on depth that
+    // changes from pixel to pixel every pixel starts a label; 0 is background
+    int maxLabels = width * height + 1;
+    labels.assign(width * height, 0);
+    parents.assign(maxLabels, 0);
+    stats.assign(maxLabels, blobStats());
+    
+    blobs.reserve(maxLabels);
+    maxTracks = maxBlobs * 2;
+    tracks.reserve(maxTracks);
+    matches.reserve(maxBlobs * maxBlobs * 2);
+    blobMatched.reserve(maxLabels);
+    
+    reset();
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::reset() {
+    blobs.clear();
+    tracks.clear();
+    nextID = 1;
+    lastMicros = 0;
+    maxMicros = 0;
+    averageMicros = 0;
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::update(const mkDepthPyramid& _pyramid, vector<mkTrackedHand>& _hands) {
+    _hands.clear();
+    mkDepthView view = _pyramid.getLevel(MK_BLOB_LEVEL, MK_DEPTH_NEAREST);
+    if (!view.isValid() || view.width != width || view.height != height)
+        return;
+    
+    unsigned long long start = ofGetElapsedTimeMicros();
+    
+    nearest = view.pixels;
+    measure(label());
+    assign();
+    
+    for (int i = 0; i < tracks.size(); i++) {
+        if (tracks[i].missed > 0 || tracks[i].age < minAge.get())
+            continue;
+        mkTrackedHand hand;
+        hand.id = tracks[i].id;
+        hand.position = tracks[i].position;
+        _hands.push_back(hand);
+    }
+    
+    lastMicros = ofGetElapsedTimeMicros() - start;
+    maxMicros = MAX(maxMicros, lastMicros);
+    averageMicros = (averageMicros == 0) ? lastMicros : averageMicros * 0.95 + lastMicros * 0.05;
+}
+
+//--------------------------------------------------------------
+int mkBlobTracker::find(int _label) {
+    int root = _label;
+    while (parents[root] != root)
+        root = parents[root];
+    while (parents[_label] != root) {
+        int next = parents[_label];
+        parents[_label] = root;
+        _label = next;
+    }
+    return root;
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::unite(int _a, int _b) {
+    // the smaller label is always the root, measure() relies on it
+    _a = find(_a);
+    _b = find(_b);
+    if (_a < _b)
+        parents[_b] = _a;
+    else if (_b < _a)
+        parents[_a] = _b;
+}
+
+//--------------------------------------------------------------
+int mkBlobTracker::label() {
+    const int nearValue = nearClip.get();
+    const int farValue = farClip.get();
+    const int step = depthStep.get();
+    int numLabels = 1;  // 0 is background
+    
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int i = y * width + x;
+            int d = nearest[i];
+            if (d == XN_DEPTH_NO_SAMPLE_VALUE || d < nearValue || d > farValue) {
+                labels[i] = 0;
+                continue;
+            }
+            
+            int left = (x > 0 && labels[i - 1] && abs(nearest[i - 1] - d) <= step) ? labels[i - 1] : 0;
+            int up = (y > 0 && labels[i - width] && abs(nearest[i - width] - d) <= step) ? labels[i - width] : 0;
+            
+            int l;
+            if (left == 0 && up == 0) {
+                l = numLabels++;
+                parents[l] = l;
+                blobStats& s = stats[l];
+                s.count = 0;
+                s.frontCount = s.frontSumX = s.frontSumY = s.frontSumDepth = 0;
+                s.minDepth = d;
+            }
+            else {
+                l = left ? left : up;
+                if (left && up && left != up)
+                    unite(left, up);
+            }
+            
+            labels[i] = l;
+            blobStats& s = stats[l];
+            s.count++;
+            s.minDepth = MIN(s.minDepth, d);
+        }
+    }
+    return numLabels;
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::measure(int _numLabels) {
+    // parents always point to smaller labels, so going down folds every
+    // label into its parent after all of its own children were folded in
+    for (int l = _numLabels - 1; l > 0; l--) {
+        int p = parents[l];
+        if (p == l)
+            continue;
+        blobStats& s = stats[p];
+        s.count += stats[l].count;
+        s.minDepth = MIN(s.minDepth, stats[l].minDepth);
+    }
+    // and going up resolves every label to its root in one step
+    for (int l = 1; l < _numLabels; l++)
+        parents[l] = parents[parents[l]];
+    
+    // the front of each blob, the pixels just behind its nearest point
+    const int front = frontDepth.get();
+    const int area = minArea.get();
+    for (int i = 0; i < width * height; i++) {
+        if (labels[i] == 0)
+            continue;
+        blobStats& s = stats[parents[labels[i]]];
+        if (s.count < area || nearest[i] > s.minDepth + front)
+            continue;
+        s.frontCount++;
+        s.frontSumX += i % width;
+        s.frontSumY += i / width;
+        s.frontSumDepth += nearest[i];
+    }
+    
+    blobs.clear();
+    const float scale = MK_BLOB_DOWNSAMPLE;
+    const float offset = MK_BLOB_DOWNSAMPLE * 0.5;
+    for (int l = 1; l < _numLabels; l++) {
+        const blobStats& s = stats[l];
+        if (parents[l] != l || s.count < area || s.frontCount == 0)
+            continue;
+        blob b;
+        b.position.set((float)s.frontSumX / s.frontCount * scale + offset, (float)s.frontSumY / s.frontCount * scale + offset,
+                       (float)s.frontSumDepth / s.frontCount);
+        b.area = s.count;
+        blobs.push_back(b);
+    }
+    
+    // keep the nearest ones
+    if (blobs.size() > maxBlobs) {
+        std::partial_sort(blobs.begin(), blobs.begin() + maxBlobs, blobs.end(),
+                          [](const blob& _a, const blob& _b) { return _a.position.z < _b.position.z; });
+        blobs.resize(maxBlobs);
+    }
+}
+
+//--------------------------------------------------------------
+void mkBlobTracker::assign() {
+    // greedy: closest pairs first, each track and blob used once
+    const float maxDistanceSquared = maxDistance.get() * maxDistance.get();
+    matches.clear();
+    for (int t = 0; t < tracks.size(); t++) {
+        for (int b = 0; b < blobs.size(); b++) {
+            float dx = tracks[t].position.x - blobs[b].position.x;
+            float dy = tracks[t].position.y - blobs[b].position.y;
+            float distance = dx * dx + dy * dy;
+            if (distance <= maxDistanceSquared) {
+                match m = { distance, t, b };
+                matches.push_back(m);
+            }
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    
+    for (int t = 0; t < tracks.size(); t++)
+        tracks[t].missed++;
+    blobMatched.assign(blobs.size(), false);
+    
+    for (int i = 0; i < matches.size(); i++) {
+        track& t = tracks[matches[i].track];
+        if (t.missed == 0 || blobMatched[matches[i].blob])
+            continue;
+        t.position = blobs[matches[i].blob].position;
+        t.missed = 0;
+        t.age++;
+        blobMatched[matches[i].blob] = true;
+    }
+    
+    // drop tracks that were gone for too long
+    int numTracks = 0;
+    for (int t = 0; t < tracks.size(); t++) {
+        if (tracks[t].missed <= maxMissed.get())
+            tracks[numTracks++] = tracks[t];
+    }
+    tracks.resize(numTracks);
+    
+    for (int b = 0; b < blobs.size() && tracks.size() < maxTracks; b++) {
+        if (blobMatched[b])
+            continue;
+        track t;
+        t.id = nextID++;
+        if (nextID == 0)
+            nextID = 1;
+        t.position = blobs[b].position;
+        t.age = 1;
+        t.missed = 0;
+        tracks.push_back(t);
+    }
+}
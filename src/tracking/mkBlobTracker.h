@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkDepthPyramid.h"
+
+// Finds the nearest blobs in the depth image and keeps ids on them across
+// frames, a gesture free alternative to NITE hand tracking that picks up
+// anyone who reaches into the interaction zone and has no hand limit.
+//
+// It works on the nearest sample level of the depth pyramid at 1/4
+// resolution. Pixels inside the zone are labelled in a single raster pass
+// with a union-find: neighbours join when their depths are within a step of
+// each other, so people standing at different distances stay apart. The reported
+// point of a blob is the centre of its front, the pixels close to its nearest
+// depth, which is where a reaching hand is. Blobs are matched to the tracks
+// of the previous frame greedily by distance.
+//
+// All storage is reserved in setup(); update() does not allocate.
+
+class mkBlobTracker {
+public:
+    mkBlobTracker();
+    
+    void    setup(int _depthWidth, int _depthHeight, int _maxBlobs = 16);
+    void    reset();
+    
+    // _hands gets one entry per visible track, projective positions only
+    void    update(const mkDepthPyramid& _pyramid, vector<mkTrackedHand>& _hands);
+    
+    int     getNumBlobs() const					{ return blobs.size(); }
+    int     getNumTracks() const				{ return tracks.size(); }
+    int     getMaxBlobs() const					{ return maxBlobs; }
+    
+    unsigned long long	getLastMicros() const		{ return lastMicros; }
+    unsigned long long	getMaxMicros() const		{ return maxMicros; }
+    float				getAverageMicros() const	{ return averageMicros; }
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    struct blobStats {
+        int         count;
+        int         minDepth;
+        int         frontCount;
+        int         frontSumX;
+        int         frontSumY;
+        int         frontSumDepth;
+    };
+    
+    struct blob {
+        ofPoint     position;       // centre of the front, depth pixels and mm
+        int         area;           // tracking pixels
+    };
+    
+    struct track {
+        XnUserID    id;
+        ofPoint     position;
+        int         age;
+        int         missed;
+    };
+    
+    struct match {
+        float       distance;
+        int         track;
+        int         blob;
+        bool operator<(const match& _other) const { return distance < _other.distance; }
+    };
+    
+    int     label();
+    void    measure(int _numLabels);
+    void    assign();
+    
+    int     find(int _label);
+    void    unite(int _a, int _b);
+    
+    ofParameter<int>	nearClip;
+    ofParameter<int>	farClip;
+    ofParameter<int>	depthStep;
+    ofParameter<int>	frontDepth;
+    ofParameter<int>	minArea;
+    ofParameter<float>	maxDistance;
+    ofParameter<int>	maxMissed;
+    ofParameter<int>	minAge;
+    
+    int     depthWidth;
+    int     depthHeight;
+    int     width;
+    int     height;
+    int     maxBlobs;
+    int     maxTracks;      // visible and missing ones
+    
+    const XnDepthPixel*     nearest;    // pyramid level of the current frame
+    vector<int>             labels;
+    vector<int>             parents;
+    vector<blobStats>       stats;
+    vector<blob>            blobs;
+    vector<track>           tracks;
+    vector<match>           matches;
+    vector<bool>            blobMatched;
+    
+    XnUserID                nextID;
+    unsigned long long      lastMicros;
+    unsigned long long      maxMicros;
+    float                   averageMicros;
+};
@@ -0,0 +1,270 @@
+#include "mkGestureEngine.h"
+
+// frames a hand may be missing before its trajectory is dropped
+#define MK_GESTURE_MAX_MISSED 10
+// a longer gap starts the trajectory over, as after a replay loops
+#define MK_GESTURE_MAX_GAP 250000
+// the fewest samples a circle is judged on
+#define MK_GESTURE_MIN_CIRCLE_SAMPLES 12
+// mm, shorter steps do not turn a circle
+#define MK_GESTURE_MIN_STEP 2
+// path length over distance of a push or swipe
+#define MK_GESTURE_MAX_CURVE 1.3f
+// the last step of a swipe over its average step
+#define MK_GESTURE_SWIPE_END 0.5f
+
+static_assert((MK_GESTURE_HISTORY & (MK_GESTURE_HISTORY - 1)) == 0, "MK_GESTURE_HISTORY must be a power of two");
+
+//--------------------------------------------------------------
+mkGestureEngine::mkGestureEngine() {
+    parameters.setName("gestures");
+    parameters.add(pushDistance.set("push distance", 120, 20, 500));			// mm towards the sensor
+    parameters.add(pushDuration.set("push duration", 350, 50, 1000));			// ms
+    parameters.add(swipeDistance.set("swipe distance", 250, 50, 1000));		// mm
+    parameters.add(swipeDuration.set("swipe duration", 500, 50, 1000));		// ms
+    parameters.add(circleRadius.set("circle radius", 60, 10, 500));			// mm, smallest
+    parameters.add(circleRoundness.set("circle roundness", 0.35, 0.05, 1));	// radius deviation over radius
+    parameters.add(circleDuration.set("circle duration", 2000, 500, 2000));	// ms, longest, at most the history
+    parameters.add(holdRadius.set("hold radius", 20, 5, 100));				// mm
+    parameters.add(holdDuration.set("hold duration", 1000, 200, 2000));		// ms
+}
+
+//--------------------------------------------------------------
+void mkGestureEngine::setup(int _maxNumHands) {
+    // missed hands linger next to the visible ones
+    trajectories.setup(_maxNumHands * 2);
+}
+
+//--------------------------------------------------------------
+void mkGestureEngine::reset() {
+    trajectories.clear();
+}
+
+//--------------------------------------------------------------
+void mkGestureEngine::trajectory::add(XnUInt64 _timestamp, const ofPoint& _position) {
+    samples[head].timestamp = _timestamp;
+    samples[head].position = _position;
+    head = (head + 1) & (MK_GESTURE_HISTORY - 1);
+    count = MIN(count + 1, MK_GESTURE_HISTORY);
+}
+
+//--------------------------------------------------------------
+void mkGestureEngine::update(const vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros, vector<mkGestureEvent>& _events) {
+    _events.clear();
+    
+    for (int i = 0; i < trajectories.getCapacity(); i++)
+        if (trajectories.isUsed(i))
+            trajectories.getValue(i).missed++;
+    
+    for (int i = 0; i < _hands.size(); i++) {
+        const mkTrackedHand& hand = _hands[i];
+        trajectory* t = trajectories.find(hand.id);
+        if (t == NULL) {
+            t = trajectories.insert(hand.id);
+            t->head = 0;
+            t->count = 0;
+            t->holding = false;
+        }
+        else if (t->count > 0 && (_timestampMicros <= t->get(0).timestamp || _timestampMicros - t->get(0).timestamp > MK_GESTURE_MAX_GAP)) {
+            t->count = 0;
+            t->holding = false;
+        }
+        t->missed = 0;
+        t->add(_timestampMicros, hand.worldPosition);
+        
+        mkGestureEvent event;
+        event.size = 0;
+        if (detectPush(*t, event.size))
+            event.type = MK_GESTURE_PUSH;
+        else if (detectSwipe(*t, event.type, event.size))
+            ;
+        else if (detectCircle(*t, event.size))
+            event.type = MK_GESTURE_CIRCLE;
+        else if (detectHold(*t))
+            event.type = MK_GESTURE_HOLD;
+        else
+            continue;
+        
+        event.id = hand.id;
+        event.position = hand.position;
+        event.worldPosition = hand.worldPosition;
+        event.timestamp = _timestampMicros;
+        _events.push_back(event);
+        // the next gesture starts from here; a hold keeps its samples so
+        // that it is only left by moving
+        if (event.type != MK_GESTURE_HOLD)
+            t->count = 0;
+    }
+    
+    // erasing moves the next trajectory of the run into the slot, look again
+    for (int i = 0; i < trajectories.getCapacity();) {
+        if (trajectories.isUsed(i) && trajectories.getValue(i).missed > MK_GESTURE_MAX_MISSED)
+            trajectories.eraseSlot(i);
+        else
+            i++;
+    }
+}
+
+//--------------------------------------------------------------
+void mkGestureEngine::handEvent(mkHandEventBatch& _batch) {
+    for (int i = 0; i < _batch.events.size(); i++)
+        if (_batch.events[i].status == HAND_TRACKING_STOPPED)
+            trajectories.erase(_batch.events[i].id);
+}
+
+//--------------------------------------------------------------
+int mkGestureEngine::countWindow(const trajectory& _trajectory, float _duration) {
+    if (_trajectory.count == 0)
+        return 0;
+    XnUInt64 newest = _trajectory.get(0).timestamp;
+    XnUInt64 window = _duration * 1000;
+    int n = 1;
+    while (n < _trajectory.count && newest - _trajectory.get(n).timestamp <= window)
+        n++;
+    return n;
+}
+
+//--------------------------------------------------------------
+bool mkGestureEngine::detectPush(const trajectory& _trajectory, float& _size) const {
+    // towards the sensor by the push distance, along a straight path
+    int n = countWindow(_trajectory, pushDuration);
+    const ofPoint& newest = _trajectory.get(0).position;
+    float path = 0;
+    for (int k = 1; k < n; k++) {
+        path += (_trajectory.get(k - 1).position - _trajectory.get(k).position).length();
+        ofPoint d = newest - _trajectory.get(k).position;
+        float depth = -d.z;
+        if (depth >= pushDistance && d.x * d.x + d.y * d.y < 0.25f * depth * depth && path < MK_GESTURE_MAX_CURVE * depth) {
+            _size = depth;
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------
+bool mkGestureEngine::detectSwipe(const trajectory& _trajectory, mkGestureType& _type, float& _size) const {
+    // along x or y by the swipe distance, the other axes at most half as
+    // far, along a straight path. A swipe is only over once the hand slows
+    // down, a hand that keeps moving may still be drawing a circle.
+    int n = countWindow(_trajectory, swipeDuration);
+    if (n < 3)
+        return false;
+    const ofPoint& newest = _trajectory.get(0).position;
+    float lastStep = (newest - _trajectory.get(1).position).length();
+    float path = 0;
+    for (int k = 1; k < n; k++) {
+        path += (_trajectory.get(k - 1).position - _trajectory.get(k).position).length();
+        if (lastStep > MK_GESTURE_SWIPE_END * path / k)
+            continue;
+        ofPoint d = newest - _trajectory.get(k).position;
+        float ax = fabsf(d.x), ay = fabsf(d.y), az = fabsf(d.z);
+        if (path > MK_GESTURE_MAX_CURVE * MAX(ax, ay))
+            continue;
+        if (ax >= swipeDistance && ay < 0.5f * ax && az < 0.5f * ax) {
+            _type = d.x < 0 ? MK_GESTURE_SWIPE_LEFT : MK_GESTURE_SWIPE_RIGHT;
+            _size = ax;
+            return true;
+        }
+        if (ay >= swipeDistance && ax < 0.5f * ay && az < 0.5f * ay) {
+            _type = d.y < 0 ? MK_GESTURE_SWIPE_DOWN : MK_GESTURE_SWIPE_UP;
+            _size = ay;
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------
+bool mkGestureEngine::detectCircle(const trajectory& _trajectory, float& _size) const {
+    // the direction of motion facing the sensor turns once around within
+    // the window, newest backwards, at a steady radius around the centroid
+    // of the samples of that turn
+    int n = countWindow(_trajectory, circleDuration);
+    float turn = 0, lastHeading = 0;
+    bool hasHeading = false;
+    int m = 0;
+    for (int k = 0; k < n - 1 && fabsf(turn) < TWO_PI; k++) {
+        ofPoint d = _trajectory.get(k).position - _trajectory.get(k + 1).position;
+        // steps of a resting hand have no direction
+        if (d.x * d.x + d.y * d.y < MK_GESTURE_MIN_STEP * MK_GESTURE_MIN_STEP)
+            continue;
+        float heading = atan2f(d.y, d.x);
+        if (hasHeading) {
+            float delta = heading - lastHeading;
+            if (delta > PI)
+                delta -= TWO_PI;
+            else if (delta < -PI)
+                delta += TWO_PI;
+            turn += delta;
+        }
+        lastHeading = heading;
+        hasHeading = true;
+        m = k + 2;
+    }
+    if (fabsf(turn) < TWO_PI || m < MK_GESTURE_MIN_CIRCLE_SAMPLES)
+        return false;
+    
+    float cx = 0, cy = 0;
+    for (int k = 0; k < m; k++) {
+        cx += _trajectory.get(k).position.x;
+        cy += _trajectory.get(k).position.y;
+    }
+    cx /= m;
+    cy /= m;
+    float sumRadius = 0, sumRadius2 = 0;
+    for (int k = 0; k < m; k++) {
+        float x = _trajectory.get(k).position.x - cx;
+        float y = _trajectory.get(k).position.y - cy;
+        float radius2 = x * x + y * y;
+        sumRadius += sqrtf(radius2);
+        sumRadius2 += radius2;
+    }
+    
+    float meanRadius = sumRadius / m;
+    float deviation = sqrtf(MAX(0.0f, sumRadius2 / m - meanRadius * meanRadius));
+    if (meanRadius < circleRadius || deviation > circleRoundness * meanRadius)
+        return false;
+    _size = meanRadius;
+    return true;
+}
+
+//--------------------------------------------------------------
+bool mkGestureEngine::detectHold(trajectory& _trajectory) const {
+    const ofPoint& newest = _trajectory.get(0).position;
+    float radius2 = holdRadius * holdRadius;
+    if (_trajectory.holding) {
+        if (newest.squareDistance(_trajectory.holdCenter) > radius2)
+            _trajectory.holding = false;
+        return false;
+    }
+    
+    // the whole hold duration has to be covered by samples in the radius
+    int n = countWindow(_trajectory, holdDuration);
+    if (_trajectory.get(0).timestamp - _trajectory.get(n - 1).timestamp < holdDuration * 900)
+        return false;
+    ofPoint center(0, 0, 0);
+    for (int k = 0; k < n; k++)
+        center += _trajectory.get(k).position;
+    center *= 1.0f / n;
+    for (int k = 0; k < n; k++)
+        if (_trajectory.get(k).position.squareDistance(center) > radius2)
+            return false;
+    _trajectory.holding = true;
+    _trajectory.holdCenter = center;
+    return true;
+}
+
+//--------------------------------------------------------------
+string mkGestureEngine::getGestureName(mkGestureType _type) {
+    switch (_type) {
+        case MK_GESTURE_PUSH:           return "push";
+        case MK_GESTURE_SWIPE_LEFT:     return "swipe left";
+        case MK_GESTURE_SWIPE_RIGHT:    return "swipe right";
+        case MK_GESTURE_SWIPE_UP:       return "swipe up";
+        case MK_GESTURE_SWIPE_DOWN:     return "swipe down";
+        case MK_GESTURE_CIRCLE:         return "circle";
+        case MK_GESTURE_HOLD:           return "hold";
+        default:                        return "unknown";
+    }
+}
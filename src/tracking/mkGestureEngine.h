@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkIdMap.h"
+#include "mkHandEvent.h"
+
+// Recognises push, swipe, circle and hold gestures of every tracked hand, in
+// place of one NITE detector per gesture and listener with point buffers of
+// their own.
+//
+// Every hand has one fixed trajectory ring of its latest real world
+// positions in a flat map by hand id. update() appends the samples of a
+// frame and runs all classifiers over every hand in one pass, each looking
+// back over its own time window of the ring, so the cost grows linearly
+// with the number of hands. A recognised gesture clears the hand's ring, a
+// new gesture needs new samples. Hold is reported once until the hand moves
+// away.
+//
+// The engine only sees positions and timestamps, so trajectories from a
+// replay or written by hand classify exactly as live ones. All storage is
+// reserved in setup(); update() does not allocate.
+
+// samples per hand, two seconds of sensor frames
+#define MK_GESTURE_HISTORY 64
+
+enum mkGestureType {
+    MK_GESTURE_PUSH = 0,
+    MK_GESTURE_SWIPE_LEFT,
+    MK_GESTURE_SWIPE_RIGHT,
+    MK_GESTURE_SWIPE_UP,
+    MK_GESTURE_SWIPE_DOWN,
+    MK_GESTURE_CIRCLE,
+    MK_GESTURE_HOLD,
+    MK_GESTURE_NUM_TYPES
+};
+
+struct mkGestureEvent {
+    mkGestureType       type;
+    XnUserID            id;             // the hand
+    ofPoint             position;       // projective, input pixels, where it was recognised
+    ofPoint             worldPosition;  // real world, mm
+    float               size;           // mm: push depth, swipe length or circle radius
+    XnUInt64            timestamp;
+};
+
+class mkGestureEngine {
+public:
+    mkGestureEngine();
+    
+    void    setup(int _maxNumHands = 16);
+    void    reset();
+    
+    // appends the hands at _timestampMicros and replaces _events with the
+    // gestures recognised in this frame
+    void    update(const vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros, vector<mkGestureEvent>& _events);
+    // subscriber of mkHandEventBus: drops the trajectories of ended hands
+    void    handEvent(mkHandEventBatch& _batch);
+    
+    static string	getGestureName(mkGestureType _type);
+    
+    ofParameterGroup	parameters;
+    
+protected:
+    ofParameter<float>	pushDistance;
+    ofParameter<float>	pushDuration;
+    ofParameter<float>	swipeDistance;
+    ofParameter<float>	swipeDuration;
+    ofParameter<float>	circleRadius;
+    ofParameter<float>	circleRoundness;
+    ofParameter<float>	circleDuration;
+    ofParameter<float>	holdRadius;
+    ofParameter<float>	holdDuration;
+    
+    struct sample {
+        XnUInt64    timestamp;
+        ofPoint     position;
+    };
+    
+    struct trajectory {
+        sample      samples[MK_GESTURE_HISTORY];
+        int         head;           // next slot to write
+        int         count;
+        int         missed;
+        bool        holding;
+        ofPoint     holdCenter;
+        
+        // _age 0 is the newest sample
+        const sample&	get(int _age) const		{ return samples[(head - 1 - _age) & (MK_GESTURE_HISTORY - 1)]; }
+        void			add(XnUInt64 _timestamp, const ofPoint& _position);
+    };
+    
+    // the number of samples no older than _duration ms before the newest
+    static int  countWindow(const trajectory& _trajectory, float _duration);
+    
+    bool    detectPush(const trajectory& _trajectory, float& _size) const;
+    bool    detectSwipe(const trajectory& _trajectory, mkGestureType& _type, float& _size) const;
+    bool    detectCircle(const trajectory& _trajectory, float& _size) const;
+    bool    detectHold(trajectory& _trajectory) const;
+    
+    mkIdMap<trajectory>	trajectories;
+};
@@ -0,0 +1,173 @@
+#include "mkHandFilter.h"
+
+// frames a hand may be missing before its state is dropped
+#define MK_HAND_FILTER_MAX_MISSED 10
+// a longer gap restarts the filter, as after a replay loops
+#define MK_HAND_FILTER_MAX_GAP 250000
+
+//--------------------------------------------------------------
+mkHandFilter::mkHandFilter() : lastMode(-1) {
+    parameters.setName("hand filter");
+    parameters.add(mode.set("mode", MK_HAND_FILTER_KALMAN, MK_HAND_FILTER_NONE, MK_HAND_FILTER_NUM_MODES - 1));
+    parameters.add(minCutoff.set("min cutoff", 1.0, 0.01, 10));					// Hz at rest
+    parameters.add(beta.set("beta", 0.01, 0, 0.1));								// Hz per mm/s
+    parameters.add(derivativeCutoff.set("derivative cutoff", 2.0, 0.01, 10));	// Hz
+    parameters.add(accelerationNoise.set("acceleration noise", 2000, 1, 20000));	// mm/s2
+    parameters.add(measurementNoise.set("measurement noise", 8, 0.1, 100));		// mm
+    parameters.add(latency.set("latency", 33, 0, 100));							// ms, sensor to capture
+    parameters.add(maxLead.set("max lead", 100, 0, 200));						// ms
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::setup(int _maxNumHands) {
+    // missed hands linger next to the visible ones
+    states.setup(_maxNumHands * 2);
+    reset();
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::reset() {
+    states.clear();
+    lastMode = mode.get();
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::update(vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros) {
+    // one mode for the whole frame
+    int currentMode = mode.get();
+    if (currentMode != lastMode)
+        reset();
+    
+    for (int i = 0; i < states.getCapacity(); i++)
+        if (states.isUsed(i))
+            states.getValue(i).missed++;
+    
+    if (currentMode == MK_HAND_FILTER_NONE) {
+        for (int i = 0; i < _hands.size(); i++)
+            _hands[i].worldVelocity.set(0, 0, 0);
+        return;
+    }
+    
+    for (int i = 0; i < _hands.size(); i++) {
+        mkTrackedHand& hand = _hands[i];
+        handState* state = states.find(hand.id);
+        if (state == NULL) {
+            state = states.insert(hand.id);
+            initState(*state, hand.worldPosition);
+        }
+        else if (_timestampMicros <= state->timestamp || _timestampMicros - state->timestamp > MK_HAND_FILTER_MAX_GAP) {
+            initState(*state, hand.worldPosition);
+        }
+        else {
+            float deltaTime = (_timestampMicros - state->timestamp) / 1000000.0f;
+            for (int a = 0; a < 3; a++) {
+                if (currentMode == MK_HAND_FILTER_ONE_EURO)
+                    filterOneEuro(state->oneEuro[a], hand.worldPosition[a], deltaTime, minCutoff, beta, derivativeCutoff);
+                else
+                    filterKalman(state->kalman[a], hand.worldPosition[a], deltaTime, accelerationNoise, measurementNoise);
+            }
+        }
+        state->timestamp = _timestampMicros;
+        state->missed = 0;
+        
+        for (int a = 0; a < 3; a++) {
+            if (currentMode == MK_HAND_FILTER_ONE_EURO) {
+                hand.worldPosition[a] = state->oneEuro[a].value;
+                hand.worldVelocity[a] = state->oneEuro[a].derivative;
+            }
+            else {
+                hand.worldPosition[a] = state->kalman[a].position;
+                hand.worldVelocity[a] = state->kalman[a].velocity;
+            }
+        }
+    }
+    
+    // erasing moves the next state of the run into the slot, look again
+    for (int i = 0; i < states.getCapacity();) {
+        if (states.isUsed(i) && states.getValue(i).missed > MK_HAND_FILTER_MAX_MISSED)
+            states.eraseSlot(i);
+        else
+            i++;
+    }
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::initState(handState& _state, const ofPoint& _position) {
+    // uncertain about the velocity until the second sample
+    float r = measurementNoise * measurementNoise;
+    for (int a = 0; a < 3; a++) {
+        _state.oneEuro[a].value = _position[a];
+        _state.oneEuro[a].derivative = 0;
+        _state.kalman[a].position = _position[a];
+        _state.kalman[a].velocity = 0;
+        _state.kalman[a].p00 = r;
+        _state.kalman[a].p01 = 0;
+        _state.kalman[a].p11 = 1000.0f * 1000.0f;
+    }
+}
+
+//--------------------------------------------------------------
+static inline float smoothingFactor(float _cutoff, float _deltaTime) {
+    float tau = 1.0f / (TWO_PI * _cutoff);
+    return 1.0f / (1.0f + tau / _deltaTime);
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::filterOneEuro(oneEuroAxis& _axis, float _sample, float _deltaTime, float _minCutoff, float _beta, float _derivativeCutoff) {
+    float derivative = (_sample - _axis.value) / _deltaTime;
+    _axis.derivative += smoothingFactor(_derivativeCutoff, _deltaTime) * (derivative - _axis.derivative);
+    
+    float cutoff = _minCutoff + _beta * fabsf(_axis.derivative);
+    _axis.value += smoothingFactor(cutoff, _deltaTime) * (_sample - _axis.value);
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::filterKalman(kalmanAxis& _axis, float _sample, float _deltaTime, float _accelerationNoise, float _measurementNoise) {
+    float dt = _deltaTime;
+    float q = _accelerationNoise * _accelerationNoise;
+    float r = _measurementNoise * _measurementNoise;
+    
+    // predict, white acceleration noise
+    _axis.position += _axis.velocity * dt;
+    _axis.p00 += dt * (2 * _axis.p01 + dt * _axis.p11) + q * dt * dt * dt / 3;
+    _axis.p01 += dt * _axis.p11 + q * dt * dt / 2;
+    _axis.p11 += q * dt;
+    
+    // correct with the measured position
+    float s = _axis.p00 + r;
+    float k0 = _axis.p00 / s;
+    float k1 = _axis.p01 / s;
+    float residual = _sample - _axis.position;
+    _axis.position += k0 * residual;
+    _axis.velocity += k1 * residual;
+    _axis.p11 -= k1 * _axis.p01;
+    _axis.p00 -= k0 * _axis.p00;
+    _axis.p01 -= k0 * _axis.p01;
+}
+
+//--------------------------------------------------------------
+unsigned long long mkHandFilter::getLeadMicros(unsigned long long _captureMicros, unsigned long long _nowMicros) const {
+    unsigned long long lead = latency.get() * 1000;
+    if (_nowMicros > _captureMicros)
+        lead += _nowMicros - _captureMicros;
+    return MIN(lead, (unsigned long long)(maxLead.get() * 1000));
+}
+
+//--------------------------------------------------------------
+void mkHandFilter::predict(const vector<mkTrackedHand>& _hands, unsigned long long _leadMicros, vector<mkTrackedHand>& _predicted) {
+    if (&_predicted != &_hands)
+        _predicted = _hands;
+    float lead = _leadMicros / 1000000.0f;
+    for (int i = 0; i < _predicted.size(); i++)
+        _predicted[i].worldPosition += _predicted[i].worldVelocity * lead;
+}
+
+//--------------------------------------------------------------
+string mkHandFilter::getModeName(mkHandFilterMode _mode) {
+    switch (_mode) {
+        case MK_HAND_FILTER_NONE:       return "none";
+        case MK_HAND_FILTER_ONE_EURO:   return "one euro";
+        case MK_HAND_FILTER_KALMAN:     return "kalman";
+        default:                        return "unknown";
+    }
+}
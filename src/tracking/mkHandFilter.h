@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+#include "mkKinectFrame.h"
+#include "mkIdMap.h"
+
+// Smooths the real world hand positions on the capture thread and estimates
+// their velocity, so the render thread can move every hand forward to the
+// time it is drawn instead of where the sensor saw it one latency ago.
+//
+// Every axis is filtered on its own, in mm at the sensor timestamps, by
+//  - a One-Euro filter: a low pass whose cutoff rises with the speed, steady
+//    while the hand rests and with little lag when it moves, or
+//  - a constant velocity Kalman filter, whose velocity is better suited
+//    for prediction at the cost of some overshoot on sudden stops.
+// Filter state is kept in a flat map by hand id and survives a few missed
+// frames. All storage is reserved in setup(); more hands than that grow it
+// once.
+
+enum mkHandFilterMode {
+    MK_HAND_FILTER_NONE = 0,
+    MK_HAND_FILTER_ONE_EURO,
+    MK_HAND_FILTER_KALMAN,
+    MK_HAND_FILTER_NUM_MODES
+};
+
+class mkHandFilter {
+public:
+    mkHandFilter();
+    
+    void    setup(int _maxNumHands = 16);
+    void    reset();
+    
+    // capture thread: filters worldPosition in place and sets worldVelocity,
+    // projective positions are left to the caller
+    void    update(vector<mkTrackedHand>& _hands, XnUInt64 _timestampMicros);
+    
+    // how far to extrapolate a frame captured at _captureMicros to be seen
+    // at _nowMicros, sensor latency included and clamped to max lead. Any
+    // thread: reads only latency and max lead, which are not changed while
+    // update() runs; without a filter the velocities are zero and the lead
+    // moves nothing.
+    unsigned long long	getLeadMicros(unsigned long long _captureMicros, unsigned long long _nowMicros) const;
+    
+    // moves the world positions of _hands forward by _leadMicros along
+    // their velocity, _predicted may be _hands
+    static void predict(const vector<mkTrackedHand>& _hands, unsigned long long _leadMicros, vector<mkTrackedHand>& _predicted);
+    
+    // on the thread that calls update(), which applies a new mode on its
+    // next call; mkCaptureThread takes requests from other threads
+    mkHandFilterMode	getMode() const			{ return (mkHandFilterMode)mode.get(); }
+    void				setMode(mkHandFilterMode _mode)	{ mode.set(_mode); }
+    static string		getModeName(mkHandFilterMode _mode);
+    
+    ofParameterGroup	parameters;
+    
+    struct oneEuroAxis {
+        float   value;
+        float   derivative;     // low passed, per second
+    };
+    
+    struct kalmanAxis {
+        float   position;
+        float   velocity;       // per second
+        float   p00, p01, p11;  // covariance
+    };
+    
+    // one step of one axis, _deltaTime in seconds
+    static void filterOneEuro(oneEuroAxis& _axis, float _sample, float _deltaTime, float _minCutoff, float _beta, float _derivativeCutoff);
+    static void filterKalman(kalmanAxis& _axis, float _sample, float _deltaTime, float _accelerationNoise, float _measurementNoise);
+    
+protected:
+    ofParameter<int>	mode;
+    ofParameter<float>	minCutoff;
+    ofParameter<float>	beta;
+    ofParameter<float>	derivativeCutoff;
+    ofParameter<float>	accelerationNoise;
+    ofParameter<float>	measurementNoise;
+    ofParameter<float>	latency;
+    ofParameter<float>	maxLead;
+    
+    struct handState {
+        XnUInt64        timestamp;
+        int             missed;
+        oneEuroAxis     oneEuro[3];
+        kalmanAxis      kalman[3];
+    };
+    
+    void        initState(handState& _state, const ofPoint& _position);
+    
+    mkIdMap<handState>  states;
+    int                 lastMode;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Minimal timing helper for the micro benchmarks that run headless with
+// --benchmark (see mkBenchmarks.cpp).
+
+class mkBenchmark {
+public:
+    // average microseconds per call, after one warm up call
+    template<typename F>
+    static double run(const string& _name, int _iterations, F _function) {
+        _function();
+        unsigned long long start = ofGetElapsedTimeMicros();
+        for (int i = 0; i < _iterations; i++)
+            _function();
+        double micros = double(ofGetElapsedTimeMicros() - start) / _iterations;
+        ofLogNotice("benchmark") << _name << ": " << micros << " us";
+        return micros;
+    }
+    
+    static void report(const string& _name, double _baseline, double _optimised) {
+        ofLogNotice("benchmark") << _name << ": " << _baseline / MAX(_optimised, 0.001) << "x";
+    }
+    
+    // checks that failed since the last reset, see mkBenchmarkFailure
+    static int  getNumFailures()		{ return numFailures; }
+    static void addFailure()			{ numFailures++; }
+    static void resetFailures()			{ numFailures = 0; }
+    
+protected:
+    static int  numFailures;
+};
+
+// logs a failed check like ofLogError("benchmark") and counts it
+class mkBenchmarkFailure : public ofLogError {
+public:
+    mkBenchmarkFailure() : ofLogError("benchmark")	{ mkBenchmark::addFailure(); }
+};
+
+// returns the number of failed checks
+int mkRunBenchmarks();
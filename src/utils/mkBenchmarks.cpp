@@ -0,0 +1,1681 @@
+#include "mkBenchmark.h"
+#include "mkDepthConvert.h"
+#include "mkDepthBackground.h"
+#include "mkBlobTracker.h"
+#include "mkDepthRays.h"
+#include "mkDepthFilter.h"
+#include "mkDepthCodec.h"
+#include "mkDepthRecorder.h"
+#include "mkDepthPlayer.h"
+#include "mkHandFilter.h"
+#include "mkGestureEngine.h"
+#include "mkHandForces.h"
+#include "mkStage.h"
+#include "mkCaptureThread.h"
+#include "mkSpscRing.h"
+#include "mkMpscRing.h"
+#include "mkLogChannel.h"
+#include "mkIdMap.h"
+#include "mkSharedMemory.h"
+#include "mkStatePublisher.h"
+#include "mkUsbIngest.h"
+#include "mkFluidSimulation.h"
+#include "XnPropNames.h"
+#include "XnThreadSafeQueue.h"
+#include "XnHash.h"
+
+// Synthetic inputs only, so the benchmarks run without a sensor or a GPU.
+
+int mkBenchmark::numFailures = 0;
+
+// the hand-off the ring replaces, one allocated copy per element
+XN_DECLARE_THREAD_SAFE_QUEUE(mkHandEvent, mkHandEventQueue)
+
+// per hand state about the size of the hand filter's
+struct mkTestHandState {
+    float   values[24];
+};
+XN_DECLARE_DEFAULT_HASH(XnUserID, mkTestHandState, mkTestHandStateHash)
+
+//--------------------------------------------------------------
+static void makeTestDepth(vector<XnDepthPixel>& _depth, int _width, int _height) {
+    _depth.resize(_width * _height);
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            // a slanted floor, a blob in front and shadow holes on its edge
+            float dx = (x - _width * 0.5f) / _width;
+            float dy = (y - _height * 0.5f) / _height;
+            bool blob = dx * dx + dy * dy < 0.04f;
+            bool shadow = !blob && dx * dx + dy * dy < 0.045f && dx > 0;
+            _depth[y * _width + x] = shadow ? XN_DEPTH_NO_SAMPLE_VALUE : (blob ? 1200 : 2000 + y * 6) + (x * 7 + y * 13) % 5;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthConvert() {
+    const int width = 640, height = 480;
+    vector<XnDepthPixel> depth;
+    makeTestDepth(depth, width, height);
+    vector<XnUInt8> scalarImage(width * height), image(width * height);
+    mkDepthWindow window = { 500, 4000, 0, 0 };
+    
+    double scalar = mkBenchmark::run("depth to image, scalar", 200, [&] {
+        mkDepthConvert::toImageScalar(&depth[0], width * height, window, &scalarImage[0]);
+    });
+    double simd = mkBenchmark::run("depth to image, simd", 200, [&] {
+        mkDepthConvert::toImage(&depth[0], width * height, window, &image[0]);
+    });
+    mkBenchmark::report("depth to image speed up", scalar, simd);
+    if (image != scalarImage)
+        mkBenchmarkFailure() << "depth to image: simd and scalar differ";
+    
+    vector<float> field(160 * 90);
+    vector<XnUInt32> rowSums(width);
+    vector<XnUInt16> rowCounts(width);
+    mkBenchmark::run("depth to 160x90 field", 200, [&] {
+        mkDepthConvert::toField(&depth[0], width, height, window, &field[0], 160, 90, &rowSums[0], &rowCounts[0]);
+    });
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthBackground() {
+    const int width = 640, height = 480;
+    vector<XnDepthPixel> depth;
+    makeTestDepth(depth, width, height);
+    vector<XnDepthPixel> scalarBackground(width * height, 2500), background(width * height, 2500);
+    vector<XnUInt8> scalarMask(width * height), mask(width * height);
+    
+    // the model changes every call, so run both the same number of times
+    double scalar = mkBenchmark::run("background model, scalar", 200, [&] {
+        mkDepthBackground::updateModelScalar(&depth[0], width * height, 2, 150, &scalarBackground[0], &scalarMask[0]);
+    });
+    double simd = mkBenchmark::run("background model, simd", 200, [&] {
+        mkDepthBackground::updateModel(&depth[0], width * height, 2, 150, &background[0], &mask[0]);
+    });
+    mkBenchmark::report("background model speed up", scalar, simd);
+    if (background != scalarBackground || mask != scalarMask)
+        mkBenchmarkFailure() << "background model: simd and scalar differ";
+    
+    vector<XnUInt8> small(160 * 90);
+    vector<XnUInt16> columnSums(width);
+    mkBenchmark::run("foreground mask to 160x90", 200, [&] {
+        mkDepthBackground::downsample(&mask[0], width, height, &small[0], 160, 90, &columnSums[0]);
+    });
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthPyramid() {
+    const int width = 640, height = 480;
+    vector<XnDepthPixel> depth;
+    makeTestDepth(depth, width, height);
+    vector<XnDepthPixel> scalarLevel(width * height / 4), level(width * height / 4);
+    
+    double scalar = mkBenchmark::run("pyramid nearest, scalar", 200, [&] {
+        mkDepthPyramid::reduceNearestScalar(&depth[0], width, height, &scalarLevel[0]);
+    });
+    double simd = mkBenchmark::run("pyramid nearest, simd", 200, [&] {
+        mkDepthPyramid::reduceNearest(&depth[0], width, height, &level[0]);
+    });
+    mkBenchmark::report("pyramid nearest speed up", scalar, simd);
+    if (level != scalarLevel)
+        mkBenchmarkFailure() << "pyramid nearest: simd and scalar differ";
+    
+    scalar = mkBenchmark::run("pyramid average, scalar", 200, [&] {
+        mkDepthPyramid::reduceAverageScalar(&depth[0], width, height, &scalarLevel[0]);
+    });
+    simd = mkBenchmark::run("pyramid average, simd", 200, [&] {
+        mkDepthPyramid::reduceAverage(&depth[0], width, height, &level[0]);
+    });
+    mkBenchmark::report("pyramid average speed up", scalar, simd);
+    if (level != scalarLevel)
+        mkBenchmarkFailure() << "pyramid average: simd and scalar differ";
+    
+    mkDepthPyramid pyramid;
+    pyramid.setup(width, height);
+    mkBenchmark::run("pyramid, " + ofToString(pyramid.getNumLevels()) + " levels", 200, [&] {
+        pyramid.update(&depth[0]);
+    });
+}
+
+//--------------------------------------------------------------
+static void makeTestPeople(vector<XnDepthPixel>& _depth, int _width, int _height, int _numPeople, int _frame) {
+    // a wall at 3 m and a row of people at 1.5 m reaching towards the sensor
+    _depth.assign(_width * _height, 3000);
+    for (int p = 0; p < _numPeople; p++) {
+        int cx = (p + 0.5f) * _width / _numPeople + 8 * sin(_frame * 0.1f + p);
+        int cy = _height / 2 + 20 * cos(_frame * 0.07f + p);
+        for (int y = MAX(cy - 60, 0); y < MIN(cy + 60, _height); y++) {
+            for (int x = MAX(cx - 12, 0); x < MIN(cx + 12, _width); x++) {
+                // the hand is a smooth bump, so it stays connected to the body
+                int dx = x - cx, dy = y - cy;
+                _depth[y * _width + x] = 1500 - 300 * MAX(0.0f, 1.0f - sqrtf(dx * dx + dy * dy) / 40.0f);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkBlobTracker() {
+    const int width = 640, height = 480, numPeople = 12;
+    vector<XnDepthPixel> depth;
+    vector<mkTrackedHand> hands;
+    hands.reserve(16);
+    mkBlobTracker tracker;
+    tracker.setup(width, height);
+    mkDepthPyramid pyramid;
+    pyramid.setup(width, height);
+    
+    int frame = 0;
+    mkBenchmark::run("blob tracker, 12 people", 200, [&] {
+        makeTestPeople(depth, width, height, numPeople, frame++);
+        pyramid.update(&depth[0]);
+        tracker.update(pyramid, hands);
+    });
+    ofLogNotice("benchmark") << "blob tracker: " << hands.size() << " of " << numPeople << " tracked, tracker reports "
+                             << tracker.getAverageMicros() << " us per frame";
+    if (hands.size() != numPeople || tracker.getNumTracks() != numPeople)
+        mkBenchmarkFailure() << "blob tracker: lost or split a blob";
+    
+    // a checkerboard a step and more apart in cells of the tracking
+    // resolution, so no two neighbours join and every pixel starts a label
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            depth[y * width + x] = ((x / 4 + y / 4) % 2) ? 1100 : 1000;
+    tracker.reset();
+    for (int i = 0; i < 3; i++) {
+        pyramid.update(&depth[0]);
+        tracker.update(pyramid, hands);
+    }
+    ofLogNotice("benchmark") << "blob tracker, checkerboard: " << tracker.getNumBlobs() << " blobs, " << hands.size() << " hands";
+    if (tracker.getNumBlobs() != 0 || !hands.empty())
+        mkBenchmarkFailure() << "blob tracker: found blobs in a checkerboard";
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthRays() {
+    const int width = 640, height = 480;
+    vector<XnDepthPixel> depth;
+    makeTestDepth(depth, width, height);
+    
+    // a mock node with the Kinect's field of view, so OpenNI runs its own math
+    XnFieldOfView fieldOfView = { 1.0144686707507438, 0.78980943449644714 };
+    XnMapOutputMode mode = { width, height, 30 };
+    xn::Context context;
+    xn::MockDepthGenerator mockDepth;
+    if (context.Init() != XN_STATUS_OK || mockDepth.Create(context, "mkBenchmarkDepth") != XN_STATUS_OK) {
+        mkBenchmarkFailure() << "depth rays: could not create a mock depth generator";
+        return;
+    }
+    mockDepth.SetMapOutputMode(mode);
+    mockDepth.SetGeneralProperty(XN_PROP_FIELD_OF_VIEW, sizeof(XnFieldOfView), &fieldOfView);
+    
+    mkDepthRays rays;
+    if (!rays.setup(mockDepth))
+        return;
+    
+    vector<XnPoint3D> projective(width * height), openNIWorld(width * height), world(width * height);
+    for (int v = 0; v < height; v++) {
+        for (int u = 0; u < width; u++) {
+            XnPoint3D& p = projective[v * width + u];
+            p.X = u;
+            p.Y = v;
+            p.Z = depth[v * width + u];
+        }
+    }
+    
+    double openNI = mkBenchmark::run("projective to world, OpenNI", 50, [&] {
+        mockDepth.ConvertProjectiveToRealWorld(width * height, &projective[0], &openNIWorld[0]);
+    });
+    double table = mkBenchmark::run("projective to world, ray table", 50, [&] {
+        rays.toWorld(&depth[0], &world[0]);
+    });
+    mkBenchmark::report("projective to world speed up", openNI, table);
+    if (memcmp(&world[0], &openNIWorld[0], world.size() * sizeof(XnPoint3D)) != 0)
+        mkBenchmarkFailure() << "depth rays: frame differs from OpenNI";
+    
+    rays.toWorld(width * height, &projective[0], &world[0]);
+    if (memcmp(&world[0], &openNIWorld[0], world.size() * sizeof(XnPoint3D)) != 0)
+        mkBenchmarkFailure() << "depth rays: batch differs from OpenNI";
+    
+    mockDepth.Release();
+    context.Release();
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthFilter() {
+    const int width = 640, height = 480;
+    vector<XnDepthPixel> depth;
+    makeTestDepth(depth, width, height);
+    // speckle on top of the shadow holes
+    for (int i = 0; i < depth.size(); i += 37)
+        depth[i] = XN_DEPTH_NO_SAMPLE_VALUE;
+    
+    vector<XnDepthPixel> scalarState(width * height, 0), state(width * height, 0);
+    vector<XnUInt8> scalarAge(width * height, 255), age(width * height, 255);
+    vector<XnDepthPixel> scalarOutput(width * height), output(width * height);
+    double scalar = mkBenchmark::run("depth filter temporal, scalar", 200, [&] {
+        mkDepthFilter::filterTemporalScalar(&depth[0], &scalarState[0], &scalarAge[0], width * height, 90, 80, 6, &scalarOutput[0]);
+    });
+    double simd = mkBenchmark::run("depth filter temporal, simd", 200, [&] {
+        mkDepthFilter::filterTemporal(&depth[0], &state[0], &age[0], width * height, 90, 80, 6, &output[0]);
+    });
+    mkBenchmark::report("depth filter temporal speed up", scalar, simd);
+    if (output != scalarOutput || state != scalarState || age != scalarAge)
+        mkBenchmarkFailure() << "depth filter: simd and scalar differ";
+    
+    mkDepthFilter filter;
+    filter.setup(width, height);
+    mkBenchmark::run("depth filter, one thread", 200, [&] {
+        filter.update(&depth[0], &output[0]);
+    });
+    mkWorkerPool pool;
+    pool.setup();
+    mkBenchmark::run("depth filter, " + ofToString(pool.getNumThreads() + 1) + " threads", 200, [&] {
+        filter.update(&depth[0], &output[0], &pool);
+    });
+}
+
+//--------------------------------------------------------------
+static void makeTestRecordingFrame(XnDepthPixel* _depth, int _width, int _height, int _frame) {
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            // no samples down the left edge, a slanted wall behind, a person
+            // walking across in front of it and a patch of sensor noise
+            float dx = x - (100 + _frame * 8) % _width, dy = y - _height * 0.5f;
+            XnDepthPixel depth = 3000 + x / 4;
+            if (x < 40)
+                depth = XN_DEPTH_NO_SAMPLE_VALUE;
+            else if (dx * dx + dy * dy < 60 * 60)
+                depth = 1200 + (int)fabsf(dx) / 8;
+            else if (x >= 400 && x < 464 && y >= 40 && y < 104)
+                depth += (_frame * 7919 + x * 104729 + y * 1299709) % 7 - 3;
+            _depth[y * _width + x] = depth;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static void countCodecTokens(const vector<XnUInt8>& _payload, int _counts[4]) {
+    // zero runs, long zero runs, 8 bit and 16 bit residuals, as laid out in
+    // mkDepthCodec.h
+    for (size_t i = 0; i < _payload.size();) {
+        XnUInt8 c = _payload[i];
+        if (c < 0x7f) {
+            _counts[0]++;
+            i++;
+        }
+        else if (c == 0x7f) {
+            _counts[1]++;
+            i += 3;
+        }
+        else if (c < 0xc0) {
+            _counts[2]++;
+            i += 1 + (c - 0x7f);
+        }
+        else {
+            _counts[3]++;
+            i += 1 + (c - 0xbf) * 2;
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkDepthRecording() {
+    // three keyframe groups recorded and replayed, every frame compared
+    const int width = 640, height = 480, numFrames = 90, keyframeInterval = 30;
+    const string path = "mkBenchmarkDepth.mkd";
+    vector<XnDepthPixel> expected(width * height), reference(width * height), scratch(width * height), decoded(width * height);
+    vector<XnUInt8> payload;
+    
+    // the codec on its own, keyframes against the left neighbour, deltas
+    // against the frame before
+    int counts[4] = { 0, 0, 0, 0 };
+    size_t encodedSize = 0;
+    bool codecLossless = true;
+    for (int f = 0; f < numFrames; f++) {
+        makeTestRecordingFrame(&expected[0], width, height, f);
+        bool keyframe = f % keyframeInterval == 0;
+        payload.clear();
+        mkDepthCodec::encode(&expected[0], keyframe ? NULL : &reference[0], width, height, payload, &scratch[0]);
+        countCodecTokens(payload, counts);
+        encodedSize += payload.size();
+        decoded = reference;
+        if (!mkDepthCodec::decode(&payload[0], payload.size(), keyframe ? NULL : &decoded[0], width, height, &decoded[0]) || decoded != expected)
+            codecLossless = false;
+        reference = expected;
+    }
+    ofLogNotice("benchmark") << "depth codec: " << (double)numFrames * width * height * sizeof(XnDepthPixel) / encodedSize << "x smaller, "
+                             << counts[0] << " zero runs, " << counts[1] << " long zero runs, " << counts[2] << " 8 bit and " << counts[3] << " 16 bit residual groups";
+    if (!codecLossless)
+        mkBenchmarkFailure() << "depth codec: a decoded frame differs from the encoded one";
+    if (counts[0] == 0 || counts[1] == 0 || counts[2] == 0 || counts[3] == 0)
+        mkBenchmarkFailure() << "depth codec: the test sequence misses a kind of token";
+    
+    mkDepthFramePool pool;
+    pool.setup(width, height);
+    mkDepthRecorder recorder;
+    XnFieldOfView fieldOfView = { 1.0144686707507438, 0.78980943449644714 };
+    if (!recorder.open(path, width, height, 10000, fieldOfView, keyframeInterval)) {
+        mkBenchmarkFailure() << "depth recording: could not record to " << path;
+        return;
+    }
+    mkKinectFrame frame;
+    frame.width = width;
+    frame.height = height;
+    for (int f = 0; f < numFrames; f++) {
+        frame.depth = pool.acquire();
+        makeTestRecordingFrame(frame.depth.getPixels(), width, height, f);
+        frame.sensorFrameID = f + 1;
+        frame.sensorTimestamp = f * 33333;
+        recorder.write(frame);
+    }
+    frame.depth.reset();
+    recorder.close();
+    
+    mkDepthPlayer player;
+    if (!player.open(path, true)) {
+        mkBenchmarkFailure() << "depth recording: could not replay " << path;
+        std::remove(ofToDataPath(path).c_str());
+        return;
+    }
+    auto readMatches = [&](int _frame) {
+        makeTestRecordingFrame(&expected[0], width, height, _frame);
+        return player.read(frame, pool) && frame.sensorFrameID == _frame + 1 &&
+            memcmp(frame.depth.getPixels(), &expected[0], expected.size() * sizeof(XnDepthPixel)) == 0;
+    };
+    
+    // in order, then into the middle of a keyframe group, ahead and back,
+    // and on from there
+    int numMismatches = 0;
+    for (int f = 0; f < numFrames; f++)
+        numMismatches += !readMatches(f);
+    const int seeks[3] = { 45, 17, 75 };
+    for (int i = 0; i < 3; i++) {
+        player.seek(seeks[i]);
+        for (int f = seeks[i]; f < seeks[i] + 3; f++)
+            numMismatches += !readMatches(f);
+    }
+    ofLogNotice("benchmark") << "depth recording: " << player.getNumFrames() << " frames replayed, " << numMismatches << " differ from the recorded ones";
+    if (player.getNumFrames() != numFrames || numMismatches > 0)
+        mkBenchmarkFailure() << "depth recording: replay is not lossless";
+    
+    player.seek(0);
+    double micros = mkBenchmark::run("depth replay, 640x480", numFrames * 3, [&] { player.read(frame, pool); });
+    ofLogNotice("benchmark") << "depth replay: " << 1000000.0 / micros << " frames per second, " << 1000000.0 / 30 / micros << "x real time";
+    player.close();
+    
+    // an index entry pointing past the end of the file, which the player
+    // must not trust; the scan finds every record again
+    mkDepthFileHeader fileHeader;
+    FILE* file = fopen(ofToDataPath(path).c_str(), "r+b");
+    if (file != NULL && fread(&fileHeader, sizeof(fileHeader), 1, file) == 1) {
+        XnUInt64 badOffset = fileHeader.indexOffset * 2;
+        fseek(file, fileHeader.indexOffset + 10 * sizeof(mkDepthIndexEntry), SEEK_SET);
+        fwrite(&badOffset, sizeof(badOffset), 1, file);
+    }
+    if (file != NULL)
+        fclose(file);
+    numMismatches = 0;
+    if (player.open(path, false)) {
+        for (int f = 0; f < numFrames; f++)
+            numMismatches += !readMatches(f);
+    }
+    ofLogNotice("benchmark") << "depth recording, damaged index: " << player.getNumFrames() << " frames replayed, " << numMismatches << " differ from the recorded ones";
+    if (player.getNumFrames() != numFrames || numMismatches > 0)
+        mkBenchmarkFailure() << "depth recording: a damaged index is not recovered";
+    
+    frame.depth.reset();
+    player.close();
+    std::remove(ofToDataPath(path).c_str());
+}
+
+//--------------------------------------------------------------
+static ofPoint testHandPosition(int _hand, double _seconds) {
+    // circles of 300 mm at half a turn per second, one per hand
+    double angle = _seconds * PI + _hand;
+    return ofPoint(300 * cos(angle) + _hand * 100, 300 * sin(angle), 1500 + _hand * 20);
+}
+
+//--------------------------------------------------------------
+static void makeTestHands(vector<mkTrackedHand>& _hands, int _numHands, int _frame, XnUInt64 _timestampMicros) {
+    _hands.resize(_numHands);
+    for (int i = 0; i < _numHands; i++) {
+        _hands[i].id = i + 1;
+        _hands[i].worldPosition = testHandPosition(i, _timestampMicros / 1000000.0);
+        // +-10 mm of repeatable sensor noise per axis
+        for (int a = 0; a < 3; a++)
+            _hands[i].worldPosition[a] += ((_frame * 7919 + i * 104729 + a * 1299709) % 2001) / 100.0f - 10;
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkHandFilter() {
+    const int numHands = 16, numFrames = 300;
+    const XnUInt64 frameMicros = 33333, leadMicros = 33333;
+    vector<mkTrackedHand> hands, predicted;
+    hands.reserve(numHands);
+    predicted.reserve(numHands);
+    
+    for (int m = 0; m < MK_HAND_FILTER_NUM_MODES; m++) {
+        mkHandFilterMode mode = (mkHandFilterMode)m;
+        mkHandFilter filter;
+        filter.setMode(mode);
+        filter.setup(numHands);
+        
+        // error against where the hand is one latency after the sample
+        double squaredError = 0;
+        int numErrors = 0;
+        for (int f = 0; f < numFrames; f++) {
+            XnUInt64 timestamp = (f + 1) * frameMicros;
+            makeTestHands(hands, numHands, f, timestamp);
+            filter.update(hands, timestamp);
+            mkHandFilter::predict(hands, mode == MK_HAND_FILTER_NONE ? 0 : leadMicros, predicted);
+            if (f < 30)
+                continue;
+            for (int i = 0; i < numHands; i++) {
+                squaredError += predicted[i].worldPosition.squareDistance(testHandPosition(i, (timestamp + leadMicros) / 1000000.0));
+                numErrors++;
+            }
+        }
+        
+        int frame = 0;
+        mkBenchmark::run("hand filter " + mkHandFilter::getModeName(mode) + ", 16 hands", 1000, [&] {
+            XnUInt64 timestamp = (numFrames + ++frame) * frameMicros;
+            makeTestHands(hands, numHands, frame, timestamp);
+            filter.update(hands, timestamp);
+        });
+        ofLogNotice("benchmark") << "hand filter " << mkHandFilter::getModeName(mode) << ": " << sqrt(squaredError / numErrors)
+                                 << " mm rms error " << leadMicros / 1000 << " ms ahead";
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkHandForces() {
+    // one hand on a 640x480 sensor over a 160x120 flow grid, the cells of
+    // its splat keep velocity over density at the hand's velocity
+    const int flowWidth = 160, flowHeight = 120;
+    mkHandForces forces;
+    forces.setup(flowWidth, flowHeight, MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT);
+    float velocityStrength = forces.parameters.getFloat("velocity strength");
+    auto peak = [&](int& _x, int& _y) {
+        float best = 0;
+        for (int i = 0; i < flowWidth * flowHeight; i++)
+            if (forces.getDensity()[i * 4 + 3] > best) {
+                best = forces.getDensity()[i * 4 + 3];
+                _x = i % flowWidth;
+                _y = i / flowWidth;
+            }
+        return best;
+    };
+    
+    vector<mkTrackedHand> hands(1);
+    hands[0].id = 3;
+    hands[0].position.set(320, 240, 1500);
+    forces.update(hands, 1000000);
+    // 32 pixels right and 24 down in 100 ms
+    ofVec2f delta(32.0f / MK_DEPTH_WIDTH, 24.0f / MK_DEPTH_HEIGHT);
+    hands[0].position.set(352, 264, 1500);
+    forces.update(hands, 1100000);
+    
+    int x = -1, y = -1;
+    float alpha = peak(x, y);
+    ofVec2f expectedCell(0.55f * flowWidth, 0.55f * flowHeight);
+    ofVec2f expected = delta / 0.1f * velocityStrength / forces.parameters.getFloat("density strength");
+    ofVec2f velocity(0, 0);
+    if (alpha > 0)
+        velocity.set(forces.getVelocity()[(y * flowWidth + x) * 2] / alpha, forces.getVelocity()[(y * flowWidth + x) * 2 + 1] / alpha);
+    ofLogNotice("benchmark") << "hand forces: splat at " << x << "," << y << ", expected " << expectedCell << ", velocity " << velocity << ", expected " << expected;
+    if (!(alpha > 0) || fabsf(x + 0.5f - expectedCell.x) > 1 || fabsf(y + 0.5f - expectedCell.y) > 1)
+        mkBenchmarkFailure() << "hand forces: the splat is not where the hand is";
+    if (!(velocity.distance(expected) < expected.length() * 1e-3f))
+        mkBenchmarkFailure() << "hand forces: the velocity is not the hand's";
+    
+    // once tracking stopped, the id starts over without velocity
+    mkHandEventBatch batch;
+    mkHandEvent stopped;
+    stopped.status = HAND_TRACKING_STOPPED;
+    stopped.id = hands[0].id;
+    stopped.deviceIndex = 0;
+    stopped.sensorTimestamp = 1150000;
+    batch.events.push_back(stopped);
+    forces.handEvent(batch);
+    hands[0].position.set(160, 120, 1500);
+    forces.update(hands, 1200000);
+    float speed = 0;
+    for (int i = 0; i < flowWidth * flowHeight * 2; i++)
+        speed = MAX(speed, fabsf(forces.getVelocity()[i]));
+    alpha = peak(x, y);
+    ofLogNotice("benchmark") << "hand forces: after tracking stopped, splat at " << x << "," << y << ", velocity up to " << speed;
+    if (!(alpha > 0) || speed != 0)
+        mkBenchmarkFailure() << "hand forces: a stopped hand keeps its last position";
+    
+    // 16 hands moving on the circles of the hand filter benchmark
+    vector<mkTrackedHand> manyHands;
+    int frame = 0;
+    mkBenchmark::run("hand forces, 16 hands", 1000, [&] {
+        XnUInt64 timestamp = ++frame * 33333;
+        makeTestHands(manyHands, 16, frame, timestamp);
+        for (int i = 0; i < manyHands.size(); i++)
+            manyHands[i].position.set(320 + manyHands[i].worldPosition.x * 0.4f, 240 + manyHands[i].worldPosition.y * 0.4f, manyHands[i].worldPosition.z);
+        forces.update(manyHands, timestamp);
+    });
+}
+
+//--------------------------------------------------------------
+static ofPoint testGesturePosition(int _gesture, double _seconds, float& _duration) {
+    // a hand at rest, the gesture from 0.5 s on, then rest again for 0.3 s;
+    // MK_GESTURE_NUM_TYPES is a figure eight, it turns both ways and is no
+    // gesture
+    ofPoint rest(0, 0, 1500);
+    double t = _seconds - 0.5;
+    switch (_gesture) {
+        case MK_GESTURE_PUSH: {
+            _duration = 0.3;
+            double s = ofClamp(t / _duration, 0, 1);
+            return rest + ofPoint(0, 0, -200 * s * s * (3 - 2 * s));
+        }
+        case MK_GESTURE_SWIPE_LEFT:
+        case MK_GESTURE_SWIPE_RIGHT:
+        case MK_GESTURE_SWIPE_UP:
+        case MK_GESTURE_SWIPE_DOWN: {
+            _duration = 0.4;
+            double s = ofClamp(t / _duration, 0, 1);
+            float d = 400 * s * s * (3 - 2 * s);
+            ofPoint directions[4] = { ofPoint(-d, 0, 0), ofPoint(d, 0, 0), ofPoint(0, d, 0), ofPoint(0, -d, 0) };
+            return rest + directions[_gesture - MK_GESTURE_SWIPE_LEFT];
+        }
+        case MK_GESTURE_CIRCLE: {
+            // 150 mm, a turn and a quarter at 1.2 s per turn
+            _duration = 1.5;
+            double angle = ofClamp(t / _duration, 0, 1) * 2.5 * PI;
+            return rest + ofPoint(150 * cos(angle) - 150, 150 * sin(angle), 0);
+        }
+        case MK_GESTURE_HOLD:
+            _duration = 1.2;
+            return rest;
+        default:
+            _duration = 2.5;
+            return rest + ofPoint(150 * sin(2.0 * _seconds), 60 * sin(4.0 * _seconds), 40 * sin(1.7 * _seconds));
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkGestureEngine() {
+    const XnUInt64 frameMicros = 33333;
+    
+    // recorded trajectories, one hand per gesture and all at once, played
+    // back through the engine
+    int numTrajectories = MK_GESTURE_NUM_TYPES + 1;
+    vector<vector<ofPoint> > recorded(numTrajectories);
+    int numFrames = 0;
+    for (int g = 0; g < numTrajectories; g++) {
+        float duration = 0;
+        testGesturePosition(g, 0, duration);
+        int frames = (0.5 + duration + 0.3) * 30;
+        for (int f = 0; f < frames; f++) {
+            float unused;
+            recorded[g].push_back(testGesturePosition(g, f / 30.0, unused));
+            // +-1.5 mm of repeatable noise left after the hand filter
+            for (int a = 0; a < 3; a++)
+                recorded[g].back()[a] += ((f * 7919 + g * 104729 + a * 1299709) % 301) / 100.0f - 1.5f;
+        }
+        numFrames = MAX(numFrames, frames);
+    }
+    
+    mkGestureEngine engine;
+    engine.setup(numTrajectories);
+    vector<mkTrackedHand> hands;
+    vector<mkGestureEvent> events;
+    vector<vector<mkGestureType> > recognised(numTrajectories);
+    for (int f = 0; f < numFrames; f++) {
+        hands.clear();
+        for (int g = 0; g < numTrajectories; g++) {
+            if (f >= recorded[g].size())
+                continue;
+            mkTrackedHand hand;
+            hand.id = g + 1;
+            hand.worldPosition = recorded[g][f];
+            hands.push_back(hand);
+        }
+        engine.update(hands, (f + 1) * frameMicros, events);
+        for (int i = 0; i < events.size(); i++)
+            recognised[events[i].id - 1].push_back(events[i].type);
+    }
+    for (int g = 0; g < numTrajectories; g++) {
+        string expected = g < MK_GESTURE_NUM_TYPES ? mkGestureEngine::getGestureName((mkGestureType)g) : "nothing";
+        string found;
+        for (int i = 0; i < recognised[g].size(); i++)
+            found += (i ? ", " : "") + mkGestureEngine::getGestureName(recognised[g][i]);
+        if (g < MK_GESTURE_NUM_TYPES ? recognised[g].size() != 1 || recognised[g][0] != g : !recognised[g].empty())
+            mkBenchmarkFailure() << "gestures: expected " << expected << ", recognised " << (found.empty() ? "nothing" : found);
+    }
+    
+    // every hand circles, the most expensive case; the cost should grow
+    // linearly with the hands
+    for (int numHands = 1; numHands <= 64; numHands *= 4) {
+        mkGestureEngine timedEngine;
+        timedEngine.setup(numHands);
+        int frame = 0;
+        double micros = mkBenchmark::run("gestures, " + ofToString(numHands) + " hands", 2000, [&] {
+            XnUInt64 timestamp = ++frame * frameMicros;
+            makeTestHands(hands, numHands, frame, timestamp);
+            timedEngine.update(hands, timestamp, events);
+        });
+        ofLogNotice("benchmark") << "gestures: " << micros / numHands << " us per hand";
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkStage() {
+    // two mock sensors side by side, the default calibration, both facing
+    // a wall 2.5 m away
+    const int width = 640, height = 480, fieldWidth = 160, fieldHeight = 90;
+    XnFieldOfView fieldOfView = { 1.0144686707507438, 0.78980943449644714 };
+    mkDepthRays rays;
+    rays.setup(width, height, fieldOfView);
+    vector<XnDepthPixel> depth(width * height, 2500);
+    mkDepthPyramid pyramids[2];
+    for (int i = 0; i < 2; i++) {
+        pyramids[i].setup(width, height);
+        pyramids[i].update(&depth[0]);
+    }
+    
+    mkStage stage;
+    stage.setup(2, fieldWidth, fieldHeight, width, height);
+    
+    // a hand at the stage centre is in both views, 750 mm off each axis
+    vector<mkTrackedHand> deviceHands(1), stageHands;
+    stageHands.reserve(4);
+    for (int i = 0; i < 2; i++) {
+        deviceHands[0].id = 1;
+        deviceHands[0].worldPosition.set(i == 0 ? 750 : -750, 0, 1500);
+        stage.mapHands(i, deviceHands, stageHands);
+    }
+    stage.mergeHands(stageHands);
+    if (stageHands.size() != 1 || fabsf(stageHands[0].position.x - fieldWidth / 2) > 0.5f || fabsf(stageHands[0].position.y - fieldHeight / 2) > 0.5f)
+        mkBenchmarkFailure() << "stage: the hand in the overlap did not merge into one at the centre";
+    
+    int covered[2] = { 0, 0 };
+    for (int n = 1; n <= 2; n++) {
+        double micros = mkBenchmark::run("stage stitch, " + ofToString(n) + (n == 1 ? " device" : " devices"), 200, [&] {
+            stage.clearField();
+            for (int i = 0; i < n; i++)
+                stage.addDepth(i, pyramids[i], rays);
+        });
+        for (int i = 0; i < fieldWidth * fieldHeight; i++)
+            covered[n - 1] += stage.getField()[i] > 0;
+        ofLogNotice("benchmark") << "stage stitch, " << n << (n == 1 ? " device: " : " devices: ") << 100 * covered[n - 1] / (fieldWidth * fieldHeight)
+                                 << "% of the field covered, " << micros / n << " us per device";
+    }
+    if (covered[1] <= covered[0])
+        mkBenchmarkFailure() << "stage: the second device added nothing";
+}
+
+//--------------------------------------------------------------
+template<typename Q>
+static void transferEvents(Q& _queue, int _count) {
+    // a producer thread against this one as the consumer, both retry
+    std::thread producer([&] {
+        mkHandEvent event;
+        event.status = HAND_TRACKING_UPDATED;
+        for (int i = 0; i < _count; i++) {
+            event.id = i;
+            while (_queue.push(event) != XN_STATUS_OK)
+                std::this_thread::yield();
+        }
+    });
+    mkHandEvent event;
+    for (int received = 0; received < _count;) {
+        if (_queue.pop(event) == XN_STATUS_OK) {
+            if (event.id != received)
+                mkBenchmarkFailure() << "hand events: out of order";
+            received++;
+        }
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+}
+
+//--------------------------------------------------------------
+struct mkLockedEventQueue {
+    mkLockedEventQueue()                            { queue.Init(); }
+    XnStatus push(const mkHandEvent& _event)        { return queue.Push(_event); }
+    XnStatus pop(mkHandEvent& _event)               { return queue.Pop(_event); }
+    mkHandEventQueue    queue;
+};
+
+//--------------------------------------------------------------
+static void benchmarkSpscRing() {
+    const int count = 100000;
+    mkLockedEventQueue lockedQueue;
+    mkSpscRing<mkHandEvent, MK_HAND_EVENT_CAPACITY> ring;
+    
+    double locked = mkBenchmark::run("100k hand events, XnThreadSafeQueue", 5, [&] {
+        transferEvents(lockedQueue, count);
+    });
+    double lockFree = mkBenchmark::run("100k hand events, spsc ring", 5, [&] {
+        transferEvents(ring, count);
+    });
+    mkBenchmark::report("hand event hand-off speed up", locked, lockFree);
+    
+    // the capture thread never retries, a consumer that stops taking
+    // events only costs the overflow
+    mkSpscRing<mkHandEvent, MK_HAND_EVENT_CAPACITY> fullRing;
+    mkHandEvent event;
+    for (int i = 0; i < MK_HAND_EVENT_CAPACITY + 10; i++)
+        fullRing.push(event);
+    if (fullRing.size() != MK_HAND_EVENT_CAPACITY || fullRing.getNumDropped() != 10)
+        mkBenchmarkFailure() << "spsc ring: expected a full ring and 10 drops";
+}
+
+//--------------------------------------------------------------
+// a console stand-in, a flushed line per message into a temporary file
+class mkTestLogTarget : public ofBaseLoggerChannel {
+public:
+    mkTestLogTarget() : file(tmpfile()), numMessages(0) {}
+    ~mkTestLogTarget()          { if (file) fclose(file); }
+    
+    void log(ofLogLevel _level, const string& _module, const string& _message) {
+        if (file) {
+            fprintf(file, "[%s] %s: %s\n", ofGetLogLevelName(_level).c_str(), _module.c_str(), _message.c_str());
+            fflush(file);
+        }
+        numMessages++;
+    }
+    void log(ofLogLevel _level, const string& _module, const char* _format, ...) {}
+    void log(ofLogLevel _level, const string& _module, const char* _format, va_list _args) {}
+    
+    FILE*               file;
+    std::atomic<int>    numMessages;
+};
+
+//--------------------------------------------------------------
+static void benchmarkLogChannel() {
+    // a frame that logs a burst of hand events, timed on the logging
+    // thread only; the writer catches up between frames
+    const int numFrames = 50, numMessages = 100;
+    shared_ptr<mkTestLogTarget> target = make_shared<mkTestLogTarget>();
+    mkLogChannel channel;
+    channel.setup(target);
+    unsigned long long direct = 0, queued = 0;
+    for (int f = 0; f < numFrames; f++) {
+        unsigned long long start = ofGetElapsedTimeMicros();
+        for (int i = 0; i < numMessages; i++)
+            target->log(OF_LOG_NOTICE, "ofApp", "hand tracking started for hand " + ofToString(i) + " from device 0");
+        direct += ofGetElapsedTimeMicros() - start;
+        
+        start = ofGetElapsedTimeMicros();
+        for (int i = 0; i < numMessages; i++)
+            channel.log(OF_LOG_NOTICE, "ofApp", "hand tracking started for hand " + ofToString(i) + " from device 0");
+        queued += ofGetElapsedTimeMicros() - start;
+        ofSleepMillis(20);
+    }
+    channel.close();
+    double directMicros = double(direct) / (numFrames * numMessages);
+    double queuedMicros = double(queued) / (numFrames * numMessages);
+    ofLogNotice("benchmark") << "log message, written on the caller: " << directMicros << " us";
+    ofLogNotice("benchmark") << "log message, queued for the writer: " << queuedMicros << " us";
+    mkBenchmark::report("log message speed up on the caller", directMicros, queuedMicros);
+    if (target->numMessages != 2 * numFrames * numMessages || channel.getNumDropped() != 0)
+        mkBenchmarkFailure() << "log channel: " << target->numMessages << " messages written, " << channel.getNumDropped() << " dropped";
+    
+    // producers that retry on overflow, the writer sees every message of
+    // each producer once and in order
+    const int numProducers = 3, count = 100000;
+    mkMpscRing<int, 256> ring;
+    vector<std::thread> producers;
+    for (int p = 0; p < numProducers; p++)
+        producers.push_back(std::thread([&ring, p] {
+            for (int i = 0; i < count; i++)
+                while (ring.push(p * count + i) != XN_STATUS_OK)
+                    std::this_thread::yield();
+        }));
+    vector<int> next(numProducers, 0);
+    int received = 0, value;
+    while (received < numProducers * count) {
+        if (ring.pop(value) != XN_STATUS_OK) {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = value / count;
+        if (value % count != next[p]++)
+            mkBenchmarkFailure() << "mpsc ring: out of order from producer " << p;
+        received++;
+    }
+    for (int p = 0; p < numProducers; p++)
+        producers[p].join();
+}
+
+//--------------------------------------------------------------
+static void benchmarkIdMap() {
+    for (int numIDs = 2; numIDs <= 64; numIDs *= numIDs == 2 ? 8 : 4) {
+        // a frame looks up every hand once, one hand leaves and a new one
+        // comes, with ids counting up like NITE's
+        vector<XnUserID> ids(numIDs);
+        XnUserID nextID = 1;
+        for (int i = 0; i < numIDs; i++)
+            ids[i] = nextID++;
+        vector<XnUserID> scanIDs(ids);
+        vector<mkTestHandState> scanStates(numIDs);
+        mkTestHandStateHash hash;
+        mkIdMap<mkTestHandState> map;
+        map.setup(numIDs);
+        
+        float sum = 0;
+        int frame = 0;
+        string name = ofToString(numIDs) + " ids";
+        double scan = mkBenchmark::run("id lookup, linear scan, " + name, 20000, [&] {
+            for (int i = 0; i < numIDs; i++)
+                for (int j = 0; j < numIDs; j++)
+                    if (scanIDs[j] == ids[i]) {
+                        sum += scanStates[j].values[0]++;
+                        break;
+                    }
+            // a leaving hand is replaced in place
+            int leaving = frame++ % numIDs;
+            ids[leaving] = scanIDs[leaving] = nextID++;
+        });
+        for (int i = 0; i < numIDs; i++)
+            hash.Set(ids[i], mkTestHandState());
+        double xnHash = mkBenchmark::run("id lookup, XnHash, " + name, 20000, [&] {
+            for (int i = 0; i < numIDs; i++) {
+                mkTestHandState* state;
+                if (hash.Get(ids[i], state) == XN_STATUS_OK)
+                    sum += state->values[0]++;
+            }
+            int leaving = frame++ % numIDs;
+            hash.Remove(ids[leaving]);
+            ids[leaving] = nextID++;
+            hash.Set(ids[leaving], mkTestHandState());
+        });
+        // the ids have moved on while XnHash ran
+        map.clear();
+        for (int i = 0; i < numIDs; i++)
+            map.insert(ids[i]);
+        double flat = mkBenchmark::run("id lookup, flat map, " + name, 20000, [&] {
+            for (int i = 0; i < numIDs; i++) {
+                mkTestHandState* state = map.find(ids[i]);
+                if (state)
+                    sum += state->values[0]++;
+            }
+            int leaving = frame++ % numIDs;
+            map.erase(ids[leaving]);
+            ids[leaving] = nextID++;
+            map.insert(ids[leaving]);
+        });
+        mkBenchmark::report("id lookup flat map over XnHash, " + name, xnHash, flat);
+        mkBenchmark::report("id lookup flat map over linear scan, " + name, scan, flat);
+        
+        for (int i = 0; i < numIDs; i++)
+            if (map.find(ids[i]) == NULL)
+                mkBenchmarkFailure() << "id map: lost id " << ids[i];
+        if (map.size() != numIDs || sum == 0)
+            mkBenchmarkFailure() << "id map: " << map.size() << " entries, expected " << numIDs;
+    }
+}
+
+//--------------------------------------------------------------
+static void writeTestFrame(mkSharedState& _state, const vector<mkTrackedHand>& _hands, unsigned long long _frameIndex, int _numCells) {
+    mkSharedFrame& frame = _state.frame;
+    uint32_t sequence = _state.beginWrite();
+    frame.frameIndex = _frameIndex;
+    mkStatePublisher::writeHands(frame, _hands, MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT);
+    // every value of the field carries the frame, a torn read mixes them
+    for (int i = 0; i < _numCells * 2; i++)
+        frame.velocity[i] = _frameIndex;
+    for (int i = 0; i < _numCells * 4; i++)
+        frame.density[i] = _frameIndex;
+    _state.endWrite(sequence);
+}
+
+//--------------------------------------------------------------
+static void benchmarkSharedState() {
+    // the app's field, 160 x 90 flow reduced by 4
+    const int numCells = 40 * 22;
+    mkSharedMemory writerMemory, readerMemory;
+    if (!writerMemory.create("marblingKinectBenchmark", sizeof(mkSharedState)) || !readerMemory.open("marblingKinectBenchmark")) {
+        mkBenchmarkFailure() << "shared state: can not map the segment";
+        return;
+    }
+    // two mappings of the same memory, as the app and a reader process see it
+    mkSharedState& writer = *(mkSharedState*)writerMemory.getWritableData();
+    const mkSharedState& reader = *(const mkSharedState*)readerMemory.getData();
+    writer.magic = MK_SHARED_STATE_MAGIC;
+    writer.version = MK_SHARED_STATE_VERSION;
+    writer.size = sizeof(mkSharedState);
+    if (!reader.isCompatible())
+        mkBenchmarkFailure() << "shared state: the reader does not see the header";
+    
+    vector<mkTrackedHand> hands;
+    makeTestHands(hands, 8, 0, 0);
+    unsigned long long frameIndex = 0;
+    mkBenchmark::run("shared state, publish 8 hands and the field", 20000, [&] {
+        writeTestFrame(writer, hands, ++frameIndex, numCells);
+    });
+    float sum = 0;
+    mkBenchmark::run("shared state, read the hands in place", 20000, [&] {
+        uint32_t sequence;
+        float handSum;
+        do {
+            sequence = reader.beginRead();
+            handSum = 0;
+            for (int i = 0; i < reader.frame.numHands; i++)
+                handSum += reader.frame.hands[i].id;
+        } while (reader.retryRead(sequence));
+        sum += handSum;
+    });
+    
+    // a writer thread publishes as fast as it can while this one reads the
+    // whole frame; every accepted read has to be of one frame
+    std::atomic<bool> done(false);
+    std::thread publisher([&] {
+        while (!done.load(std::memory_order_relaxed))
+            writeTestFrame(writer, hands, ++frameIndex, numCells);
+    });
+    int numReads = 20000, numTorn = 0, numRetries = 0;
+    for (int r = 0; r < numReads; r++) {
+        uint32_t sequence;
+        float first, last;
+        unsigned long long index;
+        for (;;) {
+            sequence = reader.beginRead();
+            index = reader.frame.frameIndex;
+            first = reader.frame.velocity[0];
+            last = reader.frame.density[numCells * 4 - 1];
+            if (!reader.retryRead(sequence))
+                break;
+            // lets the writer finish on a single core
+            numRetries++;
+            std::this_thread::yield();
+        }
+        if (first != last || first != (float)index)
+            numTorn++;
+        if (r % 64 == 0)
+            std::this_thread::yield();
+    }
+    done = true;
+    publisher.join();
+    ofLogNotice("benchmark") << "shared state: " << numReads << " reads against a writer, " << numRetries << " retried, " << numTorn << " torn";
+    if (numTorn > 0 || sum == 0)
+        mkBenchmarkFailure() << "shared state: a torn frame got through";
+    mkSharedMemory::remove("marblingKinectBenchmark");
+}
+
+//--------------------------------------------------------------
+static void makeTestPacketStream(mkUsbLoopback& _stream, vector<vector<XnDepthPixel> >& _frames, int _numFrames) {
+    // two disparity images taking turns, packets spread evenly over each
+    // frame's 33 ms as the camera sends them
+    _frames.resize(2);
+    for (int f = 0; f < 2; f++) {
+        makeTestDepth(_frames[f], MK_DEPTH_WIDTH, MK_DEPTH_HEIGHT);
+        for (int i = 0; i < _frames[f].size(); i++)
+            _frames[f][i] = _frames[f][i] == XN_DEPTH_NO_SAMPLE_VALUE ? MK_DEPTH_NO_READING : (_frames[f][i] / 3 + i * f) % 2000;
+    }
+    _stream.clear();
+    XnUInt8 sequence = 0;
+    vector<XnUInt8> packets;
+    vector<int> lengths;
+    for (int f = 0; f < _numFrames; f++) {
+        packets.clear();
+        lengths.clear();
+        mkDepthPacketAssembler::packFrame(&_frames[f % 2][0], sequence, f * 1000, packets, lengths);
+        size_t offset = 0;
+        for (int p = 0; p < lengths.size(); p++) {
+            _stream.addPacket(&packets[offset], lengths[p], f * 33333ULL + p * 33333ULL / lengths.size());
+            offset += lengths[p];
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static unsigned long long waitForUsbFrames(mkUsbIngest& _ingest, unsigned long long _numFrames, int _idleMillis) {
+    // until the frame count is reached or nothing came for a while
+    unsigned long long frameIndex = 0, lastChange = ofGetElapsedTimeMillis();
+    while (frameIndex < _numFrames && ofGetElapsedTimeMillis() - lastChange < _idleMillis) {
+        if (_ingest.update()) {
+            frameIndex = _ingest.getFrame().frameIndex;
+            lastChange = ofGetElapsedTimeMillis();
+        }
+        else
+            ofSleepMillis(1);
+    }
+    return frameIndex;
+}
+
+//--------------------------------------------------------------
+static void benchmarkUsbIngest() {
+    const int numFrames = 30;
+    mkUsbLoopback stream;
+    vector<vector<XnDepthPixel> > frames;
+    makeTestPacketStream(stream, frames, numFrames);
+    
+    // one frame's packets, copied into a packed frame and unpacked bit by
+    // bit afterwards, against unpacking each packet into the pooled buffer
+    vector<XnUInt8> packets;
+    vector<int> lengths;
+    XnUInt8 sequence = 0;
+    mkDepthPacketAssembler::packFrame(&frames[0][0], sequence, 0, packets, lengths);
+    vector<XnUInt8> packed(MK_DEPTH_FRAME_BYTES);
+    vector<XnDepthPixel> unpacked(MK_DEPTH_WIDTH * MK_DEPTH_HEIGHT);
+    double copied = mkBenchmark::run("depth packets, copy the frame then unpack", 100, [&] {
+        size_t offset = 0, n = 0;
+        for (int p = 0; p < lengths.size(); p++) {
+            memcpy(&packed[n], &packets[offset + MK_PACKET_HEADER_SIZE], lengths[p] - MK_PACKET_HEADER_SIZE);
+            n += lengths[p] - MK_PACKET_HEADER_SIZE;
+            offset += lengths[p];
+        }
+        XnUInt32 bits = 0;
+        int numBits = 0, i = 0;
+        for (int b = 0; b < MK_DEPTH_FRAME_BYTES; b++) {
+            bits = (bits << 8) | packed[b];
+            numBits += 8;
+            if (numBits >= 11) {
+                numBits -= 11;
+                unpacked[i++] = (bits >> numBits) & 0x7ff;
+            }
+        }
+    });
+    mkDepthPacketAssembler assembler;
+    assembler.setup();
+    int numAssembled = 0;
+    double direct = mkBenchmark::run("depth packets, unpack into the pool", 100, [&] {
+        size_t offset = 0;
+        for (int p = 0; p < lengths.size(); p++) {
+            // the same frame again, so every packet keeps its sequence
+            XnUInt8 packet[MK_DEPTH_PACKET_SIZE];
+            memcpy(packet, &packets[offset], lengths[p]);
+            packet[5] = (XnUInt8)(numAssembled * lengths.size() + p);
+            numAssembled += assembler.addPacket(packet, lengths[p]);
+            offset += lengths[p];
+        }
+    });
+    mkBenchmark::report("depth packet reassembly speed up", copied, direct);
+    assembler.update();
+    if (numAssembled != 101 || assembler.getNumLostPackets() != 0 || memcmp(assembler.getFrame().depth.getPixels(), &frames[0][0], unpacked.size() * sizeof(XnDepthPixel)) != 0 || unpacked != frames[0])
+        mkBenchmarkFailure() << "depth packets: frames do not come out as they went in";
+    
+    // the whole stream through the transfer ring, as fast as it goes
+    stream.setup(false);
+    mkUsbIngest ingest;
+    ingest.setup(&stream, 16, 16);
+    unsigned long long start = ofGetElapsedTimeMicros();
+    ingest.start();
+    unsigned long long received = waitForUsbFrames(ingest, numFrames, 500);
+    double micros = double(ofGetElapsedTimeMicros() - start) / MAX(received, 1ULL);
+    ingest.stop();
+    ofLogNotice("benchmark") << "usb ingest, loopback as fast as possible: " << micros << " us per frame, " << (MK_DEPTH_FRAME_BYTES / micros) << " MB/s";
+    if (received != numFrames || ingest.getAssembler().getNumDroppedFrames() != 0 || memcmp(ingest.getFrame().depth.getPixels(), &frames[(numFrames - 1) % 2][0], unpacked.size() * sizeof(XnDepthPixel)) != 0)
+        mkBenchmarkFailure() << "usb ingest: " << received << " of " << numFrames << " frames, " << ingest.getAssembler().getNumDroppedFrames() << " dropped";
+    
+    // paced like the camera: frame intervals for a short and a long ring
+    int rings[2][2] = { { 2, 8 }, { 16, 16 } };
+    for (int r = 0; r < 2; r++) {
+        stream.setup(true);
+        ingest.setup(&stream, rings[r][0], rings[r][1]);
+        ingest.start();
+        received = waitForUsbFrames(ingest, numFrames, 500);
+        ingest.stop();
+        ofLogNotice("benchmark") << "usb ingest, " << rings[r][0] << " transfers of " << rings[r][1] << " packets, realtime: frame interval " << ingest.getMeanInterval() << " us, deviation " << ingest.getIntervalDeviation() << " us, max " << ingest.getMaxInterval() << " us";
+        if (received != numFrames)
+            mkBenchmarkFailure() << "usb ingest, realtime: " << received << " of " << numFrames << " frames";
+    }
+    
+    // a lossy bus: frames that miss a packet are dropped, never passed on
+    stream.setup(false);
+    stream.setDropInterval(1000);
+    ingest.setup(&stream, 16, 16);
+    ingest.start();
+    waitForUsbFrames(ingest, numFrames, 200);
+    ingest.stop();
+    const mkDepthPacketAssembler& lossy = ingest.getAssembler();
+    int numDropped = stream.getNumPackets() / 1000;
+    ofLogNotice("benchmark") << "usb ingest, every 1000th packet lost: " << lossy.getNumFrames() << " frames, " << lossy.getNumDroppedFrames() << " dropped, " << lossy.getNumLostPackets() << " packets lost";
+    if (lossy.getNumLostPackets() != numDropped || lossy.getNumFrames() + lossy.getNumDroppedFrames() != numFrames || lossy.getNumDroppedFrames() == 0)
+        mkBenchmarkFailure() << "usb ingest: lost packets not accounted for";
+}
+
+//--------------------------------------------------------------
+struct mkTestForces {
+    ofFloatPixels   velocity;
+    ofFloatPixels   density;
+    ofFloatPixels   temperature;
+};
+
+//--------------------------------------------------------------
+static void makeTestForces(vector<mkTestForces>& _forces, int _width, int _height, int _numFrames) {
+    // a warm, coloured splat circling the centre, pushing along its path
+    _forces.resize(_numFrames);
+    float radius = _height * 0.08f;
+    for (int f = 0; f < _numFrames; f++) {
+        mkTestForces& forces = _forces[f];
+        forces.velocity.allocate(_width, _height, 2);
+        forces.density.allocate(_width, _height, 4);
+        forces.temperature.allocate(_width, _height, 1);
+        float angle = f * TWO_PI / _numFrames;
+        float cx = _width * (0.5f + 0.3f * cosf(angle)), cy = _height * (0.5f + 0.3f * sinf(angle));
+        for (int y = 0; y < _height; y++) {
+            for (int x = 0; x < _width; x++) {
+                int i = y * _width + x;
+                float g = expf(-((x - cx) * (x - cx) + (y - cy) * (y - cy)) / (radius * radius));
+                forces.velocity.getPixels()[i * 2] = -sinf(angle) * g;
+                forces.velocity.getPixels()[i * 2 + 1] = cosf(angle) * g;
+                float color[4] = { g, g * 0.5f, g * 0.2f, g };
+                for (int c = 0; c < 4; c++)
+                    forces.density.getPixels()[i * 4 + c] = color[c] * 0.1f;
+                forces.temperature.getPixels()[i] = g * 0.1f;
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+static float fieldRms(const mkFluidField& _field) {
+    double sum = 0;
+    for (int c = 0; c < _field.getNumChannels(); c++)
+        for (int y = 1; y < _field.getHeight() - 1; y++)
+            for (int x = 1; x < _field.getWidth() - 1; x++)
+                sum += _field.get(c, x, y) * _field.get(c, x, y);
+    return sqrt(sum / (_field.getNumChannels() * (_field.getWidth() - 2) * (_field.getHeight() - 2)));
+}
+
+//--------------------------------------------------------------
+static float fieldMaxDifference(const mkFluidField& _a, const mkFluidField& _b) {
+    float difference = 0;
+    for (int c = 0; c < _a.getNumChannels(); c++)
+        for (int y = 0; y < _a.getHeight(); y++)
+            for (int x = 0; x < _a.getWidth(); x++)
+                difference = MAX(difference, fabsf(_a.get(c, x, y) - _b.get(c, x, y)));
+    return difference;
+}
+
+//--------------------------------------------------------------
+static void benchmarkFluidSimulation() {
+    // the app's flow grid, 1280 x 720 / 8, with the settings.xml defaults
+    const int width = 160, height = 90, numFrames = 60;
+    vector<mkTestForces> forces;
+    makeTestForces(forces, width, height, numFrames);
+    
+    mkFluidSimulation scalar, simd, threaded;
+    scalar.setup(width, height, 1);
+    simd.setup(width, height, 1);
+    threaded.setup(width, height, 0);
+    int scalarFrame = 0, simdFrame = 0, threadedFrame = 0;
+    auto step = [&](mkFluidSimulation& _fluid, int& _frame) {
+        const mkTestForces& f = forces[_frame++ % numFrames];
+        _fluid.addVelocity(f.velocity);
+        _fluid.addDensity(f.density);
+        _fluid.addTemperature(f.temperature);
+        _fluid.update(1.0f / 60.0f);
+    };
+    
+    mkFluidKernels::setSimd(false);
+    double scalarMicros = mkBenchmark::run("fluid 160x90, scalar, 1 thread", numFrames - 1, [&] { step(scalar, scalarFrame); });
+    mkFluidKernels::setSimd(true);
+    double simdMicros = mkBenchmark::run("fluid 160x90, simd, 1 thread", numFrames - 1, [&] { step(simd, simdFrame); });
+    double threadedMicros = mkBenchmark::run("fluid 160x90, simd, all threads", numFrames - 1, [&] { step(threaded, threadedFrame); });
+    mkBenchmark::report("fluid simd speed up", scalarMicros, simdMicros);
+    mkBenchmark::report("fluid simd and threads speed up", scalarMicros, threadedMicros);
+    
+    // the same forces give the same fluid, up to rounding, which a few
+    // frames of vorticity would already amplify
+    mkFluidSimulation scalarCheck, simdCheck;
+    scalarCheck.setup(width, height, 1);
+    simdCheck.setup(width, height, 0);
+    int scalarCheckFrame = 0, simdCheckFrame = 0;
+    for (int i = 0; i < 4; i++) {
+        mkFluidKernels::setSimd(false);
+        step(scalarCheck, scalarCheckFrame);
+        mkFluidKernels::setSimd(true);
+        step(simdCheck, simdCheckFrame);
+    }
+    float velocityDifference = fieldMaxDifference(scalarCheck.getVelocity(), simdCheck.getVelocity());
+    float densityDifference = fieldMaxDifference(scalarCheck.getDensity(), simdCheck.getDensity());
+    float pressureDifference = fieldMaxDifference(scalarCheck.getPressure(), simdCheck.getPressure());
+    ofLogNotice("benchmark") << "fluid, scalar against simd: velocity " << velocityDifference << ", density " << densityDifference << ", pressure " << pressureDifference << " apart";
+    if (!(velocityDifference < 1e-3f) || !(densityDifference < 1e-3f) || !(pressureDifference < 1e-3f))
+        mkBenchmarkFailure() << "fluid: the simd and scalar kernels disagree";
+    
+    // projection takes out most of the divergence the forces put in
+    mkFluidField fluid, divergence;
+    fluid.allocate(width, height, 1);
+    divergence.allocate(width, height, 1);
+    mkFluidKernels::fluidMask(simd.getObstacle(), fluid, 0, height);
+    mkFluidKernels::divergence(simd.getVelocity(), fluid, 0.5f / simd.getCellSize(), divergence, 1, height - 1);
+    float before = fieldRms(simd.getDivergence()), after = fieldRms(divergence);
+    float speed = fieldRms(simd.getVelocity());
+    ofLogNotice("benchmark") << "fluid, divergence before projection " << before << ", after " << after << ", velocity " << speed;
+    if (!(after < before) || !(speed > 0) || speed > 10)
+        mkBenchmarkFailure() << "fluid: the projection does not hold";
+}
+
+//--------------------------------------------------------------
+static void benchmarkPressureSolvers() {
+    // the app's flow grid and two finer ones, each solving the divergence a
+    // few frames of circling forces around a post leave, from no pressure
+    const int sizes[3][2] = { { 160, 90 }, { 320, 180 }, { 640, 360 } };
+    for (int i = 0; i < 3; i++) {
+        int width = sizes[i][0], height = sizes[i][1];
+        string size = ofToString(width) + "x" + ofToString(height);
+        vector<mkTestForces> forces;
+        makeTestForces(forces, width, height, 10);
+        mkFluidSimulation simulation;
+        simulation.setup(width, height, 1);
+        // a post in the middle for the flow to go around
+        ofFloatPixels obstacle;
+        obstacle.allocate(width, height, 1);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                obstacle.getPixels()[y * width + x] = ofDist(x, y, width / 2, height / 2) < height * 0.1f ? 1 : 0;
+        simulation.addObstacle(obstacle);
+        for (int f = 0; f < forces.size(); f++) {
+            simulation.addVelocity(forces[f].velocity);
+            simulation.update(1.0f / 60.0f);
+        }
+        
+        const mkFluidField& divergence = simulation.getDivergence();
+        float alpha = -simulation.getCellSize() * simulation.getCellSize();
+        mkFluidField fluid, pressure, back, residual;
+        fluid.allocate(width, height, 1);
+        pressure.allocate(width, height, 1);
+        back.allocate(width, height, 1);
+        residual.allocate(width, height, 1);
+        mkFluidKernels::fluidMask(simulation.getObstacle(), fluid, 0, height);
+        auto residualRms = [&] {
+            mkFluidKernels::residual(pressure, divergence, fluid, alpha, residual, 1, height - 1);
+            return fieldRms(residual);
+        };
+        float start = residualRms();
+        
+        double jacobiMicros = mkBenchmark::run("pressure " + size + ", 40 jacobi sweeps", 10, [&] {
+            pressure.clear();
+            for (int j = 0; j < 40; j++) {
+                pressure.swap(back);
+                mkFluidKernels::jacobi(back, divergence, fluid, alpha, 1, pressure, 1, height - 1);
+            }
+        });
+        float jacobiResidual = residualRms();
+        
+        // as many cycles as it takes to do as well
+        mkWorkerPool pool;
+        mkFluidMultigrid multigrid;
+        multigrid.setup(width, height, &pool, 1);
+        int numCycles = 0;
+        float multigridResidual = start;
+        while (multigridResidual > jacobiResidual && numCycles < 10) {
+            numCycles++;
+            pressure.clear();
+            multigrid.solve(pressure, back, divergence, fluid, alpha, numCycles, numCycles);
+            multigridResidual = residualRms();
+        }
+        double multigridMicros = mkBenchmark::run("pressure " + size + ", " + ofToString(numCycles) + " multigrid cycles over " + ofToString(multigrid.getNumLevels()) + " levels", 10, [&] {
+            pressure.clear();
+            multigrid.solve(pressure, back, divergence, fluid, alpha, numCycles, numCycles);
+        });
+        ofLogNotice("benchmark") << "pressure " << size << ", residual " << start << " down to " << jacobiResidual << " by jacobi, " << multigridResidual << " by multigrid";
+        mkBenchmark::report("pressure " + size + " multigrid speed up", jacobiMicros, multigridMicros);
+        if (multigridResidual > jacobiResidual)
+            mkBenchmarkFailure() << "pressure " << size << ": multigrid does not reach the jacobi residual";
+        
+        pressure.clear();
+        multigrid.solve(pressure, back, divergence, fluid, alpha, 4, 4);
+        ofLogNotice("benchmark") << "pressure " << size << ", residual after 4 multigrid cycles " << residualRms();
+    }
+}
+
+//--------------------------------------------------------------
+static void benchmarkAdaptivePressure() {
+    // a second of circling forces, then, from rest, two seconds of faint ones
+    const int width = 160, height = 90, numBusyFrames = 60, numQuietFrames = 120;
+    vector<mkTestForces> forces;
+    makeTestForces(forces, width, height, numBusyFrames);
+    for (int s = 0; s < MK_PRESSURE_NUM_SOLVERS; s++) {
+        mkPressureSolver solver = (mkPressureSolver)s;
+        for (int adaptive = 0; adaptive < 2; adaptive++) {
+            mkFluidSimulation simulation;
+            simulation.setup(width, height, 1);
+            simulation.setPressureSolver(solver);
+            if (!adaptive)
+                simulation.setTolerance(0);
+            
+            double micros[2] = { 0, 0 };
+            int iterations[2] = { 0, 0 };
+            float residual[2] = { 0, 0 };
+            for (int f = 0; f < numBusyFrames + numQuietFrames; f++) {
+                int phase = f < numBusyFrames ? 0 : 1;
+                if (f == numBusyFrames)
+                    simulation.reset();
+                float strength = phase == 0 ? 1 : 0.01;
+                simulation.addVelocity(forces[f % numBusyFrames].velocity, strength);
+                simulation.addDensity(forces[f % numBusyFrames].density, strength);
+                unsigned long long start = ofGetElapsedTimeMicros();
+                simulation.update(1.0f / 60.0f);
+                micros[phase] += ofGetElapsedTimeMicros() - start;
+                iterations[phase] += simulation.getPressureIterations();
+                residual[phase] = MAX(residual[phase], simulation.getPressureResidual());
+            }
+            
+            string name = "pressure " + mkFluidSimulation::getPressureSolverName(solver) + (adaptive ? ", adaptive" : ", fixed");
+            ofLogNotice("benchmark") << name << ": busy " << micros[0] / numBusyFrames << " us, " << (float)iterations[0] / numBusyFrames << " iterations, residual up to " << residual[0]
+                << "; quiet " << micros[1] / numQuietFrames << " us, " << (float)iterations[1] / numQuietFrames << " iterations, residual up to " << residual[1];
+            if (!(residual[0] < 1) || !(residual[1] < 1))
+                mkBenchmarkFailure() << name << ": the pressure solve diverges";
+        }
+    }
+}
+
+//--------------------------------------------------------------
+struct mkTestPressureFrame {
+    mkFluidField    divergence;
+    mkFluidField    fluid;
+    mkFluidField    pressure;           // the first guess, last frame's faded
+    mkFluidField    solution;           // converged
+};
+
+//--------------------------------------------------------------
+static float pressureError(const mkFluidField& _pressure, const mkFluidField& _solution, const mkFluidField& _fluid) {
+    // pressure is only known up to a constant, compare without the mean
+    double mean = 0, numFluid = 0;
+    for (int y = 1; y < _fluid.getHeight() - 1; y++)
+        for (int x = 1; x < _fluid.getWidth() - 1; x++)
+            if (_fluid.get(0, x, y) > 0) {
+                mean += _pressure.get(0, x, y) - _solution.get(0, x, y);
+                numFluid++;
+            }
+    mean /= MAX(numFluid, 1.0);
+    double squared = 0;
+    for (int y = 1; y < _fluid.getHeight() - 1; y++)
+        for (int x = 1; x < _fluid.getWidth() - 1; x++)
+            if (_fluid.get(0, x, y) > 0) {
+                double error = _pressure.get(0, x, y) - _solution.get(0, x, y) - mean;
+                squared += error * error;
+            }
+    return sqrt(squared / MAX(numFluid, 1.0));
+}
+
+//--------------------------------------------------------------
+static void benchmarkPressureConvergence() {
+    // record every tenth frame the pressure step sees while circling forces
+    // stir the app's flow grid around a post, then give every solver the
+    // same frames at growing budgets; the recorded first guesses come from
+    // 40 Jacobi sweeps a frame, as the app would leave them
+    const int width = 160, height = 90, numFrames = 60;
+    // as on the simulation's bands
+    mkFlushDenormals flush;
+    vector<mkTestForces> forces;
+    makeTestForces(forces, width, height, numFrames);
+    ofFloatPixels obstacle;
+    obstacle.allocate(width, height, 1);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            obstacle.getPixels()[y * width + x] = ofDist(x, y, width / 2, height / 2) < height * 0.1f ? 1 : 0;
+    
+    mkFluidSimulation simulation;
+    simulation.setup(width, height, 1);
+    simulation.setTolerance(0);
+    simulation.addObstacle(obstacle);
+    vector<mkTestPressureFrame*> frames;
+    for (int f = 0; f < numFrames; f++) {
+        simulation.addVelocity(forces[f].velocity);
+        simulation.addDensity(forces[f].density);
+        simulation.addTemperature(forces[f].temperature);
+        mkTestPressureFrame* frame = f % 10 == 9 ? new mkTestPressureFrame() : NULL;
+        if (frame != NULL) {
+            frame->pressure.copyFrom(simulation.getPressure());
+            mkFluidKernels::scale(frame->pressure, 0.9f, 1, height - 1);
+        }
+        simulation.update(1.0f / 60.0f);
+        if (frame != NULL) {
+            frame->divergence.copyFrom(simulation.getDivergence());
+            frame->fluid.allocate(width, height, 1);
+            mkFluidKernels::fluidMask(simulation.getObstacle(), frame->fluid, 0, height);
+            frames.push_back(frame);
+        }
+    }
+    
+    float alpha = -simulation.getCellSize() * simulation.getCellSize();
+    mkFluidField pressure, back, residual;
+    pressure.allocate(width, height, 1);
+    back.allocate(width, height, 1);
+    residual.allocate(width, height, 1);
+    mkWorkerPool pool;
+    mkFluidMultigrid multigrid;
+    multigrid.setup(width, height, &pool, 1);
+    mkFluidConjugateGradient conjugateGradient;
+    conjugateGradient.setup(width, height, &pool, 1);
+    auto solve = [&](mkPressureSolver _solver, int _iterations, const mkTestPressureFrame& _frame) {
+        pressure.copyFrom(_frame.pressure);
+        if (_solver == MK_PRESSURE_JACOBI)
+            for (int i = 0; i < _iterations; i++) {
+                pressure.swap(back);
+                mkFluidKernels::jacobi(back, _frame.divergence, _frame.fluid, alpha, 1, pressure, 1, height - 1);
+            }
+        else if (_solver == MK_PRESSURE_SOR)
+            for (int i = 0; i < _iterations; i++) {
+                mkFluidKernels::sor(pressure, _frame.divergence, _frame.fluid, alpha, 1.8f, 0, 1, height - 1);
+                mkFluidKernels::sor(pressure, _frame.divergence, _frame.fluid, alpha, 1.8f, 1, 1, height - 1);
+            }
+        else if (_solver == MK_PRESSURE_MULTIGRID)
+            multigrid.solve(pressure, back, _frame.divergence, _frame.fluid, alpha, _iterations, _iterations);
+        else
+            conjugateGradient.solve(pressure, _frame.divergence, _frame.fluid, alpha, _iterations, _iterations);
+    };
+    for (int f = 0; f < frames.size(); f++) {
+        solve(MK_PRESSURE_MULTIGRID, 30, *frames[f]);
+        frames[f]->solution.copyFrom(pressure);
+    }
+    // in the units of the divergence, as mkFluidSimulation reports it
+    auto divergenceLeft = [&](const mkTestPressureFrame& _frame) {
+        double squared = mkFluidKernels::residual(pressure, _frame.divergence, _frame.fluid, alpha, residual, 1, height - 1);
+        return sqrt(squared / ((width - 2) * (height - 2))) / -alpha;
+    };
+    
+    const int budgets[MK_PRESSURE_NUM_SOLVERS][5] = {
+        { 10, 20, 40, 80, 160 },    // jacobi sweeps
+        { 1, 2, 3, 4, 6 },          // multigrid cycles
+        { 5, 10, 20, 40, 80 },      // sor sweeps, red and black
+        { 5, 10, 20, 40, 80 }       // conjugate gradient iterations
+    };
+    for (int s = 0; s < MK_PRESSURE_NUM_SOLVERS; s++) {
+        mkPressureSolver solver = (mkPressureSolver)s;
+        for (int b = 0; b < 5; b++) {
+            int iterations = budgets[s][b];
+            string name = "pressure " + mkFluidSimulation::getPressureSolverName(solver) + " x" + ofToString(iterations);
+            double micros = mkBenchmark::run(name, 4, [&] {
+                for (int f = 0; f < frames.size(); f++)
+                    solve(solver, iterations, *frames[f]);
+            }) / frames.size();
+            // the residual weighs the fine detail, the error the broad
+            // swells that local sweeps are slow to take out
+            double left = 0, error = 0, start = 0;
+            for (int f = 0; f < frames.size(); f++) {
+                solve(solver, iterations, *frames[f]);
+                left += divergenceLeft(*frames[f]);
+                error += pressureError(pressure, frames[f]->solution, frames[f]->fluid);
+                start += pressureError(frames[f]->pressure, frames[f]->solution, frames[f]->fluid);
+            }
+            ofLogNotice("benchmark") << name << ": " << micros << " us a frame, divergence left " << left / frames.size() << ", pressure error " << error / start * 100 << "% of the first guess";
+        }
+    }
+    
+    // the scalar paths agree with the simd ones
+    mkFluidField scalarPressure;
+    for (int s = 0; s < MK_PRESSURE_NUM_SOLVERS; s++) {
+        mkPressureSolver solver = (mkPressureSolver)s;
+        mkFluidKernels::setSimd(false);
+        solve(solver, 4, *frames.back());
+        scalarPressure.copyFrom(pressure);
+        mkFluidKernels::setSimd(true);
+        solve(solver, 4, *frames.back());
+        float difference = fieldMaxDifference(pressure, scalarPressure);
+        if (!(difference < 1e-4f))
+            mkBenchmarkFailure() << "pressure " << mkFluidSimulation::getPressureSolverName(solver) << ": the simd and scalar kernels are " << difference << " apart";
+    }
+    
+    for (int f = 0; f < frames.size(); f++)
+        delete frames[f];
+}
+
+//--------------------------------------------------------------
+// the reference for the fused and tiled steps: each step a pass of its own
+// over all rows on this thread, in the order they ran before they were
+// fused, with the Jacobi pressure solve running all its sweeps
+class mkUnfusedFluidSimulation : public mkFluidSimulation {
+public:
+    void updateUnfused(float _deltaTime) {
+        mkFlushDenormals flush;
+        float timeStep = _deltaTime * speed.get();
+        float halfInverseCell = 0.5f / cellSize.get();
+        float advectStep = timeStep / cellSize.get();
+        int y0 = 1, y1 = height - 1;
+        
+        mkFluidKernels::fluidMask(combinedObstacle, fluid, 0, height);
+        if (maxDensity.get() > 0)
+            mkFluidKernels::clampLength(density, maxDensity.get(), clampForce.get(), 0, height);
+        if (maxVelocity.get() > 0)
+            mkFluidKernels::clampLength(velocity, maxVelocity.get(), clampForce.get(), 0, height);
+        if (maxTemperature.get() > 0)
+            mkFluidKernels::clampLength(temperature, maxTemperature.get(), clampForce.get(), 0, height);
+        
+        if (vorticity.get() > 0) {
+            mkFluidKernels::curl(velocity, fluid, halfInverseCell, curl, y0, y1);
+            mkFluidKernels::confinement(curl, fluid, halfInverseCell, timeStep * vorticity.get(), velocity, confinement, y0, y1);
+        }
+        else
+            confinement.clear();
+        
+        velocity.swap(velocityBack);
+        mkFluidKernels::advect(velocityBack, velocityBack, fluid, advectStep, 1.0f - (dissipation.get() + velocityOffset.get()), velocity, y0, y1);
+        if (viscosity.get() > 0) {
+            float alpha = cellSize.get() * cellSize.get() / (viscosity.get() * timeStep);
+            float inverseBeta = 1.0f / (4.0f + alpha);
+            velocityStart.copyFrom(velocity);
+            for (int i = 0; i < numJacobiIterations.get(); i++) {
+                velocity.swap(velocityBack);
+                mkFluidKernels::diffuse(velocityBack, velocityStart, fluid, alpha, inverseBeta, velocity, y0, y1);
+            }
+        }
+        
+        if (smokeSigma.get() > 0 && smokeWeight.get() > 0) {
+            temperature.swap(temperatureBack);
+            mkFluidKernels::advect(velocity, temperatureBack, fluid, advectStep, 1.0f - (dissipation.get() + temperatureOffset.get()), temperature, y0, y1);
+            mkFluidKernels::clampLength(temperature, 2, 1, 0, height);
+            mkFluidKernels::buoyancy(temperature, density, fluid, ambientTemperature.get(), timeStep * smokeSigma.get(), smokeWeight.get(), gravity.get(), velocity, buoyancy, y0, y1);
+        }
+        else {
+            temperature.clear();
+            buoyancy.clear();
+        }
+        
+        float alpha = -cellSize.get() * cellSize.get();
+        mkFluidKernels::divergence(velocity, fluid, halfInverseCell, divergence, y0, y1);
+        mkFluidKernels::scale(pressure, 0.9f, y0, y1);
+        for (int i = 0; i < numJacobiIterations.get(); i++) {
+            pressure.swap(pressureBack);
+            mkFluidKernels::jacobi(pressureBack, divergence, fluid, alpha, 1, pressure, y0, y1);
+        }
+        mkFluidKernels::subtractGradient(pressure, fluid, halfInverseCell, velocity, y0, y1);
+        
+        density.swap(densityBack);
+        mkFluidKernels::advect(velocity, densityBack, fluid, advectStep, 1.0f - (dissipation.get() + densityOffset.get()), density, y0, y1);
+        if (densityFromPressure.get() != 0)
+            mkFluidKernels::multiplyByLength(density, pressure, densityFromPressure.get(), y0, y1);
+        if (densityFromVorticity.get() != 0)
+            mkFluidKernels::multiplyByLength(density, confinement, densityFromVorticity.get(), y0, y1);
+        
+        combinedObstacle.copyFrom(obstacle);
+    }
+};
+
+//--------------------------------------------------------------
+static void benchmarkTiledFluid() {
+    // whole frames with all their sweeps, step by step against the fused
+    // steps pass by pass and tile by tile, on one thread and on all cores,
+    // on the app's flow grid and two finer ones that no longer fit in cache
+    const int sizes[3][2] = { { 160, 90 }, { 320, 180 }, { 640, 360 } };
+    const int numFrames = 20;
+    for (int i = 0; i < 3; i++) {
+        int width = sizes[i][0], height = sizes[i][1];
+        string size = ofToString(width) + "x" + ofToString(height);
+        vector<mkTestForces> forces;
+        makeTestForces(forces, width, height, numFrames);
+        
+        mkUnfusedFluidSimulation unfused;
+        mkFluidSimulation passes, tiles, tilesAllCores;
+        unfused.setup(width, height, 1);
+        passes.setup(width, height, 1);
+        tiles.setup(width, height, 1);
+        tilesAllCores.setup(width, height, 0);
+        tiles.setTiled(true);
+        tilesAllCores.setTiled(true);
+        passes.setTolerance(0);
+        tiles.setTolerance(0);
+        tilesAllCores.setTolerance(0);
+        int unfusedFrame = 0, passesFrame = 0, tilesFrame = 0, tilesAllCoresFrame = 0;
+        auto addForces = [&](mkFluidSimulation& _fluid, int& _frame) {
+            const mkTestForces& f = forces[_frame++ % numFrames];
+            _fluid.addVelocity(f.velocity);
+            _fluid.addDensity(f.density);
+            _fluid.addTemperature(f.temperature);
+        };
+        auto step = [&](mkFluidSimulation& _fluid, int& _frame) {
+            addForces(_fluid, _frame);
+            _fluid.update(1.0f / 60.0f);
+        };
+        double unfusedMicros = mkBenchmark::run("fluid " + size + ", unfused", numFrames, [&] {
+            addForces(unfused, unfusedFrame);
+            unfused.updateUnfused(1.0f / 60.0f);
+        });
+        double passesMicros = mkBenchmark::run("fluid " + size + ", pass by pass", numFrames, [&] { step(passes, passesFrame); });
+        double tilesMicros = mkBenchmark::run("fluid " + size + ", tiled", numFrames, [&] { step(tiles, tilesFrame); });
+        double tilesAllCoresMicros = mkBenchmark::run("fluid " + size + ", tiled, all cores", numFrames, [&] { step(tilesAllCores, tilesAllCoresFrame); });
+        mkBenchmark::report("fluid " + size + " fused speed up", unfusedMicros, passesMicros);
+        mkBenchmark::report("fluid " + size + " tiled speed up", passesMicros, tilesMicros);
+        mkBenchmark::report("fluid " + size + " tiled speed up on all cores", tilesMicros, tilesAllCoresMicros);
+        
+        // the fused steps do the same per cell, the halo sweeps the same
+        // cells from the same values and the bands split only rows, so the
+        // fluid is the same to the bit
+        const mkFluidSimulation* fused[3] = { &passes, &tiles, &tilesAllCores };
+        const char* names[3] = { "pass by pass", "tiled", "tiled on all cores" };
+        for (int j = 0; j < 3; j++) {
+            float velocityDifference = fieldMaxDifference(unfused.getVelocity(), fused[j]->getVelocity());
+            float densityDifference = fieldMaxDifference(unfused.getDensity(), fused[j]->getDensity());
+            float pressureDifference = fieldMaxDifference(unfused.getPressure(), fused[j]->getPressure());
+            ofLogNotice("benchmark") << "fluid " << size << ", unfused against " << names[j] << ": velocity " << velocityDifference << ", density " << densityDifference << ", pressure " << pressureDifference << " apart";
+            if (velocityDifference != 0 || densityDifference != 0 || pressureDifference != 0)
+                mkBenchmarkFailure() << "fluid " << size << ": the " << names[j] << " steps disagree with the unfused ones";
+        }
+    }
+}
+
+//--------------------------------------------------------------
+int mkRunBenchmarks() {
+    mkBenchmark::resetFailures();
+    benchmarkDepthConvert();
+    benchmarkDepthBackground();
+    benchmarkDepthPyramid();
+    benchmarkBlobTracker();
+    benchmarkDepthRays();
+    benchmarkDepthFilter();
+    benchmarkDepthRecording();
+    benchmarkHandFilter();
+    benchmarkHandForces();
+    benchmarkGestureEngine();
+    benchmarkStage();
+    benchmarkSpscRing();
+    benchmarkLogChannel();
+    benchmarkIdMap();
+    benchmarkSharedState();
+    benchmarkUsbIngest();
+    benchmarkFluidSimulation();
+    benchmarkPressureSolvers();
+    benchmarkAdaptivePressure();
+    benchmarkPressureConvergence();
+    benchmarkTiledFluid();
+    
+    if (mkBenchmark::getNumFailures() > 0)
+        ofLogError("benchmark") << mkBenchmark::getNumFailures() << " checks failed";
+    return mkBenchmark::getNumFailures();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ofMain.h"
+#include "XnTypes.h"
+
+// Small flat hash map from hand or user id to per-interactor state, for the
+// lookups that happen for every hand on every frame. Keys and values sit in
+// two contiguous arrays; the table is at most half full and probes
+// linearly, so a lookup scans a few neighbouring keys, usually within one
+// cache line, before it touches its value. Erasing shifts the following
+// entries of the probe run back instead of leaving tombstones, so lookups
+// never slow down with churn.
+//
+// Id 0 marks an empty slot and can not be stored; NITE, the blob tracker
+// and the stage all start their ids at 1. Storage is allocated by setup()
+// and only grows if more ids than that are inserted.
+
+#define MK_ID_EMPTY 0
+
+template<typename T>
+class mkIdMap {
+public:
+    mkIdMap() : mask(0), shift(32), numEntries(0)	{ setup(4); }
+    
+    void    setup(int _maxEntries) {
+        int capacity = 8, bits = 3;
+        while (capacity < _maxEntries * 2) {
+            capacity *= 2;
+            bits++;
+        }
+        keys.assign(capacity, MK_ID_EMPTY);
+        values.assign(capacity, T());
+        mask = capacity - 1;
+        shift = 32 - bits;
+        numEntries = 0;
+    }
+    
+    void    clear() {
+        std::fill(keys.begin(), keys.end(), MK_ID_EMPTY);
+        numEntries = 0;
+    }
+    
+    int     size() const				{ return numEntries; }
+    bool    empty() const				{ return numEntries == 0; }
+    
+    T*      find(XnUserID _id) {
+        for (int i = home(_id);; i = (i + 1) & mask) {
+            if (keys[i] == _id)
+                return &values[i];
+            if (keys[i] == MK_ID_EMPTY)
+                return NULL;
+        }
+    }
+    const T* find(XnUserID _id) const	{ return const_cast<mkIdMap*>(this)->find(_id); }
+    
+    // the value of _id, default constructed if it is new
+    T*      insert(XnUserID _id) {
+        if ((numEntries + 1) * 2 > (int)keys.size())
+            grow();
+        int i = home(_id);
+        for (; keys[i] != MK_ID_EMPTY; i = (i + 1) & mask)
+            if (keys[i] == _id)
+                return &values[i];
+        keys[i] = _id;
+        values[i] = T();
+        numEntries++;
+        return &values[i];
+    }
+    
+    bool    erase(XnUserID _id) {
+        for (int i = home(_id); keys[i] != MK_ID_EMPTY; i = (i + 1) & mask) {
+            if (keys[i] == _id) {
+                eraseSlot(i);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // walking the slots, for updates that visit every entry
+    int         getCapacity() const			{ return keys.size(); }
+    bool        isUsed(int _slot) const		{ return keys[_slot] != MK_ID_EMPTY; }
+    XnUserID    getKey(int _slot) const		{ return keys[_slot]; }
+    T&          getValue(int _slot)			{ return values[_slot]; }
+    
+    // afterwards the slot may hold the next entry of its run, so a walk
+    // that erases looks at the same slot again
+    void    eraseSlot(int _slot) {
+        int i = _slot;
+        for (int j = (i + 1) & mask; keys[j] != MK_ID_EMPTY; j = (j + 1) & mask) {
+            // an entry may move back to i if its home is not between i and j
+            if (((j - home(keys[j])) & mask) >= ((j - i) & mask)) {
+                keys[i] = keys[j];
+                values[i] = values[j];
+                i = j;
+            }
+        }
+        keys[i] = MK_ID_EMPTY;
+        numEntries--;
+    }
+    
+private:
+    // Fibonacci hashing, the top bits of the product
+    int     home(XnUserID _id) const	{ return (XnUInt32)(_id * 2654435769u) >> shift; }
+    
+    void    grow() {
+        vector<XnUserID> oldKeys;
+        vector<T> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        setup(oldKeys.size());
+        for (int i = 0; i < oldKeys.size(); i++)
+            if (oldKeys[i] != MK_ID_EMPTY)
+                *insert(oldKeys[i]) = oldValues[i];
+    }
+    
+    vector<XnUserID>    keys;
+    vector<T>           values;
+    int                 mask;
+    int                 shift;
+    int                 numEntries;
+};
@@ -0,0 +1,74 @@
+#include "mkLogChannel.h"
+
+// how often the writer looks for messages
+#define MK_LOG_WRITE_INTERVAL 10
+
+//--------------------------------------------------------------
+mkLogChannel::mkLogChannel() {
+}
+
+//--------------------------------------------------------------
+mkLogChannel::~mkLogChannel() {
+    close();
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::setup(shared_ptr<ofBaseLoggerChannel> _target) {
+    close();
+    target = _target;
+    startThread(false, false);
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::close() {
+    if (isThreadRunning())
+        waitForThread(true);
+    write();
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::log(ofLogLevel _level, const string& _module, const string& _message) {
+    message m;
+    m.level = _level;
+    strncpy(m.module, _module.c_str(), MK_LOG_MODULE_LENGTH - 1);
+    m.module[MK_LOG_MODULE_LENGTH - 1] = 0;
+    strncpy(m.text, _message.c_str(), MK_LOG_MESSAGE_LENGTH - 1);
+    m.text[MK_LOG_MESSAGE_LENGTH - 1] = 0;
+    messages.push(m);
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::log(ofLogLevel _level, const string& _module, const char* _format, ...) {
+    va_list args;
+    va_start(args, _format);
+    log(_level, _module, _format, args);
+    va_end(args);
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::log(ofLogLevel _level, const string& _module, const char* _format, va_list _args) {
+    message m;
+    m.level = _level;
+    strncpy(m.module, _module.c_str(), MK_LOG_MODULE_LENGTH - 1);
+    m.module[MK_LOG_MODULE_LENGTH - 1] = 0;
+    vsnprintf(m.text, MK_LOG_MESSAGE_LENGTH, _format, _args);
+    messages.push(m);
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::threadedFunction() {
+    while (isThreadRunning()) {
+        write();
+        sleep(MK_LOG_WRITE_INTERVAL);
+    }
+}
+
+//--------------------------------------------------------------
+void mkLogChannel::write() {
+    if (!target)
+        return;
+    message m;
+    // as strings, a char* message would be taken for a format
+    while (messages.pop(m) == XN_STATUS_OK)
+        target->log(m.level, string(m.module), string(m.text));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mkMpscRing.h"
+
+#define MK_LOG_CAPACITY 256
+#define MK_LOG_MODULE_LENGTH 32
+#define MK_LOG_MESSAGE_LENGTH 224
+
+// Logger channel that takes console and file output off the threads that
+// log. ofLog() from any thread formats its message into a slot of a
+// lock-free ring and returns; a background thread writes the messages, in
+// order, to the channel it wraps. Logging never waits: with the ring full a
+// message is dropped and counted. Modules and messages longer than their
+// slot are cut.
+
+class mkLogChannel : public ofBaseLoggerChannel, public ofThread {
+public:
+    mkLogChannel();
+    ~mkLogChannel();
+    
+    // starts the writer, which hands every message to _target
+    void    setup(shared_ptr<ofBaseLoggerChannel> _target);
+    // writes what is left and stops the writer
+    void    close();
+    
+    void    log(ofLogLevel _level, const string& _module, const string& _message);
+    void    log(ofLogLevel _level, const string& _module, const char* _format, ...);
+    void    log(ofLogLevel _level, const string& _module, const char* _format, va_list _args);
+    
+    unsigned long long	getNumDropped() const		{ return messages.getNumDropped(); }
+    
+protected:
+    struct message {
+        ofLogLevel  level;
+        char        module[MK_LOG_MODULE_LENGTH];
+        char        text[MK_LOG_MESSAGE_LENGTH];
+    };
+    
+    void    threadedFunction();
+    void    write();
+    
+    mkMpscRing<message, MK_LOG_CAPACITY>	messages;
+    shared_ptr<ofBaseLoggerChannel>			target;
+};
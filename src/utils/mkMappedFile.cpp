@@ -0,0 +1,83 @@
+#include "mkMappedFile.h"
+
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+mkMappedFile::mkMappedFile() : data(NULL), size(0) {
+#ifdef TARGET_WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = NULL;
+#else
+    fileDescriptor = -1;
+#endif
+}
+
+//--------------------------------------------------------------
+mkMappedFile::~mkMappedFile() {
+    close();
+}
+
+//--------------------------------------------------------------
+bool mkMappedFile::open(const string& _path) {
+    close();
+    
+#ifdef TARGET_WIN32
+    fileHandle = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    size = fileSize.QuadPart;
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL)
+        data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    fileDescriptor = ::open(_path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) == 0 && fileStat.st_size > 0) {
+        size = fileStat.st_size;
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapped != MAP_FAILED) {
+            data = (const unsigned char*)mapped;
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+    }
+#endif
+    
+    if (data == NULL) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkMappedFile::close() {
+#ifdef TARGET_WIN32
+    if (data != NULL)
+        UnmapViewOfFile(data);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (data != NULL)
+        munmap((void*)data, size);
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = NULL;
+    size = 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Read only memory mapping of a whole file.
+
+class mkMappedFile {
+public:
+    mkMappedFile();
+    ~mkMappedFile();
+    
+    bool    open(const string& _path);
+    void    close();
+    bool    isOpen() const					{ return data != NULL; }
+    
+    const unsigned char*	getData() const	{ return data; }
+    size_t                  getSize() const	{ return size; }
+    
+protected:
+    const unsigned char*    data;
+    size_t                  size;
+    
+#ifdef TARGET_WIN32
+    void*   fileHandle;
+    void*   mappingHandle;
+#else
+    int     fileDescriptor;
+#endif
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include "XnStatus.h"
+#include "XnStatusCodes.h"
+#include "mkSimd.h"
+
+// Lock-free bounded multi-producer / single-consumer ring, for messages
+// that any thread may send to one worker. Every slot carries a sequence
+// number that says whose turn it is: producers claim a slot by moving the
+// shared head forward with a compare-exchange, fill it and publish it
+// through its sequence; the consumer takes slots in order. A producer never
+// waits: when the ring is full the element is dropped, counted, and push
+// returns XN_STATUS_INPUT_BUFFER_OVERFLOW, as mkSpscRing does. pop returns
+// XN_STATUS_IS_EMPTY when there is nothing to take, also for an element
+// that is claimed but not yet filled. Capacity is a power of two.
+
+template<typename T, unsigned int Capacity>
+class mkMpscRing {
+public:
+    mkMpscRing() : head(0), numDropped(0), tail(0) {
+        for (unsigned int i = 0; i < Capacity; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
+    // any thread
+    XnStatus push(const T& _value) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        slot* s;
+        for (;;) {
+            s = &slots[h & MASK];
+            int turn = (int)(s->sequence.load(std::memory_order_acquire) - h);
+            if (turn == 0) {
+                if (head.compare_exchange_weak(h, h + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (turn < 0) {
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+                return XN_STATUS_INPUT_BUFFER_OVERFLOW;
+            }
+            else
+                h = head.load(std::memory_order_relaxed);
+        }
+        s->value = _value;
+        s->sequence.store(h + 1, std::memory_order_release);
+        return XN_STATUS_OK;
+    }
+    
+    // consumer only
+    XnStatus pop(T& _value) {
+        slot& s = slots[tail & MASK];
+        if (s.sequence.load(std::memory_order_acquire) != tail + 1)
+            return XN_STATUS_IS_EMPTY;
+        _value = s.value;
+        s.sequence.store(tail + Capacity, std::memory_order_release);
+        tail++;
+        return XN_STATUS_OK;
+    }
+    
+    unsigned int        capacity() const        { return Capacity; }
+    unsigned long long  getNumDropped() const   { return numDropped.load(std::memory_order_relaxed); }
+    
+private:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "mkMpscRing capacity must be a power of two");
+    enum { MASK = Capacity - 1 };
+    
+    struct slot {
+        std::atomic<unsigned int>   sequence;
+        T                           value;
+    };
+    
+    char                                pad0[MK_CACHE_LINE_SIZE];
+    // producers' line
+    std::atomic<unsigned int>           head;
+    std::atomic<unsigned long long>     numDropped;
+    char                                pad1[MK_CACHE_LINE_SIZE];
+    // consumer line
+    unsigned int                        tail;
+    char                                pad2[MK_CACHE_LINE_SIZE];
+    
+    slot                                slots[Capacity];
+};
@@ -0,0 +1,106 @@
+#include "mkSharedMemory.h"
+
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+mkSharedMemory::mkSharedMemory() : data(NULL), size(0), writable(false) {
+#ifdef TARGET_WIN32
+    mappingHandle = NULL;
+#else
+    fileDescriptor = -1;
+#endif
+}
+
+//--------------------------------------------------------------
+mkSharedMemory::~mkSharedMemory() {
+    close();
+}
+
+//--------------------------------------------------------------
+bool mkSharedMemory::create(const string& _name, size_t _size) {
+    return map(_name, _size, true);
+}
+
+//--------------------------------------------------------------
+bool mkSharedMemory::open(const string& _name) {
+    return map(_name, 0, false);
+}
+
+//--------------------------------------------------------------
+bool mkSharedMemory::map(const string& _name, size_t _size, bool _create) {
+    close();
+    writable = _create;
+
+#ifdef TARGET_WIN32
+    // a named mapping backed by the paging file, in the session namespace
+    string name = "Local\\" + _name;
+    if (_create)
+        mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)_size, name.c_str());
+    else
+        mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (mappingHandle != NULL) {
+        data = (unsigned char*)MapViewOfFile(mappingHandle, _create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (data != NULL && VirtualQuery(data, &info, sizeof(info)) != 0)
+            size = info.RegionSize;
+    }
+#else
+    string name = "/" + _name;
+    fileDescriptor = shm_open(name.c_str(), _create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fileDescriptor < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) == 0) {
+        size = fileStat.st_size;
+        // grows a segment left by an older, smaller layout
+        if (_create && size < _size && ftruncate(fileDescriptor, _size) == 0)
+            size = _size;
+        if (size > 0) {
+            void* mapped = mmap(NULL, size, _create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fileDescriptor, 0);
+            if (mapped != MAP_FAILED)
+                data = (unsigned char*)mapped;
+        }
+    }
+#endif
+    
+    if (data == NULL || size < _size) {
+        ofLogError("mkSharedMemory") << "can not map " << _name;
+        close();
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+void mkSharedMemory::close() {
+#ifdef TARGET_WIN32
+    if (data != NULL)
+        UnmapViewOfFile(data);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    mappingHandle = NULL;
+#else
+    if (data != NULL)
+        munmap(data, size);
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = NULL;
+    size = 0;
+    writable = false;
+}
+
+//--------------------------------------------------------------
+void mkSharedMemory::remove(const string& _name) {
+#ifndef TARGET_WIN32
+    shm_unlink(("/" + _name).c_str());
+#endif
+}
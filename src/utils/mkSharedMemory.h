@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Named shared memory segment, created read write by the app or opened read
+// only by another process. The segment is not removed on close, so it lives
+// until the machine restarts and readers keep working when the app does.
+
+class mkSharedMemory {
+public:
+    mkSharedMemory();
+    ~mkSharedMemory();
+    
+    // creates the segment or maps the existing one with at least _size bytes
+    bool    create(const string& _name, size_t _size);
+    // maps an existing segment read only
+    bool    open(const string& _name);
+    void    close();
+    // removes the name, mappings stay valid; windows drops a segment with its last handle
+    static void remove(const string& _name);
+    bool    isOpen() const				{ return data != NULL; }
+    
+    const unsigned char*    getData() const			{ return data; }
+    unsigned char*          getWritableData()		{ return writable ? data : NULL; }
+    size_t                  getSize() const	{ return size; }
+    
+protected:
+    bool    map(const string& _name, size_t _size, bool _create);
+    
+    unsigned char*  data;
+    size_t          size;
+    bool            writable;
+
+#ifdef TARGET_WIN32
+    void*   mappingHandle;
+#else
+    int     fileDescriptor;
+#endif
+};
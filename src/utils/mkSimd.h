@@ -0,0 +1,70 @@
+#pragma once
+
+// SIMD selection shared by the CPU kernels. SSE2 and NEON are chosen at
+// compile time, AVX2 kernels are compiled with a target attribute and picked
+// at runtime with mkCpuHasAvx2(). Every kernel keeps a scalar path that
+// produces identical results, used when none of them is available.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MK_SIMD_X86
+    #include <immintrin.h>
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define MK_SIMD_SSE2
+    #endif
+    #if defined(__GNUC__) || defined(__clang__)
+        #define MK_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #else
+        #include <intrin.h>
+        #define MK_TARGET_AVX2
+    #endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define MK_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
+#define MK_CACHE_LINE_SIZE 64
+
+//--------------------------------------------------------------
+inline bool mkCpuHasAvx2() {
+#if defined(MK_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return hasAvx2;
+#elif defined(MK_SIMD_X86)
+    static const bool hasAvx2 = [] {
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        if (!osxsave || !fma || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return hasAvx2;
+#else
+    return false;
+#endif
+}
+
+// Flushes denormal floats to zero on this thread while in scope. Fields
+// decaying towards rest pass through denormals, which x86 handles in
+// microcode at many times the cost of a normal operation.
+class mkFlushDenormals {
+public:
+    mkFlushDenormals() {
+#ifdef MK_SIMD_SSE2
+        mode = _mm_getcsr();
+        _mm_setcsr(mode | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+#endif
+    }
+    ~mkFlushDenormals() {
+#ifdef MK_SIMD_SSE2
+        _mm_setcsr(mode);
+#endif
+    }
+    
+private:
+    unsigned int    mode;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include "XnStatus.h"
+#include "mkSimd.h"
+
+// Lock-free bounded single-producer / single-consumer ring, the hand-off for
+// events from a sensor thread to the render thread in place of a
+// XnThreadSafeQueue, which locks on every call and allocates a list node per
+// element. Push and pop keep its semantics: XN_STATUS_OK, XN_STATUS_IS_EMPTY
+// when there is nothing to pop and, as the ring never grows,
+// XN_STATUS_INPUT_BUFFER_OVERFLOW when it is full; that element is dropped
+// and counted.
+//
+// The two indices live on cache lines of their own, next to each side's copy
+// of the other index, so the sides only touch each other's line when their
+// copy says the ring is full or empty. Capacity is a power of two.
+
+template<typename T, unsigned int Capacity>
+class mkSpscRing {
+public:
+    mkSpscRing() : head(0), cachedTail(0), numDropped(0), tail(0), cachedHead(0) {}
+    
+    // producer only
+    XnStatus push(const T& _value) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == Capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == Capacity) {
+                numDropped.store(numDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return XN_STATUS_INPUT_BUFFER_OVERFLOW;
+            }
+        }
+        items[h & MASK] = _value;
+        head.store(h + 1, std::memory_order_release);
+        return XN_STATUS_OK;
+    }
+    
+    // consumer only
+    XnStatus pop(T& _value) {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead)
+                return XN_STATUS_IS_EMPTY;
+        }
+        _value = items[t & MASK];
+        tail.store(t + 1, std::memory_order_release);
+        return XN_STATUS_OK;
+    }
+    
+    // either side, a snapshot that may be stale by the time it returns
+    unsigned int        size() const            { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    unsigned int        capacity() const        { return Capacity; }
+    unsigned long long  getNumDropped() const   { return numDropped.load(std::memory_order_relaxed); }
+    
+private:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "mkSpscRing capacity must be a power of two");
+    enum { MASK = Capacity - 1 };
+    
+    char                                pad0[MK_CACHE_LINE_SIZE];
+    // producer line
+    std::atomic<unsigned int>           head;
+    unsigned int                        cachedTail;
+    std::atomic<unsigned long long>     numDropped;
+    char                                pad1[MK_CACHE_LINE_SIZE];
+    // consumer line
+    std::atomic<unsigned int>           tail;
+    unsigned int                        cachedHead;
+    char                                pad2[MK_CACHE_LINE_SIZE];
+    
+    T                                   items[Capacity];
+};
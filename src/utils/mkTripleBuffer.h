@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single-writer / single-reader triple buffer.
+// The writer fills getWriteBuffer() and calls publish(); the reader calls
+// update() and then reads getReadBuffer(). Neither side ever waits: the
+// reader always sees the newest complete buffer, older ones are dropped.
+
+template<typename T>
+class mkTripleBuffer {
+public:
+    mkTripleBuffer() : writeIndex(0), readIndex(1), middle(2) {}
+    
+    T&          getWriteBuffer()        { return buffers[writeIndex]; }
+    
+    // hand the write buffer over to the reader, take the middle one back
+    void publish() {
+        int previous = middle.exchange(writeIndex | DIRTY, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+    
+    // returns true if a newer buffer has been published since the last call
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & DIRTY))
+            return false;
+        int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+    
+    const T&    getReadBuffer() const   { return buffers[readIndex]; }
+    T&          getReadBuffer()         { return buffers[readIndex]; }
+    
+    // direct access for setup, only safe before the writer thread is started
+    T&          getBuffer(int _index)   { return buffers[_index]; }
+    
+private:
+    enum { INDEX_MASK = 3, DIRTY = 4 };
+    
+    T                   buffers[3];
+    int                 writeIndex;     // owned by the writer
+    int                 readIndex;      // owned by the reader
+    std::atomic<int>    middle;         // shared, index + dirty flag
+};
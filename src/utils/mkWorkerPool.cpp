@@ -0,0 +1,96 @@
+#include "mkWorkerPool.h"
+
+//--------------------------------------------------------------
+mkWorkerPool::mkWorkerPool() : function(NULL), context(NULL), numTasks(0), nextTask(0), numActive(0), generation(0), stopping(false) {
+}
+
+//--------------------------------------------------------------
+mkWorkerPool::~mkWorkerPool() {
+    stop();
+}
+
+//--------------------------------------------------------------
+void mkWorkerPool::setup(int _numThreads) {
+    stop();
+    if (_numThreads <= 0)
+        _numThreads = MAX((int)std::thread::hardware_concurrency() - 1, 1);
+    
+    stopping = false;
+    for (int i = 0; i < _numThreads; i++)
+        threads.push_back(std::thread(&mkWorkerPool::workerFunction, this));
+}
+
+//--------------------------------------------------------------
+void mkWorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < threads.size(); i++)
+        threads[i].join();
+    threads.clear();
+}
+
+//--------------------------------------------------------------
+void mkWorkerPool::run(int _numTasks, taskFunction _function, void* _context) {
+    if (threads.empty() || _numTasks <= 1) {
+        for (int i = 0; i < _numTasks; i++)
+            _function(_context, i);
+        return;
+    }
+    
+    {
+        // a worker that woke up late for the previous call may still be
+        // looking at its exhausted counter, let it finish before resetting
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return numActive == 0; });
+        function = _function;
+        context = _context;
+        numTasks = _numTasks;
+        nextTask = 0;
+        generation++;
+    }
+    wake.notify_all();
+    
+    runTasks(_function, _context, _numTasks);
+    
+    // every task was handed out, wait for the workers still running one
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return numActive == 0; });
+}
+
+//--------------------------------------------------------------
+void mkWorkerPool::runTasks(taskFunction _function, void* _context, int _numTasks) {
+    for (int task = nextTask++; task < _numTasks; task = nextTask++)
+        _function(_context, task);
+}
+
+//--------------------------------------------------------------
+void mkWorkerPool::workerFunction() {
+    unsigned int seenGeneration = 0;
+    while (true) {
+        taskFunction taskFunction;
+        void* taskContext;
+        int taskCount;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+            taskFunction = function;
+            taskContext = context;
+            taskCount = numTasks;
+            numActive++;
+        }
+        
+        runTasks(taskFunction, taskContext, taskCount);
+        
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            numActive--;
+        }
+        done.notify_all();
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ofMain.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A fixed set of worker threads for data parallel stages. parallelFor()
+// splits the work into numbered tasks, runs them on the workers and the
+// calling thread together and returns once all of them are done. Tasks are
+// handed out through an atomic counter, so bands of uneven cost balance
+// themselves. Nothing is allocated per call.
+
+class mkWorkerPool {
+public:
+    mkWorkerPool();
+    ~mkWorkerPool();
+    
+    // 0 picks one thread less than the cores, the caller works too
+    void    setup(int _numThreads = 0);
+    void    stop();
+    
+    int     getNumThreads() const		{ return threads.size(); }
+    
+    // calls _function(task) for task 0 to _numTasks - 1, blocks until done
+    template<typename F>
+    void    parallelFor(int _numTasks, F& _function) {
+        run(_numTasks, &invoke<F>, &_function);
+    }
+    
+protected:
+    typedef void (*taskFunction)(void* _context, int _task);
+    
+    template<typename F>
+    static void invoke(void* _context, int _task) { (*(F*)_context)(_task); }
+    
+    void    run(int _numTasks, taskFunction _function, void* _context);
+    void    runTasks(taskFunction _function, void* _context, int _numTasks);
+    void    workerFunction();
+    
+    vector<std::thread>         threads;
+    std::mutex                  mutex;
+    std::condition_variable     wake;
+    std::condition_variable     done;
+    
+    taskFunction                function;
+    void*                       context;
+    int                         numTasks;
+    std::atomic<int>            nextTask;
+    int                         numActive;
+    unsigned int                generation;
+    bool                        stopping;
+};